@@ -1,15 +1,61 @@
 #define _CRT_SECURE_NO_WARNINGS
+/*  -std=c11 ʱ glibc ֻ׼ C ĺmmap  MAP_ANONYMOUSmadvisefileno Ҫ */
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <time.h>
+#include <threads.h>
+
+#include "compiler.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/uio.h>
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#else
+#include <io.h>
+#include <sys/stat.h>
+#endif
+
+/* x86-64  SSE2/AVX2 ɨں˺ʽֵںˣSSE2 Ϊ x86-64 ָ */
+#if defined(__x86_64__) || defined(_M_X64)
+#define LEXER_SIMD 1
+#define COLUMN_SIMD 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#ifndef _MSC_VER
+/*  MSVC ʹñ׼ȫ汾 */
+#define sprintf_s snprintf
+#define vsprintf_s vsnprintf
+#define sscanf_s sscanf
+#endif
 
-#define MAX_VARS 100
-#define MAX_CODE_LENGTH 10000
-#define MAX_LINE_LENGTH 256
 #define MAX_FILENAME_LENGTH 256
-#define MAX_TOKENS 1000
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define OUTPUT_CHUNK_SIZE (64 * 1024)
+#define OUTPUT_IOV_BATCH 64
+#define TOKEN_STREAM_INITIAL 1024
+#define SYMBOL_TABLE_INITIAL 64
 
 
 /* ʷ */
@@ -29,15 +75,56 @@ typedef enum {
     TOKEN_MINUS,        // -
     TOKEN_MULTIPLY,     // *
     TOKEN_DIVIDE,       // /
+    TOKEN_MODULO,       // %
     TOKEN_EOF           // ļ
 } TokenType;
 
-/* ʷǽṹ */
+/* ʷַ */
+typedef enum {
+    CC_OTHER,           // ޷ʶַ
+    CC_SPACE,           // ոƱس
+    CC_NEWLINE,         // 
+    CC_LETTER,          // ĸ
+    CC_DIGIT,           // 
+    CC_LBRACE,          // {
+    CC_RBRACE,          // }
+    CC_LPAREN,          // (
+    CC_RPAREN,          // )
+    CC_SEMI,            // ;
+    CC_ASSIGN,          // =
+    CC_PLUS,            // +
+    CC_MINUS,           // -
+    CC_STAR,            // *
+    CC_SLASH,           // /
+    CC_PERCENT,         // %
+    CC_COUNT
+} CharClass;
+
+/* ʷ DFA ״̬LS_START ֮Ϊ/״̬ */
+typedef enum {
+    LS_START,           // ʼ״̬
+    LS_IDENT,           // ʶڲ
+    LS_NUMBER,          // ڲ
+    LS_SKIP,            // հ׻δַ֪
+    LS_NEWLINE,         // вк
+    LS_PUNCT,           // ַǣ
+    LS_ACCEPT           // ǰַڱǣɨ貿
+} LexState;
+
+/* ʷṹ飨SoAʽĿ
+   ıٸƣֻ¼ԴеƫƺͳȣкŰм¼ʼƫƣ
+   Ҫʱֲҡÿ 9 ֽڣԭ Token ṹΪ 40 ֽڣ */
 typedef struct {
-    TokenType type;
-    char value[32];
-    int line;
-} Token;
+    unsigned char* types;   /* ͣTokenType */
+    uint32_t* offsets;      /* Դеʼƫ */
+    uint32_t* lengths;      /* ǳȣֽڣ */
+    int count;
+    int capacity;
+
+    uint32_t* line_starts;  /*  i+1 еʼƫ */
+    int line_count;
+    int line_capacity;
+} TokenStream;
 
 /* ﷨ڵ */
 typedef enum {
@@ -53,13 +140,22 @@ typedef enum {
 } NodeType;
 
 /* ﷨ڵṹ */
-typedef struct ASTNode {
-    NodeType type;
-    char value[32];
-    struct ASTNode* left;
-    struct ASTNode* right;
+typedef struct {
+    int type;               /* NodeType */
+    int value;              /* ֽڵΪ IDΪֵڵΪַ */
+    int32_t left;           /* ӽڵڽڵе±꣬-1 ʾ */
+    int32_t right;          /* ӽڵ± */
 } ASTNode;
 
+/* ʽĹڴذһη䣬临ã */
+typedef struct {
+    int32_t* operands;      /* ջڵ±꣩ */
+    char* operators;        /* ջ'(' Ϊű */
+    int32_t* pending;       /* ƽ⻯ʱ */
+    int32_t* leaves;        /* ƽ⻯ʱǰҶ */
+    int32_t* joints;        /* ƽ⻯ʱǰڲڵ */
+} ExprScratch;
+
 /* мָ */
 typedef enum {
     IR_INPUT,       // input dest
@@ -69,83 +165,326 @@ typedef enum {
     IR_SUB,         // dest = src1 - src2  
     IR_MUL,         // dest = src1 * src2
     IR_DIV,         // dest = src1 / src2
-    IR_ASSIGN_CONST // dest = const
+    IR_MOD          // dest = src1 % src2
 } IRType;
 
-/* мָṹ */
+/* м32 λֵ 3 λΪ 29 λΪغ */
+typedef uint32_t IROperand;
+
+#define OPERAND_NONE 0          /* ޲ */
+#define OPERAND_VAR 1           /* غΪ± */
+#define OPERAND_TEMP 2          /* غΪʱ */
+#define OPERAND_IMM 3           /* غΪ 29 λз */
+#define OPERAND_POOL 4          /* غΪ±꣨ 29 λ */
+#define OPERAND_TAG_BITS 3
+#define OPERAND_TAG_MASK 7u
+#define OPERAND_IMM_MIN (-(1 << 28))
+#define OPERAND_IMM_MAX ((1 << 28) - 1)
+
+#define make_operand(tag, payload) (((uint32_t)(payload) << OPERAND_TAG_BITS) | (tag))
+#define operand_tag(operand) ((operand) & OPERAND_TAG_MASK)
+#define operand_index(operand) ((int)((operand) >> OPERAND_TAG_BITS))
+#define is_constant_operand(operand) (operand_tag(operand) == OPERAND_IMM || operand_tag(operand) == OPERAND_POOL)
+
+/* мָ + ǲ 16 ֽ */
 typedef struct {
-    IRType type;
-    char op[8];         // 
-    char dest[32];      // Ŀ
-    char src1[32];      // Դ1
-    char src2[32];      // Դ2
-    int constant;       // ֵ
+    uint32_t type;      // IRType
+    IROperand dest;     // Ŀ
+    IROperand src1;     // Դ1
+    IROperand src2;     // Դ2
 } IRInstruction;
 
 /* ṹ */
 typedef struct {
-    char name[32];
+    int symbol;         // ķ ID
     int offset;
 } Variable;
 
+/* űʶַפŶַ̽⣩ϣ ->  ID
+   ﷨֮н׶ֻʹ÷ ID ͱ±꣬ٱȽַ */
+typedef struct {
+    char* names;            /* ֳأ '\0' β */
+    size_t names_used;
+    size_t names_capacity;
+    uint32_t* name_offsets; /*  ID -> ֳеƫ */
+    uint32_t* hashes;       /*  ID -> ֹϣֵʱã */
+    int* var_index;         /*  ID -> ±꣬δΪ -1 */
+    int count;
+    int capacity;
+    int* slots;             /* ϣ ->  IDղΪ -1Ϊ 2  */
+    int slot_count;
+} SymbolTable;
+
+/* ڴؿ飺ͷ֮ɷ */
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t size;            /* ֽ */
+    size_t used;            /* ֽ */
+} ArenaBlock;
+
+/* ֿ飺ڽṹֻ֮׷Ӳƶ */
+struct OutputChunk {
+    struct OutputChunk* next;
+    size_t size;            /* ֽ */
+    size_t used;            /* ֽ */
+};
+
+/* ֿûܳ */
+typedef struct {
+    OutputChunk* head;
+    OutputChunk* tail;      /* ǰ׷ӵĿ */
+    size_t length;          /* ֽ */
+} OutputBuffer;
+
+/* ڴأbump һαڵ﷨м붼䣬
+    arena_release һͷţ free */
+typedef struct {
+    ArenaBlock* head;       /* ǰ飬֮ǰĿͨ next  */
+    size_t used;            /* ѷֽ */
+    size_t peak;            /* ʷֵֽ */
+} Arena;
+
+/* Դļֻͼơ޳ޣ */
+typedef struct {
+    const char* data;   /* Դʼַ֤ '\0' β */
+    size_t length;      /* Դֽ */
+    int mapped;         /* 1:  mmap0: һԶĶѻ */
+} SourceView;
+
+/* мŻͳƣɾָ */
+typedef struct {
+    int folded;             /* ۵봫 */
+    int reused;             /* ֲֵţдΪдظ */
+    int copies;             /* д */
+    int dead;               /* ɾ */
+    int temps_before;       /* Żǰʱ */
+    int temps_after;        /* Ż±ŵʱ */
+} OptimizeStats;
+
+/* Ծ䣺һֵӸֵһʹ */
+typedef struct {
+    int start;              /* ֵָ-1 ʾδֵͱʹ */
+    int end;                /* һʹָ */
+    int slot;               /* ʱ */
+    int reg;                /* ļĴ-1 ʾջ */
+    int stack_slot;         /* ڼĴʱջ۱ */
+} LiveInterval;
+
+/* Ĵջ۷intervals Ϊ NULL ʱÿʱռһջ */
+typedef struct {
+    LiveInterval* intervals;
+    int interval_count;
+    int32_t* operand_interval;  /* ÿָ 3 ĿꡢԴ 1Դ 2ӦĻԾ䣬-1 ʾ */
+    unsigned used_registers;    /* õļĴλͼ */
+    int spilled;                /*  */
+    int stack_slots;            /* ջ */
+    int scratch_slot;           /* Ĵеֵʱ scanf дջۣ-1 ʾҪ */
+} RegisterAllocation;
+
+/* x86-64 ӲĴţָеıһ£ */
+typedef enum {
+    REG_RAX, REG_RCX, REG_RDX, REG_RBX, REG_RSP, REG_RBP, REG_RSI, REG_RDI,
+    REG_R8, REG_R9, REG_R10, REG_R11, REG_R12, REG_R13, REG_R14, REG_R15
+} HardwareRegister;
+
+/* Ŀָ룻ASM_IMUL Ϊ˫ʽASM_IMUL1 Ϊ edx:eax = eax * src ĵʽ */
+typedef enum {
+    ASM_MOV, ASM_LEA, ASM_ADD, ASM_SUB, ASM_IMUL, ASM_IMUL1, ASM_IDIV, ASM_CLTD,
+    ASM_NEG, ASM_SHL, ASM_SAR, ASM_SHR, ASM_AND, ASM_XOR, ASM_PUSH, ASM_CALL,
+    ASM_LEAVE, ASM_RET,
+    ASM_IMUL3,              /* dst = src * immediate */
+    ASM_CMP,
+    ASM_JE,                 /* ת dst */
+    ASM_JNE,
+    ASM_LABEL,              /*  dst */
+    ASM_COMMENT,            /* ע */
+    ASM_BLANK,              /*  */
+    ASM_DELETED             /* Żɾָ */
+} AsmOpcode;
+
+/* õķ */
+typedef enum {
+    SYMBOL_SCAN_FORMAT,     /* .LC0: "%d" */
+    SYMBOL_PRINT_FORMAT,    /* .LC1: "%d\n" */
+    SYMBOL_SCANF,
+    SYMBOL_PRINTF
+} AsmSymbol;
+
+/* ָѡ򣻴ۼ tile_cost */
+typedef enum {
+    TILE_MOVE,              /* ҶװĴmovl */
+    TILE_LEA,               /* ַʽleal disp(base,index,scale) ʽ */
+    TILE_LEA_COMPLEX,       /* ַַƫе leal */
+    TILE_ADD,               /* ˫ addl/subl */
+    TILE_IMUL,              /* ˫ imull */
+    TILE_IMUL_IMM,          /*  imull $c, src, dst */
+    TILE_SHIFT_ADD,         /* ˷ leaλӼ */
+    TILE_DIV_CONST,         /* ȡģħ˷ */
+    TILE_IDIV,              /* cltd; idivl */
+    TILE_COUNT
+} Tile;
+
+/* Ŀָ */
+typedef enum {
+    AO_NONE,
+    AO_REG,                 /* Ĵ base */
+    AO_IMM,                 /*  value */
+    AO_MEM,                 /* value(base[,index,scale]) */
+    AO_RIP,                 /*  value  %rip ĵַ */
+    AO_SYMBOL,              /*  valueĿ꣩ */
+    AO_LABEL                /* ֲ .Lvalue */
+} AsmOperandKind;
+
+/* ĿָĴΪӲţREG_RAX..REG_R15index Ϊ -1 ʾޱַ */
+typedef struct {
+    uint8_t kind;           /* AsmOperandKind */
+    int8_t base;
+    int8_t index;
+    uint8_t scale;
+    int32_t value;
+} AsmOperand;
+
+/* ĿָAT&T ﷨src Ϊգָֻ dst */
+typedef struct {
+    uint8_t op;             /* AsmOpcode */
+    uint8_t size;           /* ȣ4  8 ֽ */
+    AsmOperand src;
+    AsmOperand dst;
+    int32_t immediate;      /* ASM_IMUL3 ĳ */
+    const char* comment;    /* עеݣβעͣNULL ʾ */
+} AsmInstruction;
+
+/* Ŀļ .text һضλoffset  32 λֶ÷ symbolAsmSymbol */
+typedef struct {
+    uint32_t offset;
+    int symbol;
+    int32_t addend;
+} ObjectRelocation;
+
 /* ṹ */
 typedef struct {
-    Variable vars[MAX_VARS];
+    Arena arena;            /* αڴ */
+    int echo;               /* ǷͬʱӡĻ */
+    int error_count;
+    SymbolTable symbols;
+    Variable* vars;
     int var_count;
-    int label_count;
+    int var_capacity;
+    int label_count;        /* ѷľֲĿָ 0 Ϊĳ */
 
     /* ʷ */
-    Token tokens[MAX_TOKENS];
-    int token_count;
-
-    /* ﷨ */
-    ASTNode* ast_root;
-
-    /* м */
-    IRInstruction ir_code[MAX_TOKENS];
+    const char* source;     /* Դͼıָ */
+    size_t source_length;
+    TokenStream tokens;
+
+    /* ﷨ƽڵ + ±飨ڴط䣩 */
+    ASTNode* nodes;
+    int node_count;
+    int node_capacity;
+    int32_t* statements;
+    int statement_count;
+    ExprScratch expr;
+
+    /* мڴط䣬ȷ */
+    IRInstruction* ir_code;
     int ir_count;
+    int ir_capacity;
     int temp_var_counter;  // ʱ
+    int32_t* constants;     /* أŲ */
+    int constant_count;
+    int constant_capacity;
+    OptimizeStats stats;
+    RegisterAllocation regs;
+    int frame_size;         /* ջֽ֡ */
+    int frame_size_unshared;    /* ÿʱռջʱջֽ֡ */
+
+    /* ָѡtree_root[i] Ϊ i ָϲ-1 ʾ
+       tree_child[i] Ϊϲ i ָе-1 ʾ */
+    int32_t* tree_root;
+    int32_t* tree_child;
+    int tree_folded;        /* ϲʽеָ */
+    int tile_counts[TILE_COUNT];
+    int check_division;     /*  0 ʱ idivl ǰ 0INT_MIN / -1 ʱ main  -1ʱִУ */
+
+    /* ĿָУŻдɻı */
+    AsmInstruction* asm_code;
+    int asm_count;
+    int asm_capacity;
+    int peephole_hits[PEEPHOLE_RULE_COUNT];
 
     /* ջ */
-    char output[MAX_CODE_LENGTH];
-    int output_pos;
+    OutputBuffer output;
 } Compiler;
 
 /*  */
 void compiler_init(Compiler* compiler);
+void compiler_free(Compiler* compiler);
 void clear_input_buffer(void);
-char* my_strtok_r(char* str, const char* delim, char** saveptr);
-int is_temp_var(const char* name);
-int get_temp_var_offset(Compiler* compiler, const char* temp_name);
+
+/* Դļȡ */
+int source_open(SourceView* view, const char* filename);
+void source_close(SourceView* view);
 
 /* ʷ */
-void lexer(Compiler* compiler, const char* source);
+void lexer(Compiler* compiler, const char* source, size_t length);
 void print_tokens(Compiler* compiler, FILE* output_file);
+int token_type(Compiler* compiler, int index);
+int token_line(Compiler* compiler, int index);
+void token_copy_text(Compiler* compiler, int index, char* buffer, size_t size);
 
 /* ﷨ */
 void parser(Compiler* compiler);
-ASTNode* parse_statement(Compiler* compiler, int* pos);
-ASTNode* parse_expression(Compiler* compiler, int* pos);
-void print_ast(ASTNode* node, int depth, FILE* output_file);
-void free_ast(ASTNode* node);
+int32_t parse_statement(Compiler* compiler, int* pos);
+int32_t parse_expression(Compiler* compiler, int* pos);
+void print_ast(Compiler* compiler, FILE* output_file);
 
 /* мɺ */
 void generate_ir(Compiler* compiler);
-char* generate_expression_ir(Compiler* compiler, ASTNode* node);
-char* new_temp_var(Compiler* compiler);
-void print_ir(Compiler* compiler, FILE* output_file);
+int generate_expression_ir(Compiler* compiler, int32_t root, IROperand* result);
+IROperand new_temp_var(Compiler* compiler);
+void print_ir(Compiler* compiler, FILE* output_file, const char* title);
+
+/* мŻ */
+int optimize_ir(Compiler* compiler);
+int fold_constants(Compiler* compiler);
+int number_values(Compiler* compiler);
+int propagate_copies(Compiler* compiler);
+int eliminate_dead_code(Compiler* compiler);
+void renumber_temps(Compiler* compiler);
 
 /* ɺ */
+int build_expression_trees(Compiler* compiler);
+int allocate_registers(Compiler* compiler);
+int assign_stack_slots(Compiler* compiler);
 void generate_assembly(Compiler* compiler);
+int peephole_optimize(Compiler* compiler, unsigned disabled);
+void write_assembly(Compiler* compiler);
+void write_object(Compiler* compiler);
+
+/* ڴغ */
+void* arena_alloc(Arena* arena, size_t size);
+void arena_release(Arena* arena);
+
+/* ű */
+int symbol_intern(SymbolTable* table, const char* text, size_t length);
+const char* symbol_name(SymbolTable* table, int symbol);
+void symbol_table_free(SymbolTable* table);
 
 /* ߺ */
-int find_variable(Compiler* compiler, const char* name);
-int add_variable(Compiler* compiler, const char* name);
+int variable_of(Compiler* compiler, int symbol);
+int add_variable(Compiler* compiler, int symbol);
 void emit_code(Compiler* compiler, const char* format, ...);
-char* new_label(Compiler* compiler);
+void emit_bytes(Compiler* compiler, const void* data, size_t length);
+void output_chunks_free(OutputChunk* chunk);
+void new_label(Compiler* compiler, char* label);
 
 /* ͬʱĻļĺ */
 void print_to_both(FILE* file, const char* format, ...);
+void write_to_both(FILE* file, const char* data, size_t length);
+
+/* ĵĹ󱨸 */
+void dump_printf(Compiler* compiler, FILE* stream, const char* format, ...);
+void compile_error(Compiler* compiler, const char* format, ...);
 
 /* 뻺 */
 void clear_input_buffer(void)
@@ -154,133 +493,392 @@ void clear_input_buffer(void)
     while ((c = getchar()) != '\n' && c != EOF);
 }
 
-/* Զ strtok_r ʵ */
-char* my_strtok_r(char* str, const char* delim, char** saveptr)
+/* ʼ */
+void compiler_init(Compiler* compiler)
 {
-    char* token;
-    char* end;
+    compiler->arena.head = NULL;
+    compiler->arena.used = 0;
+    compiler->arena.peak = 0;
+    compiler->echo = 0;
+    compiler->error_count = 0;
+    memset(&compiler->symbols, 0, sizeof(compiler->symbols));
+    compiler->vars = NULL;
+    compiler->var_count = 0;
+    compiler->var_capacity = 0;
+    compiler->label_count = 0;
+    compiler->source = "";
+    compiler->source_length = 0;
+    memset(&compiler->tokens, 0, sizeof(compiler->tokens));
+    compiler->nodes = NULL;
+    compiler->node_count = 0;
+    compiler->node_capacity = 0;
+    compiler->statements = NULL;
+    compiler->statement_count = 0;
+    memset(&compiler->expr, 0, sizeof(compiler->expr));
+    compiler->ir_code = NULL;
+    compiler->ir_count = 0;
+    compiler->ir_capacity = 0;
+    compiler->temp_var_counter = 0;
+    compiler->constants = NULL;
+    compiler->constant_count = 0;
+    compiler->constant_capacity = 0;
+    memset(&compiler->stats, 0, sizeof(compiler->stats));
+    memset(&compiler->regs, 0, sizeof(compiler->regs));
+    compiler->frame_size = 0;
+    compiler->frame_size_unshared = 0;
+    compiler->tree_root = NULL;
+    compiler->tree_child = NULL;
+    compiler->tree_folded = 0;
+    memset(compiler->tile_counts, 0, sizeof(compiler->tile_counts));
+    compiler->check_division = 0;
+    compiler->asm_code = NULL;
+    compiler->asm_count = 0;
+    compiler->asm_capacity = 0;
+    memset(compiler->peephole_hits, 0, sizeof(compiler->peephole_hits));
+    memset(&compiler->output, 0, sizeof(compiler->output));
+}
 
-    if (str != NULL) {
-        *saveptr = str;
-    }
+/* ͷűеĶ̬ڴ */
+void compiler_free(Compiler* compiler)
+{
+    free(compiler->tokens.types);
+    free(compiler->tokens.offsets);
+    free(compiler->tokens.lengths);
+    free(compiler->tokens.line_starts);
+    memset(&compiler->tokens, 0, sizeof(compiler->tokens));
+    symbol_table_free(&compiler->symbols);
+    free(compiler->vars);
+    compiler->vars = NULL;
+    compiler->var_count = 0;
+    compiler->var_capacity = 0;
+
+    /* ﷨мڴһͷ */
+    arena_release(&compiler->arena);
+    compiler->nodes = NULL;
+    compiler->node_count = 0;
+    compiler->node_capacity = 0;
+    compiler->statements = NULL;
+    compiler->statement_count = 0;
+    memset(&compiler->expr, 0, sizeof(compiler->expr));
+    compiler->ir_code = NULL;
+    compiler->ir_count = 0;
+    compiler->ir_capacity = 0;
+    compiler->tree_root = NULL;
+    compiler->tree_child = NULL;
+    free(compiler->constants);
+    compiler->constants = NULL;
+    compiler->constant_count = 0;
+    compiler->constant_capacity = 0;
+    free(compiler->asm_code);
+    compiler->asm_code = NULL;
+    compiler->asm_count = 0;
+    compiler->asm_capacity = 0;
+
+    /* δĻ */
+    output_chunks_free(compiler->output.head);
+    memset(&compiler->output, 0, sizeof(compiler->output));
+}
 
-    if (*saveptr == NULL || **saveptr == '\0') {
-        return NULL;
+/* ڴط size ֽڣ16 ֽڶ룬δ㣩ǰ鲻ʱ¿飬ʧܷ NULL */
+void* arena_alloc(Arena* arena, size_t size)
+{
+    ArenaBlock* block = arena->head;
+    void* ptr;
+
+    size = (size + 15) & ~(size_t)15;
+    if (block == NULL || block->size - block->used < size) {
+        size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        /* ͷ 16 ֽڶٷ */
+        block = (ArenaBlock*)malloc(((sizeof(ArenaBlock) + 15) & ~(size_t)15) + block_size);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->next = arena->head;
+        block->size = block_size;
+        block->used = 0;
+        arena->head = block;
     }
 
-    *saveptr += strspn(*saveptr, delim);
-    if (**saveptr == '\0') {
-        return NULL;
+    ptr = (char*)block + ((sizeof(ArenaBlock) + 15) & ~(size_t)15) + block->used;
+    block->used += size;
+    arena->used += size;
+    if (arena->used > arena->peak) {
+        arena->peak = arena->used;
     }
+    return ptr;
+}
 
-    token = *saveptr;
-    end = token + strcspn(token, delim);
+/* һͷڴеȫ飨ֵͳƣ */
+void arena_release(Arena* arena)
+{
+    ArenaBlock* block = arena->head;
+    ArenaBlock* next;
 
-    if (*end != '\0') {
-        *end = '\0';
-        *saveptr = end + 1;
+    while (block != NULL) {
+        next = block->next;
+        free(block);
+        block = next;
     }
-    else {
-        *saveptr = end;
+    arena->head = NULL;
+    arena->used = 0;
+}
+
+/* ֹϣFNV-1a */
+static uint32_t symbol_hash(const char* text, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    size_t i;
+    for (i = 0; i < length; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 16777619u;
     }
+    return hash;
+}
+
+/* ϣΪ slot_count Ĺϣֵ */
+static int symbol_rehash(SymbolTable* table, int slot_count)
+{
+    int* slots = (int*)malloc((size_t)slot_count * sizeof(int));
+    int i;
+    uint32_t j;
+    uint32_t mask = (uint32_t)slot_count - 1;
 
-    return token;
+    if (slots == NULL) return 0;
+    for (i = 0; i < slot_count; i++) {
+        slots[i] = -1;
+    }
+    for (i = 0; i < table->count; i++) {
+        j = table->hashes[i] & mask;
+        while (slots[j] != -1) {
+            j = (j + 1) & mask;
+        }
+        slots[j] = i;
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->slot_count = slot_count;
+    return 1;
 }
 
-/* жǷΪʱ */
-int is_temp_var(const char* name)
+/* פ֣ IDͬǵõͬ IDʧܷ -1 */
+int symbol_intern(SymbolTable* table, const char* text, size_t length)
 {
-    return (name[0] == 't' && isdigit((unsigned char)name[1]));
+    uint32_t hash = symbol_hash(text, length);
+    uint32_t mask;
+    uint32_t j;
+    int id;
+
+    /* װӱ 1/2  */
+    if ((table->count + 1) * 2 > table->slot_count &&
+        !symbol_rehash(table, table->slot_count ? table->slot_count * 2 : SYMBOL_TABLE_INITIAL * 2)) {
+        return -1;
+    }
+
+    mask = (uint32_t)table->slot_count - 1;
+    for (j = hash & mask; table->slots[j] != -1; j = (j + 1) & mask) {
+        id = table->slots[j];
+        if (table->hashes[id] == hash &&
+            strncmp(table->names + table->name_offsets[id], text, length) == 0 &&
+            table->names[table->name_offsets[id] + length] == '\0') {
+            return id;
+        }
+    }
+
+    /* ֣׷ӵֳ */
+    if (table->count >= table->capacity) {
+        int capacity = table->capacity ? table->capacity * 2 : SYMBOL_TABLE_INITIAL;
+        uint32_t* name_offsets = (uint32_t*)realloc(table->name_offsets, (size_t)capacity * sizeof(uint32_t));
+        uint32_t* hashes;
+        int* var_index;
+        if (name_offsets == NULL) return -1;
+        table->name_offsets = name_offsets;
+        hashes = (uint32_t*)realloc(table->hashes, (size_t)capacity * sizeof(uint32_t));
+        if (hashes == NULL) return -1;
+        table->hashes = hashes;
+        var_index = (int*)realloc(table->var_index, (size_t)capacity * sizeof(int));
+        if (var_index == NULL) return -1;
+        table->var_index = var_index;
+        table->capacity = capacity;
+    }
+    if (table->names_used + length + 1 > table->names_capacity) {
+        size_t capacity = table->names_capacity ? table->names_capacity * 2 : 1024;
+        char* names;
+        while (capacity < table->names_used + length + 1) {
+            capacity *= 2;
+        }
+        names = (char*)realloc(table->names, capacity);
+        if (names == NULL) return -1;
+        table->names = names;
+        table->names_capacity = capacity;
+    }
+
+    id = table->count++;
+    memcpy(table->names + table->names_used, text, length);
+    table->names[table->names_used + length] = '\0';
+    table->name_offsets[id] = (uint32_t)table->names_used;
+    table->names_used += length + 1;
+    table->hashes[id] = hash;
+    table->var_index[id] = -1;
+    table->slots[j] = id;
+    return id;
 }
 
-/* ȡʱջƫ */
-int get_temp_var_offset(Compiler* compiler, const char* temp_name)
+/*  ID ->  */
+const char* symbol_name(SymbolTable* table, int symbol)
 {
-    /* ʱ֮ͨʼ */
-    int temp_id;
-    if (sscanf_s(temp_name, "t%d", &temp_id) == 1) {
-        return (compiler->var_count + temp_id + 1) * 4;
+    if (symbol < 0 || symbol >= table->count) {
+        return "?";
     }
-    return -1;
+    return table->names + table->name_offsets[symbol];
 }
 
-/* ʼ */
-void compiler_init(Compiler* compiler)
+/* ͷŷű */
+void symbol_table_free(SymbolTable* table)
 {
-    compiler->var_count = 0;
-    compiler->label_count = 0;
-    compiler->token_count = 0;
-    compiler->ast_root = NULL;
-    compiler->ir_count = 0;
-    compiler->temp_var_counter = 0;
-    compiler->output_pos = 0;
-    memset(compiler->output, 0, sizeof(compiler->output));
+    free(table->names);
+    free(table->name_offsets);
+    free(table->hashes);
+    free(table->var_index);
+    free(table->slots);
+    memset(table, 0, sizeof(*table));
 }
 
-/* ұ */
-int find_variable(Compiler* compiler, const char* name)
+/*  ID -> ±꣬δ -1 */
+int variable_of(Compiler* compiler, int symbol)
 {
-    int i;
-    for (i = 0; i < compiler->var_count; i++) {
-        if (strcmp(compiler->vars[i].name, name) == 0) {
-            return i;
-        }
+    if (symbol < 0 || symbol >= compiler->symbols.count) {
+        return -1;
     }
-    return -1;
+    return compiler->symbols.var_index[symbol];
 }
 
-/* ӱ */
-int add_variable(Compiler* compiler, const char* name)
+/* ӱ1 ʾ0 ʾѴڣ-1 ʾʧ */
+int add_variable(Compiler* compiler, int symbol)
 {
     Variable* var;
 
-    if (find_variable(compiler, name) != -1) {
+    if (symbol < 0 || symbol >= compiler->symbols.count) {
+        return -1;
+    }
+    if (compiler->symbols.var_index[symbol] != -1) {
         return 0;
     }
 
-    if (compiler->var_count >= MAX_VARS) {
-        return -1;
+    if (compiler->var_count >= compiler->var_capacity) {
+        int capacity = compiler->var_capacity ? compiler->var_capacity * 2 : SYMBOL_TABLE_INITIAL;
+        Variable* vars = (Variable*)realloc(compiler->vars, (size_t)capacity * sizeof(Variable));
+        if (vars == NULL) {
+            return -1;
+        }
+        compiler->vars = vars;
+        compiler->var_capacity = capacity;
     }
 
     var = &compiler->vars[compiler->var_count];
-    strncpy(var->name, name, sizeof(var->name) - 1);
-    var->name[sizeof(var->name) - 1] = '\0';
+    var->symbol = symbol;
     var->offset = (compiler->var_count + 1) * 4;
+    compiler->symbols.var_index[symbol] = compiler->var_count;
     compiler->var_count++;
     return 1;
 }
 
-/* ɴ */
+/* ĩβ׷һ size ֽڵ¿飬ʧܷ NULL */
+static OutputChunk* output_chunk_append(OutputBuffer* output, size_t size)
+{
+    size_t chunk_size = size > OUTPUT_CHUNK_SIZE ? size : OUTPUT_CHUNK_SIZE;
+    OutputChunk* chunk = (OutputChunk*)malloc(sizeof(OutputChunk) + chunk_size);
+
+    if (chunk == NULL) return NULL;
+    chunk->next = NULL;
+    chunk->size = chunk_size;
+    chunk->used = 0;
+    if (output->tail != NULL) {
+        output->tail->next = chunk;
+    }
+    else {
+        output->head = chunk;
+    }
+    output->tail = chunk;
+    return chunk;
+}
+
+/* ͷֿ */
+void output_chunks_free(OutputChunk* chunk)
+{
+    while (chunk != NULL) {
+        OutputChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+/* ɴ룺ֱӸʽǰĿŲʱ¿¸ʽ */
 void emit_code(Compiler* compiler, const char* format, ...)
 {
+    OutputBuffer* output = &compiler->output;
+    OutputChunk* chunk = output->tail;
+    size_t room = chunk != NULL ? chunk->size - chunk->used : 0;
     va_list args;
     int written;
-    char buffer[1024];
 
     va_start(args, format);
-    written = vsprintf_s(buffer, sizeof(buffer), format, args);
+    written = vsnprintf(chunk != NULL ? (char*)(chunk + 1) + chunk->used : NULL, room, format, args);
     va_end(args);
+    if (written <= 0) return;
+
+    /* vsnprintf Ҫһֽڷ '\0' */
+    if ((size_t)written >= room) {
+        chunk = output_chunk_append(output, (size_t)written + 1);
+        if (chunk == NULL) {
+            compile_error(compiler, "ڴʧܣ\n");
+            return;
+        }
+        va_start(args, format);
+        vsnprintf((char*)(chunk + 1), chunk->size, format, args);
+        va_end(args);
+    }
+    chunk->used += (size_t)written;
+    output->length += (size_t)written;
+}
 
-    if (written > 0 && compiler->output_pos + written < MAX_CODE_LENGTH) {
-        strcpy(compiler->output + compiler->output_pos, buffer);
-        compiler->output_pos += written;
+/* ׷ӶݣĿļǰŲµĲд¿ */
+void emit_bytes(Compiler* compiler, const void* data, size_t length)
+{
+    OutputBuffer* output = &compiler->output;
+    OutputChunk* chunk = output->tail;
+    const char* bytes = (const char*)data;
+
+    while (length > 0) {
+        size_t room = chunk != NULL ? chunk->size - chunk->used : 0;
+        size_t count;
+
+        if (room == 0) {
+            chunk = output_chunk_append(output, length);
+            if (chunk == NULL) {
+                compile_error(compiler, "ڴʧܣĿļ\n");
+                return;
+            }
+            room = chunk->size;
+        }
+        count = length < room ? length : room;
+        memcpy((char*)(chunk + 1) + chunk->used, bytes, count);
+        chunk->used += count;
+        output->length += count;
+        bytes += count;
+        length -= count;
     }
 }
 
-/* ɱǩ */
-char* new_label(Compiler* compiler)
+/* ɱǩдṩ 32 ֽڻ */
+void new_label(Compiler* compiler, char* label)
 {
-    static char label[32];
-    sprintf_s(label, sizeof(label), ".L%d", compiler->label_count++);
-    return label;
+    sprintf_s(label, 32, ".L%d", compiler->label_count++);
 }
 
-/* ʱ */
-char* new_temp_var(Compiler* compiler)
+/* һµʱ */
+IROperand new_temp_var(Compiler* compiler)
 {
-    static char temp_name[32];
-    sprintf_s(temp_name, sizeof(temp_name), "t%d", compiler->temp_var_counter++);
-    return temp_name;
+    return make_operand(OPERAND_TEMP, compiler->temp_var_counter++);
 }
 
 /* ͬʱĻļĺ */
@@ -302,175 +900,584 @@ void print_to_both(FILE* file, const char* format, ...)
     }
 }
 
-/* ʷ */
-void lexer(Compiler* compiler, const char* source)
+/* һβ '\0' βͬʱĻļ */
+void write_to_both(FILE* file, const char* data, size_t length)
 {
-    char* source_copy;
-    char* line;
-    char* saveptr = NULL;
-    int line_num = 1;
-    char* pos;
-    Token* current_token;
+    fwrite(data, 1, length, stdout);
+    if (file != NULL) {
+        fwrite(data, 1, length, file);
+    }
+}
 
-    source_copy = _strdup(source);
-    if (source_copy == NULL) {
-        fprintf(stderr, "ڴʧܣ޷Դ\n");
-        return;
+/* дֱӸʽ stream Ļecho ʱͬʱӡĻ */
+void dump_printf(Compiler* compiler, FILE* stream, const char* format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    vfprintf(stream, format, args);
+    va_end(args);
+    if (compiler->echo) {
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
     }
+}
 
-    line = my_strtok_r(source_copy, "\n", &saveptr);
+/* 󲢼Ϣ׼ */
+void compile_error(Compiler* compiler, const char* format, ...)
+{
+    va_list args;
 
-    while (line != NULL) {
-        pos = line;
+    compiler->error_count++;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
 
-        /* ǰո */
-        while (*pos == ' ' || *pos == '\t') pos++;
+/* ԴļPOSIX ʹ mmap ֻӳ䣬ƽ̨һԶȳ */
+int source_open(SourceView* view, const char* filename)
+{
+    view->data = "";
+    view->length = 0;
+    view->mapped = 0;
+
+#ifndef _WIN32
+    {
+        int fd;
+        struct stat st;
+        void* addr;
+
+        fd = open(filename, O_RDONLY);
+        if (fd < 0) {
+            return -1;
+        }
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return -1;
+        }
+        if (st.st_size == 0) {
+            close(fd);
+            return 0;
+        }
 
-        /* ÿһеı */
-        while (*pos != '\0') {
-            if (compiler->token_count >= MAX_TOKENS) {
-                break;
-            }
+        addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED) {
+            return -1;
+        }
+        madvise(addr, (size_t)st.st_size, MADV_SEQUENTIAL);
 
-            current_token = &compiler->tokens[compiler->token_count];
-            current_token->line = line_num;
-
-            /* ո */
-            while (*pos == ' ' || *pos == '\t') pos++;
-            if (*pos == '\0') break;
-
-            /* ʶ */
-            if (strncmp(pos, "int", 3) == 0 && !isalnum((unsigned char)pos[3])) {
-                current_token->type = TOKEN_INT;
-                strcpy(current_token->value, "int");
-                pos += 3;
-                compiler->token_count++;
-            }
-            else if (strncmp(pos, "input", 5) == 0 && !isalnum((unsigned char)pos[5])) {
-                current_token->type = TOKEN_INPUT;
-                strcpy(current_token->value, "input");
-                pos += 5;
-                compiler->token_count++;
-            }
-            else if (strncmp(pos, "output", 6) == 0 && !isalnum((unsigned char)pos[6])) {
-                current_token->type = TOKEN_OUTPUT;
-                strcpy(current_token->value, "output");
-                pos += 6;
-                compiler->token_count++;
-            }
-            else if (*pos == '{') {
-                current_token->type = TOKEN_LBRACE;
-                strcpy(current_token->value, "{");
-                pos++;
-                compiler->token_count++;
-            }
-            else if (*pos == '}') {
-                current_token->type = TOKEN_RBRACE;
-                strcpy(current_token->value, "}");
-                pos++;
-                compiler->token_count++;
-            }
-            else if (*pos == '(') {
-                current_token->type = TOKEN_LPAREN;
-                strcpy(current_token->value, "(");
-                pos++;
-                compiler->token_count++;
-            }
-            else if (*pos == ')') {
-                current_token->type = TOKEN_RPAREN;
-                strcpy(current_token->value, ")");
-                pos++;
-                compiler->token_count++;
-            }
-            else if (*pos == ';') {
-                current_token->type = TOKEN_SEMICOLON;
-                strcpy(current_token->value, ";");
-                pos++;
-                compiler->token_count++;
-            }
-            else if (*pos == '=') {
-                current_token->type = TOKEN_ASSIGN;
-                strcpy(current_token->value, "=");
-                pos++;
-                compiler->token_count++;
-            }
-            else if (*pos == '+') {
-                current_token->type = TOKEN_PLUS;
-                strcpy(current_token->value, "+");
-                pos++;
-                compiler->token_count++;
-            }
-            else if (*pos == '-') {
-                current_token->type = TOKEN_MINUS;
-                strcpy(current_token->value, "-");
-                pos++;
-                compiler->token_count++;
-            }
-            else if (*pos == '*') {
-                current_token->type = TOKEN_MULTIPLY;
-                strcpy(current_token->value, "*");
-                pos++;
-                compiler->token_count++;
-            }
-            else if (*pos == '/') {
-                current_token->type = TOKEN_DIVIDE;
-                strcpy(current_token->value, "/");
-                pos++;
-                compiler->token_count++;
-            }
-            else if (isalpha((unsigned char)*pos)) {
-                /* ʶ */
-                int i = 0;
-                current_token->type = TOKEN_IDENTIFIER;
-                while (isalnum((unsigned char)*pos) && i < 31) {
-                    current_token->value[i++] = *pos++;
-                }
-                current_token->value[i] = '\0';
-                compiler->token_count++;
-            }
-            else if (isdigit((unsigned char)*pos)) {
-                /*  */
-                int i = 0;
-                current_token->type = TOKEN_NUMBER;
-                while (isdigit((unsigned char)*pos) && i < 31) {
-                    current_token->value[i++] = *pos++;
-                }
-                current_token->value[i] = '\0';
-                compiler->token_count++;
+        view->data = (const char*)addr;
+        view->length = (size_t)st.st_size;
+        view->mapped = 1;
+        return 0;
+    }
+#else
+    {
+        FILE* file;
+        long long size;
+        char* buffer;
+
+        file = fopen(filename, "rb");
+        if (file == NULL) {
+            return -1;
+        }
+        if (_fseeki64(file, 0, SEEK_END) != 0 || (size = _ftelli64(file)) < 0) {
+            fclose(file);
+            return -1;
+        }
+        rewind(file);
+        if (size == 0) {
+            fclose(file);
+            return 0;
+        }
+
+        buffer = (char*)malloc((size_t)size);
+        if (buffer == NULL) {
+            fclose(file);
+            return -1;
+        }
+        if (fread(buffer, 1, (size_t)size, file) != (size_t)size) {
+            free(buffer);
+            fclose(file);
+            return -1;
+        }
+        fclose(file);
+
+        view->data = buffer;
+        view->length = (size_t)size;
+        return 0;
+    }
+#endif
+}
+
+/* ͷԴļͼ */
+void source_close(SourceView* view)
+{
+    if (view->length > 0) {
+#ifndef _WIN32
+        if (view->mapped) {
+            munmap((void*)view->data, view->length);
+        }
+        else
+#endif
+        {
+            free((void*)view->data);
+        }
+    }
+    view->data = "";
+    view->length = 0;
+    view->mapped = 0;
+}
+
+/* ַÿֽһβɵõ */
+#define OT CC_OTHER
+#define SP CC_SPACE
+#define NL CC_NEWLINE
+#define LT CC_LETTER
+#define DG CC_DIGIT
+#define LB CC_LBRACE
+#define RB CC_RBRACE
+#define LP CC_LPAREN
+#define RP CC_RPAREN
+#define SC CC_SEMI
+#define AS CC_ASSIGN
+#define PL CC_PLUS
+#define MI CC_MINUS
+#define ST CC_STAR
+#define SL CC_SLASH
+#define PC CC_PERCENT
+static const unsigned char char_class[256] = {
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, SP, NL, OT, OT, SP, OT, OT,  /* 00-0F */
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  /* 10-1F */
+    SP, OT, OT, OT, OT, PC, OT, OT, LP, RP, ST, PL, OT, MI, OT, SL,  /* 20-2F */
+    DG, DG, DG, DG, DG, DG, DG, DG, DG, DG, OT, SC, OT, AS, OT, OT,  /* 30-3F */
+    OT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT,  /* 40-4F */
+    LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, OT, OT, OT, OT, OT,  /* 50-5F */
+    OT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT,  /* 60-6F */
+    LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LT, LB, OT, RB, OT, OT,  /* 70-7F */
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  /* 80-8F */
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  /* 90-9F */
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  /* A0-AF */
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  /* B0-BF */
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  /* C0-CF */
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  /* D0-DF */
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT,  /* E0-EF */
+    OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT, OT   /* F0-FF */
+};
+#undef OT
+#undef SP
+#undef NL
+#undef LT
+#undef DG
+#undef LB
+#undef RB
+#undef LP
+#undef RP
+#undef SC
+#undef AS
+#undef PL
+#undef MI
+#undef ST
+#undef SL
+#undef PC
+
+/* DFA תƱlex_transition[״̬][ַ] */
+static const unsigned char lex_transition[LS_NUMBER + 1][CC_COUNT] = {
+    /* LS_START */
+    { LS_SKIP, LS_SKIP, LS_NEWLINE, LS_IDENT, LS_NUMBER,
+      LS_PUNCT, LS_PUNCT, LS_PUNCT, LS_PUNCT, LS_PUNCT,
+      LS_PUNCT, LS_PUNCT, LS_PUNCT, LS_PUNCT, LS_PUNCT, LS_PUNCT },
+    /* LS_IDENT */
+    { LS_ACCEPT, LS_ACCEPT, LS_ACCEPT, LS_IDENT, LS_IDENT,
+      LS_ACCEPT, LS_ACCEPT, LS_ACCEPT, LS_ACCEPT, LS_ACCEPT,
+      LS_ACCEPT, LS_ACCEPT, LS_ACCEPT, LS_ACCEPT, LS_ACCEPT, LS_ACCEPT },
+    /* LS_NUMBER */
+    { LS_ACCEPT, LS_ACCEPT, LS_ACCEPT, LS_ACCEPT, LS_NUMBER,
+      LS_ACCEPT, LS_ACCEPT, LS_ACCEPT, LS_ACCEPT, LS_ACCEPT,
+      LS_ACCEPT, LS_ACCEPT, LS_ACCEPT, LS_ACCEPT, LS_ACCEPT, LS_ACCEPT }
+};
+
+/* ַǣַ ->  */
+static const TokenType punct_token[CC_COUNT] = {
+    TOKEN_EOF, TOKEN_EOF, TOKEN_EOF, TOKEN_EOF, TOKEN_EOF,
+    TOKEN_LBRACE, TOKEN_RBRACE, TOKEN_LPAREN, TOKEN_RPAREN, TOKEN_SEMICOLON,
+    TOKEN_ASSIGN, TOKEN_PLUS, TOKEN_MINUS, TOKEN_MULTIPLY, TOKEN_DIVIDE,
+    TOKEN_MODULO
+};
+
+/* ؼϣ( + ĸ) & 7 Եǰؼּ޳ͻ */
+typedef struct {
+    const char* text;
+    size_t length;
+    TokenType type;
+} Keyword;
+
+static const Keyword keyword_table[8] = {
+    { NULL, 0, TOKEN_IDENTIFIER },
+    { NULL, 0, TOKEN_IDENTIFIER },
+    { NULL, 0, TOKEN_IDENTIFIER },
+    { NULL, 0, TOKEN_IDENTIFIER },
+    { "int", 3, TOKEN_INT },        /* (3 + 'i') & 7 = 4 */
+    { "output", 6, TOKEN_OUTPUT },  /* (6 + 'o') & 7 = 5 */
+    { "input", 5, TOKEN_INPUT },    /* (5 + 'i') & 7 = 6 */
+    { NULL, 0, TOKEN_IDENTIFIER }
+};
+
+/* ʶؼ֣ǹؼ򷵻 TOKEN_IDENTIFIER */
+static TokenType lookup_keyword(const char* text, size_t length)
+{
+    const Keyword* kw = &keyword_table[(length + (unsigned char)text[0]) & 7];
+    if (kw->length == length && memcmp(kw->text, text, length) == 0) {
+        return kw->type;
+    }
+    return TOKEN_IDENTIFIER;
+}
+
+/* ֽɨںˣ [p, end) еһڸֽλ */
+typedef const char* (*ScanFunc)(const char* p, const char* end);
+
+/* ںˣ DFA Իȫһµֽڲ */
+static const char* skip_space_scalar(const char* p, const char* end)
+{
+    while (p < end && char_class[(unsigned char)*p] == CC_SPACE) p++;
+    return p;
+}
+
+static const char* scan_ident_scalar(const char* p, const char* end)
+{
+    while (p < end && lex_transition[LS_IDENT][char_class[(unsigned char)*p]] == LS_IDENT) p++;
+    return p;
+}
+
+static const char* scan_digits_scalar(const char* p, const char* end)
+{
+    while (p < end && lex_transition[LS_NUMBER][char_class[(unsigned char)*p]] == LS_NUMBER) p++;
+    return p;
+}
+
+#ifdef LEXER_SIMD
+/* λ 1 λãmask  0 */
+static int lowest_bit(unsigned int mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+/* ַж ASCII ֽڰзűȽΪȻ֮ */
+#define SSE2_IN_RANGE(v, lo, hi) \
+    _mm_and_si128(_mm_cmpgt_epi8((v), _mm_set1_epi8((char)((lo) - 1))), \
+                  _mm_cmplt_epi8((v), _mm_set1_epi8((char)((hi) + 1))))
+#define SSE2_IS_SPACE(v) \
+    _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8((v), _mm_set1_epi8(' ')), \
+                              _mm_cmpeq_epi8((v), _mm_set1_epi8('\t'))), \
+                 _mm_cmpeq_epi8((v), _mm_set1_epi8('\r')))
+#define SSE2_IS_DIGIT(v) SSE2_IN_RANGE((v), '0', '9')
+#define SSE2_IS_ALNUM(v) \
+    _mm_or_si128(SSE2_IN_RANGE(_mm_or_si128((v), _mm_set1_epi8(0x20)), 'a', 'z'), \
+                 SSE2_IN_RANGE((v), '0', '9'))
+
+#define AVX2_IN_RANGE(v, lo, hi) \
+    _mm256_and_si256(_mm256_cmpgt_epi8((v), _mm256_set1_epi8((char)((lo) - 1))), \
+                     _mm256_cmpgt_epi8(_mm256_set1_epi8((char)((hi) + 1)), (v)))
+#define AVX2_IS_SPACE(v) \
+    _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8((v), _mm256_set1_epi8(' ')), \
+                                    _mm256_cmpeq_epi8((v), _mm256_set1_epi8('\t'))), \
+                    _mm256_cmpeq_epi8((v), _mm256_set1_epi8('\r')))
+#define AVX2_IS_DIGIT(v) AVX2_IN_RANGE((v), '0', '9')
+#define AVX2_IS_ALNUM(v) \
+    _mm256_or_si256(AVX2_IN_RANGE(_mm256_or_si256((v), _mm256_set1_epi8(0x20)), 'a', 'z'), \
+                    AVX2_IN_RANGE((v), '0', '9'))
+
+/* ÿμ 16 ֽڣ 16 ֽڵβںˣ֤Խ end ȡ */
+#define DEFINE_SSE2_SCAN(name, test, fallback) \
+static const char* name(const char* p, const char* end) \
+{ \
+    unsigned int miss; \
+    while (end - p >= 16) { \
+        __m128i v = _mm_loadu_si128((const __m128i*)p); \
+        miss = (unsigned int)_mm_movemask_epi8(test(v)) ^ 0xFFFFu; \
+        if (miss != 0) return p + lowest_bit(miss); \
+        p += 16; \
+    } \
+    return fallback(p, end); \
+}
+
+/* ÿμ 32 ֽڣβ SSE2 ں */
+#define DEFINE_AVX2_SCAN(name, test, fallback) \
+TARGET_AVX2 static const char* name(const char* p, const char* end) \
+{ \
+    unsigned int miss; \
+    while (end - p >= 32) { \
+        __m256i v = _mm256_loadu_si256((const __m256i*)p); \
+        miss = ~(unsigned int)_mm256_movemask_epi8(test(v)); \
+        if (miss != 0) return p + lowest_bit(miss); \
+        p += 32; \
+    } \
+    return fallback(p, end); \
+}
+
+DEFINE_SSE2_SCAN(skip_space_sse2, SSE2_IS_SPACE, skip_space_scalar)
+DEFINE_SSE2_SCAN(scan_ident_sse2, SSE2_IS_ALNUM, scan_ident_scalar)
+DEFINE_SSE2_SCAN(scan_digits_sse2, SSE2_IS_DIGIT, scan_digits_scalar)
+DEFINE_AVX2_SCAN(skip_space_avx2, AVX2_IS_SPACE, skip_space_sse2)
+DEFINE_AVX2_SCAN(scan_ident_avx2, AVX2_IS_ALNUM, scan_ident_sse2)
+DEFINE_AVX2_SCAN(scan_digits_avx2, AVX2_IS_DIGIT, scan_digits_sse2)
+
+/*  CPU ϵͳǷ֧ AVX2Ҫ OS  YMM Ĵ */
+static int cpu_has_avx2(void)
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return 0;
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) return 0;
+    if ((_xgetbv(0) & 6) != 6) return 0;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+/* ݣʧܷ 0 */
+static int token_stream_grow(TokenStream* stream)
+{
+    int capacity = stream->capacity ? stream->capacity * 2 : TOKEN_STREAM_INITIAL;
+    unsigned char* types;
+    uint32_t* offsets;
+    uint32_t* lengths;
+
+    types = (unsigned char*)realloc(stream->types, (size_t)capacity * sizeof(*types));
+    if (types == NULL) return 0;
+    stream->types = types;
+    offsets = (uint32_t*)realloc(stream->offsets, (size_t)capacity * sizeof(*offsets));
+    if (offsets == NULL) return 0;
+    stream->offsets = offsets;
+    lengths = (uint32_t*)realloc(stream->lengths, (size_t)capacity * sizeof(*lengths));
+    if (lengths == NULL) return 0;
+    stream->lengths = lengths;
+
+    stream->capacity = capacity;
+    return 1;
+}
+
+/* ׷һǣʧܷ 0 */
+static int token_stream_push(TokenStream* stream, int type, size_t offset, size_t length)
+{
+    if (stream->count >= stream->capacity && !token_stream_grow(stream)) {
+        return 0;
+    }
+    stream->types[stream->count] = (unsigned char)type;
+    stream->offsets[stream->count] = (uint32_t)offset;
+    stream->lengths[stream->count] = (uint32_t)length;
+    stream->count++;
+    return 1;
+}
+
+/* ¼һеʼƫƣʧܷ 0 */
+static int token_stream_push_line(TokenStream* stream, size_t offset)
+{
+    if (stream->line_count >= stream->line_capacity) {
+        int capacity = stream->line_capacity ? stream->line_capacity * 2 : TOKEN_STREAM_INITIAL;
+        uint32_t* line_starts = (uint32_t*)realloc(stream->line_starts, (size_t)capacity * sizeof(uint32_t));
+        if (line_starts == NULL) return 0;
+        stream->line_starts = line_starts;
+        stream->line_capacity = capacity;
+    }
+    stream->line_starts[stream->line_count++] = (uint32_t)offset;
+    return 1;
+}
+
+#ifdef _MSC_VER
+#define FORCE_INLINE static __forceinline
+#else
+#define FORCE_INLINE static inline __attribute__((always_inline))
+#endif
+
+/* ʷѭ DFADFA Ի״̬հסʶ֣ɨں
+   ںԳ벢ǿÿָʵһݣǵļӵ */
+FORCE_INLINE void lexer_run(Compiler* compiler, const char* source, size_t length,
+    ScanFunc skip_space, ScanFunc scan_ident, ScanFunc scan_digits)
+{
+    TokenStream* stream = &compiler->tokens;
+    const char* pos = source;
+    const char* end = source + length;
+    const char* start;
+    size_t len;
+    int cls;
+    int state;
+
+    compiler->source = source;
+    compiler->source_length = length;
+    if (length > UINT32_MAX) {
+        compile_error(compiler, "Դļ 4GB޷\n");
+        return;
+    }
+    if (!token_stream_push_line(stream, 0)) {
+        compile_error(compiler, "ڴʧܣ޷\n");
+        return;
+    }
+
+    while (pos < end) {
+        cls = char_class[(unsigned char)*pos];
+        state = lex_transition[LS_START][cls];
+
+        if (state == LS_SKIP) {
+            pos++;
+            if (cls == CC_SPACE && pos < end && char_class[(unsigned char)*pos] == CC_SPACE) {
+                pos = skip_space(pos + 1, end);
             }
-            else {
-                /* δַ֪ */
-                pos++;
+            continue;
+        }
+        if (state == LS_NEWLINE) {
+            pos++;
+            if (!token_stream_push_line(stream, (size_t)(pos - source))) {
+                compile_error(compiler, "ڴʧܣкű\n");
+                return;
+            }
+            continue;
+        }
+
+        if (state == LS_PUNCT) {
+            if (!token_stream_push(stream, punct_token[cls], (size_t)(pos - source), 1)) {
+                compile_error(compiler, "ڴʧܣ\n");
+                return;
             }
+            pos++;
+            continue;
         }
 
-        line = my_strtok_r(NULL, "\n", &saveptr);
-        line_num++;
+        /* ʶ֣ͣԻ״ֱ̬תƵ LS_ACCEPT
+           ַǺܳȲһαپǷɨں */
+        start = pos++;
+        if (pos < end && lex_transition[state][char_class[(unsigned char)*pos]] == state) {
+            pos = (state == LS_IDENT) ? scan_ident(pos + 1, end) : scan_digits(pos + 1, end);
+        }
+        len = (size_t)(pos - start);
+
+        if (!token_stream_push(stream,
+                state == LS_IDENT ? lookup_keyword(start, len) : TOKEN_NUMBER,
+                (size_t)(start - source), len)) {
+            compile_error(compiler, "ڴʧܣ\n");
+            return;
+        }
     }
 
     /* EOF */
-    if (compiler->token_count < MAX_TOKENS) {
-        compiler->tokens[compiler->token_count].type = TOKEN_EOF;
-        strcpy(compiler->tokens[compiler->token_count].value, "EOF");
-        compiler->tokens[compiler->token_count].line = line_num;
-        compiler->token_count++;
+    if (!token_stream_push(stream, TOKEN_EOF, length, 0)) {
+        compile_error(compiler, "ڴʧܣ\n");
+    }
+}
+
+#ifndef LEXER_SIMD
+static void lexer_scalar(Compiler* compiler, const char* source, size_t length)
+{
+    lexer_run(compiler, source, length, skip_space_scalar, scan_ident_scalar, scan_digits_scalar);
+}
+#else
+static void lexer_sse2(Compiler* compiler, const char* source, size_t length)
+{
+    lexer_run(compiler, source, length, skip_space_sse2, scan_ident_sse2, scan_digits_sse2);
+}
+
+TARGET_AVX2 static void lexer_avx2(Compiler* compiler, const char* source, size_t length)
+{
+    lexer_run(compiler, source, length, skip_space_avx2, scan_ident_avx2, scan_digits_avx2);
+}
+#endif
+
+/* ʷֱɨֻԴͼ [source, source + length)
+   ʱ CPU ֧ѡ AVX2 > SSE2 > ʵ֣ıȫͬ */
+void lexer(Compiler* compiler, const char* source, size_t length)
+{
+#ifdef LEXER_SIMD
+    if (cpu_has_avx2()) {
+        lexer_avx2(compiler, source, length);
+        return;
     }
+    lexer_sse2(compiler, source, length);
+#else
+    lexer_scalar(compiler, source, length);
+#endif
+}
+
+/* ȡ index ǵͣԽʱΪ EOF */
+int token_type(Compiler* compiler, int index)
+{
+    if (index < 0 || index >= compiler->tokens.count) {
+        return TOKEN_EOF;
+    }
+    return compiler->tokens.types[index];
+}
+
+/* ȡ index кţʼƫƱжֲң */
+int token_line(Compiler* compiler, int index)
+{
+    uint32_t offset;
+    int lo = 0;
+    int hi = compiler->tokens.line_count - 1;
+    int mid;
+
+    if (index < 0 || index >= compiler->tokens.count || hi < 0) {
+        return 0;
+    }
+    offset = compiler->tokens.offsets[index];
+    while (lo < hi) {
+        mid = (lo + hi + 1) / 2;
+        if (compiler->tokens.line_starts[mid] <= offset) {
+            lo = mid;
+        }
+        else {
+            hi = mid - 1;
+        }
+    }
+    return lo + 1;
+}
+
+/*  index ǵıƵ bufferضϣԽʱõմ */
+void token_copy_text(Compiler* compiler, int index, char* buffer, size_t size)
+{
+    size_t len = 0;
 
-    free(source_copy);
+    if (index >= 0 && index < compiler->tokens.count) {
+        len = compiler->tokens.lengths[index];
+        if (len > size - 1) {
+            len = size - 1;
+        }
+        memcpy(buffer, compiler->source + compiler->tokens.offsets[index], len);
+    }
+    buffer[len] = '\0';
 }
 
 /* ӡʷ */
 void print_tokens(Compiler* compiler, FILE* output_file)
 {
+    TokenStream* stream = &compiler->tokens;
     int i;
+    int line = 0;
     const char* type_str;
 
-    print_to_both(output_file, "=== ʷ ===\n");
-    print_to_both(output_file, "%-12s %-15s %s\n", "к", "", "ֵ");
-    print_to_both(output_file, "----------------------------------------\n");
+    dump_printf(compiler, output_file, "=== ʷ ===\n");
+    dump_printf(compiler, output_file, "%-12s %-15s %s\n", "к", "", "ֵ");
+    dump_printf(compiler, output_file, "----------------------------------------\n");
+
+    for (i = 0; i < stream->count; i++) {
+        /* ǰƫƵ˳ƽкż */
+        while (line + 1 < stream->line_count && stream->line_starts[line + 1] <= stream->offsets[i]) {
+            line++;
+        }
 
-    for (i = 0; i < compiler->token_count; i++) {
-        switch (compiler->tokens[i].type) {
+        switch (stream->types[i]) {
         case TOKEN_INT: type_str = "TOKEN_INT"; break;
         case TOKEN_IDENTIFIER: type_str = "TOKEN_IDENTIFIER"; break;
         case TOKEN_NUMBER: type_str = "TOKEN_NUMBER"; break;
@@ -486,116 +1493,150 @@ void print_tokens(Compiler* compiler, FILE* output_file)
         case TOKEN_MINUS: type_str = "TOKEN_MINUS"; break;
         case TOKEN_MULTIPLY: type_str = "TOKEN_MULTIPLY"; break;
         case TOKEN_DIVIDE: type_str = "TOKEN_DIVIDE"; break;
+        case TOKEN_MODULO: type_str = "TOKEN_MODULO"; break;
         case TOKEN_EOF: type_str = "TOKEN_EOF"; break;
         default: type_str = "UNKNOWN"; break;
         }
-        print_to_both(output_file, "%-12d %-15s %s\n",
-            compiler->tokens[i].line, type_str, compiler->tokens[i].value);
+        if (stream->types[i] == TOKEN_EOF) {
+            dump_printf(compiler, output_file, "%-12d %-15s %s\n", line + 1, type_str, "EOF");
+        }
+        else {
+            dump_printf(compiler, output_file, "%-12d %-15s %.*s\n", line + 1, type_str,
+                (int)stream->lengths[i], compiler->source + stream->offsets[i]);
+        }
     }
-    print_to_both(output_file, "\n");
+    dump_printf(compiler, output_file, "\n");
+}
+
+/* ӽڵȡһ½ڵ㣬±ꣻ -1 */
+static int32_t ast_new(Compiler* compiler, int type, int value, int32_t left, int32_t right)
+{
+    ASTNode* node;
+
+    if (compiler->node_count >= compiler->node_capacity) {
+        compile_error(compiler, "﷨ڵ\n");
+        return -1;
+    }
+    node = &compiler->nodes[compiler->node_count];
+    node->type = type;
+    node->value = value;
+    node->left = left;
+    node->right = right;
+    return compiler->node_count++;
 }
 
 /* ﷨ */
 void parser(Compiler* compiler)
 {
     int pos = 0;
-    ASTNode* last_stmt = NULL;
-    ASTNode* current_stmt;
+    int32_t current_stmt;
+    size_t capacity = (size_t)compiler->tokens.count + 1;
+
+    compiler->node_count = 0;
+    compiler->statement_count = 0;
+
+    /* ÿڵһǣڵһη */
+    compiler->nodes = (ASTNode*)arena_alloc(&compiler->arena, capacity * sizeof(ASTNode));
+    compiler->statements = (int32_t*)arena_alloc(&compiler->arena, capacity * sizeof(int32_t));
+    compiler->expr.operands = (int32_t*)arena_alloc(&compiler->arena, capacity * sizeof(int32_t));
+    compiler->expr.operators = (char*)arena_alloc(&compiler->arena, capacity);
+    compiler->expr.pending = (int32_t*)arena_alloc(&compiler->arena, capacity * sizeof(int32_t));
+    compiler->expr.leaves = (int32_t*)arena_alloc(&compiler->arena, capacity * sizeof(int32_t));
+    compiler->expr.joints = (int32_t*)arena_alloc(&compiler->arena, capacity * sizeof(int32_t));
+    if (compiler->nodes == NULL || compiler->statements == NULL || compiler->expr.operands == NULL ||
+        compiler->expr.operators == NULL || compiler->expr.pending == NULL ||
+        compiler->expr.leaves == NULL || compiler->expr.joints == NULL) {
+        compile_error(compiler, "ڴʧܣ޷﷨ڵ\n");
+        compiler->nodes = NULL;
+        compiler->statements = NULL;
+        compiler->node_capacity = 0;
+        return;
+    }
+    compiler->node_capacity = (int)capacity;
 
     /* ͷ { */
-    if (pos < compiler->token_count && compiler->tokens[pos].type == TOKEN_LBRACE) {
+    if (pos < compiler->tokens.count && token_type(compiler, pos) == TOKEN_LBRACE) {
         pos++;
     }
 
-    /* ڵ */
-    compiler->ast_root = (ASTNode*)malloc(sizeof(ASTNode));
-    if (compiler->ast_root == NULL) {
-        fprintf(stderr, "ڴʧܣ޷ AST ڵ\n");
-        return;
-    }
-
-    compiler->ast_root->type = NODE_PROGRAM;
-    strcpy(compiler->ast_root->value, "program");
-    compiler->ast_root->left = NULL;
-    compiler->ast_root->right = NULL;
-
     /*  */
-    while (pos < compiler->token_count && compiler->tokens[pos].type != TOKEN_RBRACE) {
+    while (pos < compiler->tokens.count && token_type(compiler, pos) != TOKEN_RBRACE) {
         current_stmt = parse_statement(compiler, &pos);
-        if (current_stmt != NULL) {
-            if (last_stmt == NULL) {
-                compiler->ast_root->left = current_stmt;
-            }
-            else {
-                last_stmt->right = current_stmt;
-            }
-            last_stmt = current_stmt;
+        if (current_stmt >= 0) {
+            compiler->statements[compiler->statement_count++] = current_stmt;
         }
     }
 }
 
-/*  */
-ASTNode* parse_statement(Compiler* compiler, int* pos)
+/* פ index ǵıط IDԽʧΪ -1 */
+static int token_intern(Compiler* compiler, int index)
+{
+    if (index < 0 || index >= compiler->tokens.count) {
+        return -1;
+    }
+    return symbol_intern(&compiler->symbols,
+        compiler->source + compiler->tokens.offsets[index], compiler->tokens.lengths[index]);
+}
+
+/*  index ֱǵֵ 32 λƣɵ movl һ£ */
+static int token_int_value(Compiler* compiler, int index)
+{
+    const char* text = compiler->source + compiler->tokens.offsets[index];
+    uint32_t length = compiler->tokens.lengths[index];
+    uint32_t value = 0;
+    uint32_t i;
+
+    for (i = 0; i < length; i++) {
+        value = value * 10u + (uint32_t)(text[i] - '0');
+    }
+    return (int)value;
+}
+
+/* 䣬ڵ±ꣻ޷ʶʱ -1 */
+int32_t parse_statement(Compiler* compiler, int* pos)
 {
-    ASTNode* node = NULL;
+    int32_t node = -1;
+    int symbol;
 
-    if (*pos >= compiler->token_count) return NULL;
+    if (*pos >= compiler->tokens.count) return -1;
 
-    if (compiler->tokens[*pos].type == TOKEN_INT) {
+    if (token_type(compiler, *pos) == TOKEN_INT) {
         /*  */
-        node = (ASTNode*)malloc(sizeof(ASTNode));
-        if (node == NULL) {
-            fprintf(stderr, "ڴʧܣDECLARATION ڵ\n");
-            return NULL;
-        }
-        node->type = NODE_DECLARATION;
-        strcpy(node->value, compiler->tokens[*pos + 1].value);
-        node->left = NULL;
-        node->right = NULL;
+        symbol = token_intern(compiler, *pos + 1);
+        node = ast_new(compiler, NODE_DECLARATION, symbol, -1, -1);
         *pos += 3; /* int + identifier + ; */
-        add_variable(compiler, node->value);
+        add_variable(compiler, symbol);
     }
-    else if (compiler->tokens[*pos].type == TOKEN_INPUT) {
+    else if (token_type(compiler, *pos) == TOKEN_INPUT) {
         /* input */
-        node = (ASTNode*)malloc(sizeof(ASTNode));
-        if (node == NULL) {
-            fprintf(stderr, "ڴʧܣINPUT ڵ\n");
-            return NULL;
-        }
-        node->type = NODE_INPUT;
-        strcpy(node->value, compiler->tokens[*pos + 2].value); /* input ( identifier ) */
-        node->left = NULL;
-        node->right = NULL;
+        node = ast_new(compiler, NODE_INPUT, token_intern(compiler, *pos + 2), -1, -1); /* input ( identifier ) */
         *pos += 5; /* input + ( + identifier + ) + ; */
     }
-    else if (compiler->tokens[*pos].type == TOKEN_OUTPUT) {
+    else if (token_type(compiler, *pos) == TOKEN_OUTPUT) {
         /* output */
-        node = (ASTNode*)malloc(sizeof(ASTNode));
-        if (node == NULL) {
-            fprintf(stderr, "ڴʧܣOUTPUT ڵ\n");
-            return NULL;
-        }
-        node->type = NODE_OUTPUT;
-        strcpy(node->value, compiler->tokens[*pos + 2].value); /* output ( identifier ) */
-        node->left = NULL;
-        node->right = NULL;
+        node = ast_new(compiler, NODE_OUTPUT, token_intern(compiler, *pos + 2), -1, -1); /* output ( identifier ) */
         *pos += 5; /* output + ( + identifier + ) + ; */
     }
-    else if (compiler->tokens[*pos].type == TOKEN_IDENTIFIER &&
-        *pos + 1 < compiler->token_count &&
-        compiler->tokens[*pos + 1].type == TOKEN_ASSIGN) {
+    else if (token_type(compiler, *pos) == TOKEN_IDENTIFIER &&
+        *pos + 1 < compiler->tokens.count &&
+        token_type(compiler, *pos + 1) == TOKEN_ASSIGN) {
         /* ֵ */
-        node = (ASTNode*)malloc(sizeof(ASTNode));
-        if (node == NULL) {
-            fprintf(stderr, "ڴʧܣASSIGNMENT ڵ\n");
-            return NULL;
-        }
-        node->type = NODE_ASSIGNMENT;
-        strcpy(node->value, compiler->tokens[*pos].value);
+        symbol = token_intern(compiler, *pos);
         *pos += 2; /* identifier + = */
-        node->left = parse_expression(compiler, pos);
-        node->right = NULL;
-        (*pos)++; /*  ; */
+        node = parse_expression(compiler, pos);
+        node = ast_new(compiler, NODE_ASSIGNMENT, symbol, node, -1);
+        if (*pos < compiler->tokens.count && token_type(compiler, *pos) != TOKEN_SEMICOLON) {
+            compile_error(compiler, "﷨󣨵 %d Уֵȱ ;\n", token_line(compiler, *pos));
+            /* 䣬β */
+            node = -1;
+            while (*pos < compiler->tokens.count && token_type(compiler, *pos) != TOKEN_SEMICOLON &&
+                token_type(compiler, *pos) != TOKEN_RBRACE) {
+                (*pos)++;
+            }
+        }
+        if (*pos < compiler->tokens.count && token_type(compiler, *pos) == TOKEN_SEMICOLON) {
+            (*pos)++; /*  ; */
+        }
     }
     else {
         (*pos)++; /* ޷ʶı */
@@ -604,560 +1645,5177 @@ ASTNode* parse_statement(Compiler* compiler, int* pos)
     return node;
 }
 
-/* ʽ */
-ASTNode* parse_expression(Compiler* compiler, int* pos)
+/* ԪȼΪ 0 */
+static int operator_precedence(int op)
+{
+    switch (op) {
+    case '*': case '/': case '%': return 2;
+    case '+': case '-': return 1;
+    default: return 0;
+    }
+}
+
+/* ջԼΪԪڵ㣬ѹزջ */
+static int expr_reduce(Compiler* compiler, int* operand_sp, int* operator_sp)
 {
-    ASTNode* node = NULL;
+    ExprScratch* expr = &compiler->expr;
+    int32_t left;
+    int32_t right;
+    int32_t node;
+
+    if (*operand_sp < 2) return 0;
+    right = expr->operands[--*operand_sp];
+    left = expr->operands[--*operand_sp];
+    node = ast_new(compiler, NODE_BINARY_OP, expr->operators[--*operator_sp], left, right);
+    if (node < 0) return 0;
+    expr->operands[(*operand_sp)++] = node;
+    return 1;
+}
 
-    if (*pos >= compiler->token_count) return NULL;
+/*  root ͬһɽ+*ɵΪƽ
+   Ҷӱִҵ˳ֻıϷʽ 32 λ²䣻
+   ڽڵԭظã½ڵ㡣ÿڵֻһΣܺʱԡ */
+static void ast_balance(Compiler* compiler, int32_t root)
+{
+    ExprScratch* expr = &compiler->expr;
+    int pending_sp = 0;
+
+    if (root < 0) return;
+    expr->pending[pending_sp++] = root;
+
+    while (pending_sp > 0) {
+        int32_t top = expr->pending[--pending_sp];
+        ASTNode* node = &compiler->nodes[top];
+        int op = node->value;
+        int leaf_count = 0;
+        int joint_count = 0;
+        int walk_sp;
+        int i;
+
+        if (node->type != NODE_BINARY_OP) continue;
+        if (op != '+' && op != '*') {
+            expr->pending[pending_sp++] = node->left;
+            expr->pending[pending_sp++] = node->right;
+            continue;
+        }
 
-    /* 򵥵ıʽ */
-    if (compiler->tokens[*pos].type == TOKEN_IDENTIFIER) {
-        if (*pos + 2 < compiler->token_count &&
-            (compiler->tokens[*pos + 1].type == TOKEN_PLUS ||
-                compiler->tokens[*pos + 1].type == TOKEN_MINUS ||
-                compiler->tokens[*pos + 1].type == TOKEN_MULTIPLY ||
-                compiler->tokens[*pos + 1].type == TOKEN_DIVIDE)) {
-            /* Ԫʽ */
-            node = (ASTNode*)malloc(sizeof(ASTNode));
-            if (node == NULL) {
-                fprintf(stderr, "ڴʧܣBINARY_OP ڵ\n");
-                return NULL;
+        /* ˳ռϵҶӺڲڵ㣨 operands ջ */
+        walk_sp = 0;
+        expr->operands[walk_sp++] = top;
+        while (walk_sp > 0) {
+            int32_t current = expr->operands[--walk_sp];
+            ASTNode* n = &compiler->nodes[current];
+
+            if (n->type == NODE_BINARY_OP && n->value == op) {
+                expr->joints[joint_count++] = current;
+                expr->operands[walk_sp++] = n->right;
+                expr->operands[walk_sp++] = n->left;
+            }
+            else {
+                expr->leaves[leaf_count++] = current;
+                expr->pending[pending_sp++] = current;
             }
-            node->type = NODE_BINARY_OP;
-            strcpy(node->value, compiler->tokens[*pos + 1].value);
+        }
 
-            node->left = (ASTNode*)malloc(sizeof(ASTNode));
-            if (node->left == NULL) {
-                fprintf(stderr, "ڴʧܣBINARY_OP \n");
-                free(node);
-                return NULL;
+        /* ϲjoints[0] ڵ㣬һκϲʱȡ±겻 */
+        while (leaf_count > 1) {
+            int merged = 0;
+            for (i = 0; i + 1 < leaf_count; i += 2) {
+                int32_t joint = expr->joints[--joint_count];
+                compiler->nodes[joint].left = expr->leaves[i];
+                compiler->nodes[joint].right = expr->leaves[i + 1];
+                expr->leaves[merged++] = joint;
             }
-            node->left->type = NODE_VARIABLE;
-            strcpy(node->left->value, compiler->tokens[*pos].value);
-            node->left->left = NULL;
-            node->left->right = NULL;
+            if (i < leaf_count) {
+                expr->leaves[merged++] = expr->leaves[i];
+            }
+            leaf_count = merged;
+        }
+    }
+}
+
+/* ʽȳ㷨ʽջرʽڵ±ꣻ﷨󷵻 -1 */
+int32_t parse_expression(Compiler* compiler, int* pos)
+{
+    ExprScratch* expr = &compiler->expr;
+    int operand_sp = 0;
+    int operator_sp = 0;
+    int paren_depth = 0;
+    int expect_operand = 1;
+    int start = *pos;
+    int32_t node;
+    TokenType type;
+    int op;
+
+    while (*pos < compiler->tokens.count) {
+        type = token_type(compiler, *pos);
 
-            *pos += 2;
-            node->right = parse_expression(compiler, pos);
+        if (expect_operand) {
+            if (type == TOKEN_IDENTIFIER) {
+                node = ast_new(compiler, NODE_VARIABLE, token_intern(compiler, *pos), -1, -1);
+            }
+            else if (type == TOKEN_NUMBER) {
+                node = ast_new(compiler, NODE_CONSTANT, token_int_value(compiler, *pos), -1, -1);
+            }
+            else if (type == TOKEN_LPAREN) {
+                expr->operators[operator_sp++] = '(';
+                paren_depth++;
+                (*pos)++;
+                continue;
+            }
+            else {
+                compile_error(compiler, "﷨󣨵 %d Уʽȱٲ\n", token_line(compiler, *pos));
+                return -1;
+            }
+            if (node < 0) return -1;
+            expr->operands[operand_sp++] = node;
+            expect_operand = 0;
+        }
+        else if (type == TOKEN_PLUS || type == TOKEN_MINUS ||
+            type == TOKEN_MULTIPLY || type == TOKEN_DIVIDE || type == TOKEN_MODULO) {
+            /* ϣȹԼջȼڵǰĲ */
+            op = compiler->source[compiler->tokens.offsets[*pos]];
+            while (operator_sp > 0 && expr->operators[operator_sp - 1] != '(' &&
+                operator_precedence(expr->operators[operator_sp - 1]) >= operator_precedence(op)) {
+                if (!expr_reduce(compiler, &operand_sp, &operator_sp)) return -1;
+            }
+            expr->operators[operator_sp++] = (char)op;
+            expect_operand = 1;
+        }
+        else if (type == TOKEN_RPAREN && paren_depth > 0) {
+            while (expr->operators[operator_sp - 1] != '(') {
+                if (!expr_reduce(compiler, &operand_sp, &operator_sp)) return -1;
+            }
+            operator_sp--;
+            paren_depth--;
         }
         else {
-            /*  */
-            node = (ASTNode*)malloc(sizeof(ASTNode));
-            if (node == NULL) {
-                fprintf(stderr, "ڴʧܣVARIABLE ڵ\n");
-                return NULL;
-            }
-            node->type = NODE_VARIABLE;
-            strcpy(node->value, compiler->tokens[*pos].value);
-            node->left = NULL;
-            node->right = NULL;
-            (*pos)++;
-        }
-    }
-    else if (compiler->tokens[*pos].type == TOKEN_NUMBER) {
-        /*  */
-        node = (ASTNode*)malloc(sizeof(ASTNode));
-        if (node == NULL) {
-            fprintf(stderr, "ڴʧܣCONSTANT ڵ\n");
-            return NULL;
+            break;  /* ʽ */
         }
-        node->type = NODE_CONSTANT;
-        strcpy(node->value, compiler->tokens[*pos].value);
-        node->left = NULL;
-        node->right = NULL;
         (*pos)++;
     }
 
+    if (expect_operand) {
+        compile_error(compiler, "﷨󣨵 %d Уʽ\n",
+            token_line(compiler, *pos < compiler->tokens.count ? *pos : start));
+        return -1;
+    }
+    if (paren_depth > 0) {
+        compile_error(compiler, "﷨󣨵 %d Уȱ\n", token_line(compiler, start));
+        return -1;
+    }
+    while (operator_sp > 0) {
+        if (!expr_reduce(compiler, &operand_sp, &operator_sp)) return -1;
+    }
+
+    node = expr->operands[0];
+    ast_balance(compiler, node);
     return node;
 }
 
-/* ӡ﷨ */
-void print_ast(ASTNode* node, int depth, FILE* output_file)
+/* ӡ﷨ʽջȲܵջ */
+void print_ast(Compiler* compiler, FILE* output_file)
 {
+    int32_t* stack;
+    int* depths;
+    int sp = 0;
     int i;
 
-    if (node == NULL) return;
+    dump_printf(compiler, output_file, "=== ﷨ ===\n");
+    dump_printf(compiler, output_file, "PROGRAM\n");
+    if (compiler->node_count == 0) {
+        dump_printf(compiler, output_file, "\n");
+        return;
+    }
 
-    for (i = 0; i < depth; i++) {
-        print_to_both(output_file, "  ");
+    /* ջнڵڵ */
+    stack = (int32_t*)malloc((size_t)compiler->node_count * sizeof(int32_t));
+    depths = (int*)malloc((size_t)compiler->node_count * sizeof(int));
+    if (stack == NULL || depths == NULL) {
+        compile_error(compiler, "ڴʧܣ﷨ӡջ\n");
+        free(stack);
+        free(depths);
+        return;
     }
 
-    switch (node->type) {
-    case NODE_PROGRAM: print_to_both(output_file, "PROGRAM\n"); break;
-    case NODE_DECLARATION: print_to_both(output_file, "DECLARATION: %s\n", node->value); break;
-    case NODE_INPUT: print_to_both(output_file, "INPUT: %s\n", node->value); break;
-    case NODE_OUTPUT: print_to_both(output_file, "OUTPUT: %s\n", node->value); break;
-    case NODE_ASSIGNMENT: print_to_both(output_file, "ASSIGNMENT: %s\n", node->value); break;
-    case NODE_BINARY_OP: print_to_both(output_file, "BINARY_OP: %s\n", node->value); break;
-    case NODE_VARIABLE: print_to_both(output_file, "VARIABLE: %s\n", node->value); break;
-    case NODE_CONSTANT: print_to_both(output_file, "CONSTANT: %s\n", node->value); break;
-    default: print_to_both(output_file, "UNKNOWN\n"); break;
+    for (i = 0; i < compiler->statement_count; i++) {
+        stack[0] = compiler->statements[i];
+        depths[0] = 1;
+        sp = 1;
+
+        while (sp > 0) {
+            const ASTNode* node;
+            int depth;
+            int d;
+
+            sp--;
+            node = &compiler->nodes[stack[sp]];
+            depth = depths[sp];
+
+            for (d = 0; d < depth; d++) {
+                dump_printf(compiler, output_file, "  ");
+            }
+
+            switch (node->type) {
+            case NODE_DECLARATION: dump_printf(compiler, output_file, "DECLARATION: %s\n", symbol_name(&compiler->symbols, node->value)); break;
+            case NODE_INPUT: dump_printf(compiler, output_file, "INPUT: %s\n", symbol_name(&compiler->symbols, node->value)); break;
+            case NODE_OUTPUT: dump_printf(compiler, output_file, "OUTPUT: %s\n", symbol_name(&compiler->symbols, node->value)); break;
+            case NODE_ASSIGNMENT: dump_printf(compiler, output_file, "ASSIGNMENT: %s\n", symbol_name(&compiler->symbols, node->value)); break;
+            case NODE_BINARY_OP: dump_printf(compiler, output_file, "BINARY_OP: %c\n", node->value); break;
+            case NODE_VARIABLE: dump_printf(compiler, output_file, "VARIABLE: %s\n", symbol_name(&compiler->symbols, node->value)); break;
+            case NODE_CONSTANT: dump_printf(compiler, output_file, "CONSTANT: %d\n", node->value); break;
+            default: dump_printf(compiler, output_file, "UNKNOWN\n"); break;
+            }
+
+            /* ջȳջ */
+            if (node->right >= 0) {
+                stack[sp] = node->right;
+                depths[sp++] = depth + 1;
+            }
+            if (node->left >= 0) {
+                stack[sp] = node->left;
+                depths[sp++] = depth + 1;
+            }
+        }
     }
 
-    print_ast(node->left, depth + 1, output_file);
-    print_ast(node->right, depth + 1, output_file);
+    free(stack);
+    free(depths);
+    dump_printf(compiler, output_file, "\n");
+}
+
+/* ȡһµмָʼΪգ NULL */
+static IRInstruction* ir_new(Compiler* compiler, IRType type)
+{
+    IRInstruction* ir;
+
+    if (compiler->ir_count >= compiler->ir_capacity) return NULL;
+
+    ir = &compiler->ir_code[compiler->ir_count++];
+    ir->type = type;
+    ir->dest = OPERAND_NONE;
+    ir->src1 = OPERAND_NONE;
+    ir->src2 = OPERAND_NONE;
+    return ir;
 }
 
-/* ͷ﷨ */
-void free_ast(ASTNode* node)
+/* 쳣29 λֱӱڲУ볣 */
+static IROperand make_constant(Compiler* compiler, int32_t value)
 {
-    if (node == NULL) return;
-    free_ast(node->left);
-    free_ast(node->right);
-    free(node);
+    if (value >= OPERAND_IMM_MIN && value <= OPERAND_IMM_MAX) {
+        return make_operand(OPERAND_IMM, value);
+    }
+
+    if (compiler->constant_count >= compiler->constant_capacity) {
+        int capacity = compiler->constant_capacity ? compiler->constant_capacity * 2 : SYMBOL_TABLE_INITIAL;
+        int32_t* constants = (int32_t*)realloc(compiler->constants, (size_t)capacity * sizeof(int32_t));
+        if (constants == NULL) {
+            compile_error(compiler, "ڴʧܣ\n");
+            return OPERAND_NONE;
+        }
+        compiler->constants = constants;
+        compiler->constant_capacity = capacity;
+    }
+    compiler->constants[compiler->constant_count] = value;
+    return make_operand(OPERAND_POOL, compiler->constant_count++);
 }
 
-/* ݹɱʽм */
-char* generate_expression_ir(Compiler* compiler, ASTNode* node)
+/* ֵ */
+static int32_t operand_constant(const Compiler* compiler, IROperand operand)
 {
-    IRInstruction* ir;
-    char* temp1;
-    char* temp2;
-    char* result_temp;
+    if (operand_tag(operand) == OPERAND_POOL) {
+        return compiler->constants[operand_index(operand)];
+    }
+    return (int32_t)operand >> OPERAND_TAG_BITS;  /* ƻԭ */
+}
 
-    if (node == NULL) return NULL;
+/* ʾıȡűе֣ʽ buffer 16 ֽڣ */
+static const char* operand_text(Compiler* compiler, IROperand operand, char* buffer)
+{
+    switch (operand_tag(operand)) {
+    case OPERAND_VAR:
+        return symbol_name(&compiler->symbols, compiler->vars[operand_index(operand)].symbol);
+    case OPERAND_TEMP:
+        sprintf_s(buffer, 16, "t%d", operand_index(operand));
+        return buffer;
+    case OPERAND_IMM:
+    case OPERAND_POOL:
+        sprintf_s(buffer, 16, "%d", (int)operand_constant(compiler, operand));
+        return buffer;
+    default:
+        return "";
+    }
+}
 
-    switch (node->type) {
-    case NODE_VARIABLE:
-        /* ֱӷ */
-        return node->value;
+/* ֶӦıδʱ OPERAND_NONE */
+static IROperand variable_operand(Compiler* compiler, int symbol)
+{
+    int var = variable_of(compiler, symbol);
 
-    case NODE_CONSTANT:
-        /* ɼָ */
-        if (compiler->ir_count >= MAX_TOKENS) return NULL;
+    if (var < 0) {
+        compile_error(compiler, "󣺱 %s δ\n", symbol_name(&compiler->symbols, symbol));
+        return OPERAND_NONE;
+    }
+    return make_operand(OPERAND_VAR, var);
+}
 
-        ir = &compiler->ir_code[compiler->ir_count];
-        result_temp = new_temp_var(compiler);
+/* ʽջһڵ±꼰Ƿչ */
+typedef struct {
+    int32_t node;
+    int expanded;
+} IRWorkItem;
 
-        ir->type = IR_ASSIGN_CONST;
-        strcpy(ir->op, "=");
-        strcpy(ir->dest, result_temp);
-        strcpy(ir->src1, node->value);
-        ir->constant = atoi(node->value);
-        compiler->ir_count++;
+/* ɱʽм룺ʽջд *resultʽ 0 */
+int generate_expression_ir(Compiler* compiler, int32_t root, IROperand* result)
+{
+    IRWorkItem* work;
+    IROperand* values;
+    IRInstruction* ir;
+    int work_sp = 0;
+    int value_sp = 0;
+    int ok = 1;
+    IRType type = IR_ADD;
+
+    if (root < 0) return 0;
+
+    /* ջȶڵ */
+    work = (IRWorkItem*)malloc((size_t)compiler->node_count * sizeof(IRWorkItem));
+    values = (IROperand*)malloc((size_t)compiler->node_count * sizeof(IROperand));
+    if (work == NULL || values == NULL) {
+        compile_error(compiler, "ڴʧܣʽջ\n");
+        free(work);
+        free(values);
+        return 0;
+    }
 
-        return result_temp;
+    work[work_sp].node = root;
+    work[work_sp++].expanded = 0;
 
-    case NODE_BINARY_OP:
-        /* ݹ鴦 */
-        temp1 = generate_expression_ir(compiler, node->left);
-        temp2 = generate_expression_ir(compiler, node->right);
+    while (ok && work_sp > 0) {
+        IRWorkItem item = work[--work_sp];
+        const ASTNode* node = &compiler->nodes[item.node];
 
-        if (temp1 == NULL || temp2 == NULL) {
-            return NULL;
-        }
+        switch (node->type) {
+        case NODE_VARIABLE:
+            /* ֱΪ */
+            values[value_sp] = variable_operand(compiler, node->value);
+            ok = values[value_sp++] != OPERAND_NONE;
+            break;
 
-        /* ɶԪָ */
-        if (compiler->ir_count >= MAX_TOKENS) return NULL;
+        case NODE_CONSTANT:
+            /* ֱΪٵɼָ */
+            values[value_sp] = make_constant(compiler, node->value);
+            ok = values[value_sp++] != OPERAND_NONE;
+            break;
 
-        ir = &compiler->ir_code[compiler->ir_count];
-        result_temp = new_temp_var(compiler);
+        case NODE_BINARY_OP:
+            if (!item.expanded) {
+                /* ȴٻصڵ */
+                if (node->left < 0 || node->right < 0) {
+                    ok = 0;
+                    break;
+                }
+                work[work_sp].node = item.node;
+                work[work_sp++].expanded = 1;
+                work[work_sp].node = node->right;
+                work[work_sp++].expanded = 0;
+                work[work_sp].node = node->left;
+                work[work_sp++].expanded = 0;
+                break;
+            }
 
-        if (strcmp(node->value, "+") == 0) {
-            ir->type = IR_ADD;
-            strcpy(ir->op, "+");
-        }
-        else if (strcmp(node->value, "-") == 0) {
-            ir->type = IR_SUB;
-            strcpy(ir->op, "-");
-        }
-        else if (strcmp(node->value, "*") == 0) {
-            ir->type = IR_MUL;
-            strcpy(ir->op, "*");
-        }
-        else if (strcmp(node->value, "/") == 0) {
-            ir->type = IR_DIV;
-            strcpy(ir->op, "/");
-        }
-        else {
-            return NULL;
-        }
+            switch (node->value) {
+            case '+': type = IR_ADD; break;
+            case '-': type = IR_SUB; break;
+            case '*': type = IR_MUL; break;
+            case '/': type = IR_DIV; break;
+            case '%': type = IR_MOD; break;
+            default: ok = 0; break;
+            }
+            if (!ok) break;
 
-        strcpy(ir->dest, result_temp);
-        strcpy(ir->src1, temp1);
-        strcpy(ir->src2, temp2);
-        compiler->ir_count++;
+            /* ɶԪָҲջ */
+            ir = ir_new(compiler, type);
+            if (ir == NULL) {
+                ok = 0;
+                break;
+            }
+            value_sp -= 2;
+            ir->dest = new_temp_var(compiler);
+            ir->src1 = values[value_sp];
+            ir->src2 = values[value_sp + 1];
+            values[value_sp++] = ir->dest;
+            break;
 
-        return result_temp;
+        default:
+            ok = 0;
+            break;
+        }
+    }
 
-    default:
-        return NULL;
+    if (ok) {
+        *result = values[0];
     }
+    free(work);
+    free(values);
+    return ok;
 }
 
 /* м */
 void generate_ir(Compiler* compiler)
 {
-    ASTNode* current = compiler->ast_root ? compiler->ast_root->left : NULL;
+    const ASTNode* current;
     IRInstruction* ir;
-    char* temp_var;
+    IROperand target;
+    IROperand value;
+    int i;
 
     compiler->temp_var_counter = 0;  // ʱ
 
-    while (current != NULL) {
-        if (compiler->ir_count >= MAX_TOKENS) break;
+    /* ÿһм루=inputoutputһη */
+    compiler->ir_count = 0;
+    compiler->ir_capacity = compiler->tokens.count;
+    compiler->ir_code = (IRInstruction*)arena_alloc(&compiler->arena,
+        (size_t)compiler->ir_capacity * sizeof(IRInstruction));
+    if (compiler->ir_code == NULL) {
+        compile_error(compiler, "ڴʧܣм\n");
+        compiler->ir_capacity = 0;
+        return;
+    }
+
+    for (i = 0; i < compiler->statement_count; i++) {
+        current = &compiler->nodes[compiler->statements[i]];
 
         switch (current->type) {
         case NODE_INPUT:
-            if (compiler->ir_count >= MAX_TOKENS) break;
-            ir = &compiler->ir_code[compiler->ir_count];
-            ir->type = IR_INPUT;
-            strcpy(ir->op, "input");
-            strcpy(ir->dest, current->value);
-            compiler->ir_count++;
+            target = variable_operand(compiler, current->value);
+            if (target == OPERAND_NONE) break;
+            ir = ir_new(compiler, IR_INPUT);
+            if (ir == NULL) break;
+            ir->dest = target;
             break;
 
         case NODE_OUTPUT:
-            if (compiler->ir_count >= MAX_TOKENS) break;
-            ir = &compiler->ir_code[compiler->ir_count];
-            ir->type = IR_OUTPUT;
-            strcpy(ir->op, "output");
-            strcpy(ir->src1, current->value);
-            compiler->ir_count++;
+            value = variable_operand(compiler, current->value);
+            if (value == OPERAND_NONE) break;
+            ir = ir_new(compiler, IR_OUTPUT);
+            if (ir == NULL) break;
+            ir->src1 = value;
             break;
 
         case NODE_ASSIGNMENT:
-            /* ݹɱʽм */
-            temp_var = generate_expression_ir(compiler, current->left);
-            if (temp_var != NULL && compiler->ir_count < MAX_TOKENS) {
+            /* ɱʽм */
+            target = variable_operand(compiler, current->value);
+            if (target == OPERAND_NONE) break;
+            if (generate_expression_ir(compiler, current->left, &value)) {
                 /* ɸֵָ */
-                ir = &compiler->ir_code[compiler->ir_count];
-                ir->type = IR_ASSIGN;
-                strcpy(ir->op, "=");
-                strcpy(ir->dest, current->value);
-                strcpy(ir->src1, temp_var);
-                compiler->ir_count++;
+                ir = ir_new(compiler, IR_ASSIGN);
+                if (ir == NULL) break;
+                ir->dest = target;
+                ir->src1 = value;
             }
             break;
 
         default:
             break;
         }
-
-        current = current->right;
     }
 }
 
+/* мı IRType ˳ */
+static const char* const ir_type_name[] = { "input", "output", "=", "+", "-", "*", "/", "%" };
+
 /* Ľмӡ */
-void print_ir(Compiler* compiler, FILE* output_file)
+void print_ir(Compiler* compiler, FILE* output_file, const char* title)
 {
+    char dest_buffer[16];
+    char src1_buffer[16];
+    char src2_buffer[16];
     int i;
-    print_to_both(output_file, "=== мɽ (ַ) ===\n");
-    print_to_both(output_file, "%-6s %-8s %-10s %-10s %-10s\n", "", "", "Ŀ", "Դ1", "Դ2");
-    print_to_both(output_file, "-------------------------------------------------\n");
 
+    dump_printf(compiler, output_file, "=== %s ===\n", title);
+    dump_printf(compiler, output_file, "%-6s %-8s %-10s %-10s %-10s\n", "", "", "Ŀ", "Դ1", "Դ2");
+    dump_printf(compiler, output_file, "-------------------------------------------------\n");
+
+    for (i = 0; i < compiler->ir_count; i++) {
+        IRInstruction* ir = &compiler->ir_code[i];
+        const char* dest = operand_text(compiler, ir->dest, dest_buffer);
+        const char* src1 = operand_text(compiler, ir->src1, src1_buffer);
+        const char* src2 = operand_text(compiler, ir->src2, src2_buffer);
+
+        dump_printf(compiler, output_file, "%-6d %-8s %-10s %-10s %-10s\n",
+            i, ir->type <= IR_MOD ? ir_type_name[ir->type] : "unknown", dest, src1, src2);
+    }
+    dump_printf(compiler, output_file, "\n");
+
+    /* мıʾ */
+    dump_printf(compiler, output_file, "=== мıʾ ===\n");
     for (i = 0; i < compiler->ir_count; i++) {
         IRInstruction* ir = &compiler->ir_code[i];
+        const char* dest = operand_text(compiler, ir->dest, dest_buffer);
+        const char* src1 = operand_text(compiler, ir->src1, src1_buffer);
+        const char* src2 = operand_text(compiler, ir->src2, src2_buffer);
 
         switch (ir->type) {
         case IR_INPUT:
-            print_to_both(output_file, "%-6d %-8s %-10s %-10s %-10s\n",
-                i, "input", ir->dest, "", "");
+            dump_printf(compiler, output_file, "%-4d: input %s\n", i, dest);
             break;
 
         case IR_OUTPUT:
-            print_to_both(output_file, "%-6d %-8s %-10s %-10s %-10s\n",
-                i, "output", "", ir->src1, "");
+            dump_printf(compiler, output_file, "%-4d: output %s\n", i, src1);
             break;
 
         case IR_ASSIGN:
-            print_to_both(output_file, "%-6d %-8s %-10s %-10s %-10s\n",
-                i, "=", ir->dest, ir->src1, "");
-            break;
-
-        case IR_ASSIGN_CONST:
-            print_to_both(output_file, "%-6d %-8s %-10s %-10s %-10s\n",
-                i, "= const", ir->dest, ir->src1, "");
+            dump_printf(compiler, output_file, "%-4d: %s = %s\n", i, dest, src1);
             break;
 
         case IR_ADD:
-            print_to_both(output_file, "%-6d %-8s %-10s %-10s %-10s\n",
-                i, "+", ir->dest, ir->src1, ir->src2);
-            break;
-
         case IR_SUB:
-            print_to_both(output_file, "%-6d %-8s %-10s %-10s %-10s\n",
-                i, "-", ir->dest, ir->src1, ir->src2);
-            break;
-
         case IR_MUL:
-            print_to_both(output_file, "%-6d %-8s %-10s %-10s %-10s\n",
-                i, "*", ir->dest, ir->src1, ir->src2);
-            break;
-
         case IR_DIV:
-            print_to_both(output_file, "%-6d %-8s %-10s %-10s %-10s\n",
-                i, "/", ir->dest, ir->src1, ir->src2);
+        case IR_MOD:
+            dump_printf(compiler, output_file, "%-4d: %s = %s %s %s\n", i, dest, src1, ir_type_name[ir->type], src2);
             break;
 
         default:
-            print_to_both(output_file, "%-6d %-8s %-10s %-10s %-10s\n",
-                i, "unknown", "", "", "");
+            dump_printf(compiler, output_file, "%-4d: unknown\n", i);
             break;
         }
     }
-    print_to_both(output_file, "\n");
+    dump_printf(compiler, output_file, "\n");
+}
+
+/* мŻ */
+
+/* ֵ32 λƣΪ 0  INT_MIN / -1 ʱ۵ 0 */
+static int fold_binary(IRType type, int32_t a, int32_t b, int32_t* result)
+{
+    switch (type) {
+    case IR_ADD: *result = (int32_t)((uint32_t)a + (uint32_t)b); return 1;
+    case IR_SUB: *result = (int32_t)((uint32_t)a - (uint32_t)b); return 1;
+    case IR_MUL: *result = (int32_t)((uint32_t)a * (uint32_t)b); return 1;
+    case IR_DIV:
+        if (b == 0 || (a == INT32_MIN && b == -1)) return 0;
+        *result = a / b;
+        return 1;
+    case IR_MOD:
+        if (b == 0 || (a == INT32_MIN && b == -1)) return 0;
+        *result = a % b;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* ʱ֪е±꣺ǰʱں */
+static int value_slot(Compiler* compiler, IROperand operand)
+{
+    if (operand_tag(operand) == OPERAND_VAR) return operand_index(operand);
+    if (operand_tag(operand) == OPERAND_TEMP) return compiler->var_count + operand_index(operand);
+    return -1;
+}
+
+/* ۵볣һ飬˳ɨһ飬
+   ¼ÿʱǰǷΪֵ֪֪Ϊ
+   Դǳֱֵдʱָ֮ɾ
+   ɾָ */
+int fold_constants(Compiler* compiler)
+{
+    int slot_count = compiler->var_count + compiler->temp_var_counter;
+    unsigned char* known;
+    int32_t* values;
+    int kept = 0;
+    int removed;
+    int slot;
+    int i;
+
+    if (compiler->ir_count == 0) return 0;
+    known = (unsigned char*)arena_alloc(&compiler->arena, (size_t)slot_count + 1);
+    values = (int32_t*)arena_alloc(&compiler->arena, ((size_t)slot_count + 1) * sizeof(int32_t));
+    if (known == NULL || values == NULL) {
+        compile_error(compiler, "ڴʧܣ۵\n");
+        return 0;
+    }
+    memset(known, 0, (size_t)slot_count + 1);
 
-    /* мıʾ */
-    print_to_both(output_file, "=== мıʾ ===\n");
     for (i = 0; i < compiler->ir_count; i++) {
-        IRInstruction* ir = &compiler->ir_code[i];
+        IRInstruction ir = compiler->ir_code[i];
+        int32_t result;
 
-        switch (ir->type) {
-        case IR_INPUT:
-            print_to_both(output_file, "%-4d: input %s\n", i, ir->dest);
-            break;
+        /* Դе֪Ϊ */
+        slot = value_slot(compiler, ir.src1);
+        if (slot >= 0 && known[slot]) ir.src1 = make_constant(compiler, values[slot]);
+        slot = value_slot(compiler, ir.src2);
+        if (slot >= 0 && known[slot]) ir.src2 = make_constant(compiler, values[slot]);
 
-        case IR_OUTPUT:
-            print_to_both(output_file, "%-4d: output %s\n", i, ir->src1);
-            break;
+        slot = value_slot(compiler, ir.dest);
+        if (slot >= 0) known[slot] = 0;
 
+        switch (ir.type) {
         case IR_ASSIGN:
-            print_to_both(output_file, "%-4d: %s = %s\n", i, ir->dest, ir->src1);
-            break;
-
-        case IR_ASSIGN_CONST:
-            print_to_both(output_file, "%-4d: %s = %s\n", i, ir->dest, ir->src1);
+            if (is_constant_operand(ir.src1) && slot >= 0) {
+                known[slot] = 1;
+                values[slot] = operand_constant(compiler, ir.src1);
+            }
             break;
 
         case IR_ADD:
-            print_to_both(output_file, "%-4d: %s = %s + %s\n", i, ir->dest, ir->src1, ir->src2);
-            break;
-
         case IR_SUB:
-            print_to_both(output_file, "%-4d: %s = %s - %s\n", i, ir->dest, ir->src1, ir->src2);
-            break;
-
         case IR_MUL:
-            print_to_both(output_file, "%-4d: %s = %s * %s\n", i, ir->dest, ir->src1, ir->src2);
-            break;
-
         case IR_DIV:
-            print_to_both(output_file, "%-4d: %s = %s / %s\n", i, ir->dest, ir->src1, ir->src2);
+        case IR_MOD:
+            if (is_constant_operand(ir.src1) && is_constant_operand(ir.src2) &&
+                fold_binary((IRType)ir.type, operand_constant(compiler, ir.src1),
+                    operand_constant(compiler, ir.src2), &result)) {
+                /* ۵Ϊֵ */
+                ir.type = IR_ASSIGN;
+                ir.src1 = make_constant(compiler, result);
+                ir.src2 = OPERAND_NONE;
+            }
+            else if (ir.type == IR_MUL &&
+                ((is_constant_operand(ir.src1) && operand_constant(compiler, ir.src1) == 0) ||
+                    (is_constant_operand(ir.src2) && operand_constant(compiler, ir.src2) == 0))) {
+                /* x * 0 = 0 */
+                ir.type = IR_ASSIGN;
+                ir.src1 = make_constant(compiler, 0);
+                ir.src2 = OPERAND_NONE;
+            }
+            if (ir.type == IR_ASSIGN && slot >= 0) {
+                known[slot] = 1;
+                values[slot] = operand_constant(compiler, ir.src1);
+            }
             break;
 
         default:
-            print_to_both(output_file, "%-4d: unknown\n", i);
             break;
         }
+
+        /* ʱֵֻһΡֻʹãֵ֪ʹôᱻ룬ɾ */
+        if (ir.type == IR_ASSIGN && operand_tag(ir.dest) == OPERAND_TEMP && is_constant_operand(ir.src1)) {
+            continue;
+        }
+        compiler->ir_code[kept++] = ir;
     }
-    print_to_both(output_file, "\n");
+
+    removed = compiler->ir_count - kept;
+    compiler->ir_count = kept;
+    return removed;
 }
 
-/* ɻ */
-void generate_assembly(Compiler* compiler)
+/* ֲֵŵıͼԴֵ
+   Ӧֵ holder Уholder ¸ֵ汾ű仯 */
+typedef struct {
+    uint32_t type;          /* 0 ʾղ */
+    IROperand holder;
+    int holder_version;
+    uint64_t left;
+    uint64_t right;
+} ValueEntry;
+
+/* ֵֵʱۺţֵ汾ţ
+   ͬһθֵ֮ʹõõͬļ */
+static uint64_t value_key(Compiler* compiler, IROperand operand, const int* version)
 {
-    int i;
-    int stack_size;
-    IRInstruction* ir;
-    int dest_var;
-    int src1_var;
-    int src2_var;
+    int slot = value_slot(compiler, operand);
+    if (slot < 0) {
+        return ((uint64_t)1 << 63) | (uint32_t)operand_constant(compiler, operand);
+    }
+    return ((uint64_t)(uint32_t)slot << 32) | (uint32_t)version[slot];
+}
 
-    /* ӻͷ */
-    emit_code(compiler, "=== ջ ===\n");
-    emit_code(compiler, ".section .rodata\n");
-    emit_code(compiler, ".LC0:\n");
-    emit_code(compiler, "    .string \"%%d\"\n");
-    emit_code(compiler, ".LC1:\n");
-    emit_code(compiler, "    .string \"%%d\\\\n\"\n");
-    emit_code(compiler, "\n");
-    emit_code(compiler, ".section .text\n");
-    emit_code(compiler, ".globl main\n");
-    emit_code(compiler, "main:\n");
-    emit_code(compiler, "    pushq   %%rbp\n");
-    emit_code(compiler, "    movq    %%rsp, %%rbp\n");
+/* ֲֵţӱʽɾһ飬˳ɨ裬
+   ԣ㣬Դ 1 ֵԴ 2 ֵ+  * Դ
+   ұֵıʱδ¸ֵʱдΪĸд
+   ɸдɾȥظдָ */
+int number_values(Compiler* compiler)
+{
+    int slot_count = compiler->var_count + compiler->temp_var_counter;
+    int* version;
+    ValueEntry* table;
+    size_t capacity = 16;
+    size_t mask;
+    int reused = 0;
+    int i;
 
-    /* ջռ - ʱ */
-    stack_size = (compiler->var_count + compiler->temp_var_counter) * 4 + 16;
-    emit_code(compiler, "    subq    $%d, %%rsp  # Ϊֲռ\n\n", stack_size);
+    if (compiler->ir_count == 0) return 0;
+    while (capacity < (size_t)compiler->ir_count * 2) capacity <<= 1;
+    mask = capacity - 1;
+    version = (int*)arena_alloc(&compiler->arena, ((size_t)slot_count + 1) * sizeof(int));
+    table = (ValueEntry*)arena_alloc(&compiler->arena, capacity * sizeof(ValueEntry));
+    if (version == NULL || table == NULL) {
+        compile_error(compiler, "ڴʧܣֲֵ\n");
+        return 0;
+    }
+    memset(version, 0, ((size_t)slot_count + 1) * sizeof(int));
+    memset(table, 0, capacity * sizeof(ValueEntry));
 
-    /* мɻ */
     for (i = 0; i < compiler->ir_count; i++) {
-        ir = &compiler->ir_code[i];
-
-        switch (ir->type) {
-        case IR_INPUT:
-            dest_var = find_variable(compiler, ir->dest);
-            if (dest_var != -1) {
-                emit_code(compiler, "    # input(%s)\n", ir->dest);
-                emit_code(compiler, "    leaq    -%d(%%rbp), %%rsi\n", compiler->vars[dest_var].offset);
-                emit_code(compiler, "    movl    $.LC0, %%edi\n");
-                emit_code(compiler, "    movl    $0, %%eax\n");
-                emit_code(compiler, "    call    scanf\n");
+        IRInstruction* ir = &compiler->ir_code[i];
+        ValueEntry* entry = NULL;
+        int dest_slot;
+
+        if (ir->type >= IR_ADD && ir->type <= IR_MOD) {
+            uint64_t left = value_key(compiler, ir->src1, version);
+            uint64_t right = value_key(compiler, ir->src2, version);
+            uint64_t hash;
+            size_t index;
+
+            if ((ir->type == IR_ADD || ir->type == IR_MUL) && left > right) {
+                uint64_t swap = left;
+                left = right;
+                right = swap;
             }
-            break;
-
-        case IR_OUTPUT:
-            src1_var = find_variable(compiler, ir->src1);
-            if (src1_var != -1) {
-                emit_code(compiler, "    # output(%s)\n", ir->src1);
-                emit_code(compiler, "    movl    -%d(%%rbp), %%esi\n", compiler->vars[src1_var].offset);
-                emit_code(compiler, "    movl    $.LC1, %%edi\n");
-                emit_code(compiler, "    movl    $0, %%eax\n");
-                emit_code(compiler, "    call    printf\n");
+            hash = (left * 0x9E3779B97F4A7C15ULL) ^ (right + 0x632BE59BD9B4E019ULL + (uint64_t)ir->type);
+            hash ^= hash >> 29;
+            index = (size_t)(hash * 0xBF58476D1CE4E5B9ULL >> 32) & mask;
+
+            for (;;) {
+                entry = &table[index];
+                if (entry->type == 0) break;
+                if (entry->type == ir->type && entry->left == left && entry->right == right) break;
+                index = (index + 1) & mask;
             }
-            break;
 
-        case IR_ASSIGN:
-            /* ֵָdest = src1 */
-            if (is_temp_var(ir->dest)) {
-                /* ĿΪʱҪҵ洢λ */
-                dest_var = get_temp_var_offset(compiler, ir->dest);
-                src1_var = find_variable(compiler, ir->src1);
-                if (src1_var != -1) {
-                    emit_code(compiler, "    # %s = %s\n", ir->dest, ir->src1);
-                    emit_code(compiler, "    movl    -%d(%%rbp), %%eax\n", compiler->vars[src1_var].offset);
-                    emit_code(compiler, "    movl    %%eax, -%d(%%rbp)\n", dest_var);
-                }
+            if (entry->type != 0 &&
+                entry->holder_version == version[value_slot(compiler, entry->holder)]) {
+                /* ظ㣺дΪд */
+                ir->type = IR_ASSIGN;
+                ir->src1 = entry->holder;
+                ir->src2 = OPERAND_NONE;
+                entry = NULL;
+                reused++;
             }
             else {
-                /* ĿΪͨ */
-                dest_var = find_variable(compiler, ir->dest);
-                if (is_temp_var(ir->src1)) {
-                    /* ԴΪʱ */
-                    src1_var = get_temp_var_offset(compiler, ir->src1);
-                    if (dest_var != -1) {
-                        emit_code(compiler, "    # %s = %s\n", ir->dest, ir->src1);
-                        emit_code(compiler, "    movl    -%d(%%rbp), %%eax\n", src1_var);
-                        emit_code(compiler, "    movl    %%eax, -%d(%%rbp)\n", compiler->vars[dest_var].offset);
-                    }
-                }
-                else {
-                    /* ԴΪͨ */
-                    src1_var = find_variable(compiler, ir->src1);
-                    if (dest_var != -1 && src1_var != -1) {
-                        emit_code(compiler, "    # %s = %s\n", ir->dest, ir->src1);
-                        emit_code(compiler, "    movl    -%d(%%rbp), %%eax\n", compiler->vars[src1_var].offset);
-                        emit_code(compiler, "    movl    %%eax, -%d(%%rbp)\n", compiler->vars[dest_var].offset);
-                    }
-                }
+                entry->type = ir->type;
+                entry->left = left;
+                entry->right = right;
             }
-            break;
+        }
 
-        case IR_ASSIGN_CONST:
-            /* ֵdest = const */
-            if (is_temp_var(ir->dest)) {
-                dest_var = get_temp_var_offset(compiler, ir->dest);
-                emit_code(compiler, "    # %s = %s\n", ir->dest, ir->src1);
-                emit_code(compiler, "    movl    $%s, %%eax\n", ir->src1);
-                emit_code(compiler, "    movl    %%eax, -%d(%%rbp)\n", dest_var);
-            }
-            else {
-                dest_var = find_variable(compiler, ir->dest);
-                if (dest_var != -1) {
-                    emit_code(compiler, "    # %s = %s\n", ir->dest, ir->src1);
-                    emit_code(compiler, "    movl    $%s, %%eax\n", ir->src1);
-                    emit_code(compiler, "    movl    %%eax, -%d(%%rbp)\n", compiler->vars[dest_var].offset);
-                }
-            }
-            break;
+        dest_slot = value_slot(compiler, ir->dest);
+        if (dest_slot >= 0) version[dest_slot]++;
+        if (entry != NULL) {
+            /* ĿУĿͬʱԴʱþɰ汾 */
+            entry->holder = ir->dest;
+            entry->holder_version = version[dest_slot];
+        }
+    }
+    return reused;
+}
 
-        case IR_ADD:
-            /* ӷdest = src1 + src2 */
-            if (is_temp_var(ir->dest)) {
-                dest_var = get_temp_var_offset(compiler, ir->dest);
-                /* Դ1 */
-                if (is_temp_var(ir->src1)) {
-                    src1_var = get_temp_var_offset(compiler, ir->src1);
-                    emit_code(compiler, "    movl    -%d(%%rbp), %%eax\n", src1_var);
-                }
-                else {
-                    src1_var = find_variable(compiler, ir->src1);
-                    if (src1_var != -1) {
-                        emit_code(compiler, "    movl    -%d(%%rbp), %%eax\n", compiler->vars[src1_var].offset);
-                    }
-                    else {
-                        /* ǳ */
-                        emit_code(compiler, "    movl    $%s, %%eax\n", ir->src1);
-                    }
-                }
+/* д
+   1. t = a op b ֮м䲻д v v = t t ֻڴ˴ʹʱ
+      ֱд v ɾд
+   2. ˳ɨ裬¼ x = y ʽĸд xy δ¸ֵǰ x ʹ滻Ϊ y
+      ÿ۵ĸֵ汾жϸдǷȻЧ¸ֵʱϡ
+   ɾָʧȥʹߵĸдɾ */
+int propagate_copies(Compiler* compiler)
+{
+    int slot_count = compiler->var_count + compiler->temp_var_counter;
+    IROperand* copy_of;
+    int* copy_version;
+    int* version;
+    int* uses;
+    int kept = 0;
+    int removed;
+    int slot;
+    int i;
+    int j;
+
+    if (compiler->ir_count == 0) return 0;
+    copy_of = (IROperand*)arena_alloc(&compiler->arena, ((size_t)slot_count + 1) * sizeof(IROperand));
+    copy_version = (int*)arena_alloc(&compiler->arena, ((size_t)slot_count + 1) * sizeof(int));
+    version = (int*)arena_alloc(&compiler->arena, ((size_t)slot_count + 1) * sizeof(int));
+    uses = (int*)arena_alloc(&compiler->arena, ((size_t)slot_count + 1) * sizeof(int));
+    if (copy_of == NULL || copy_version == NULL || version == NULL || uses == NULL) {
+        compile_error(compiler, "ڴʧܣд\n");
+        return 0;
+    }
+    memset(copy_of, 0, ((size_t)slot_count + 1) * sizeof(IROperand));
+    memset(version, 0, ((size_t)slot_count + 1) * sizeof(int));
+    memset(uses, 0, ((size_t)slot_count + 1) * sizeof(int));
 
-                /* Դ2 */
-                if (is_temp_var(ir->src2)) {
-                    src2_var = get_temp_var_offset(compiler, ir->src2);
-                    emit_code(compiler, "    addl    -%d(%%rbp), %%eax\n", src2_var);
-                }
-                else {
-                    src2_var = find_variable(compiler, ir->src2);
-                    if (src2_var != -1) {
-                        emit_code(compiler, "    addl    -%d(%%rbp), %%eax\n", compiler->vars[src2_var].offset);
-                    }
-                    else {
-                        /* ǳ */
-                        emit_code(compiler, "    addl    $%s, %%eax\n", ir->src2);
-                    }
-                }
+    /* һֱдĿ */
+    for (i = 0; i < compiler->ir_count; i++) {
+        IRInstruction* ir = &compiler->ir_code[i];
+        slot = value_slot(compiler, ir->src1);
+        if (slot >= 0) uses[slot]++;
+        slot = value_slot(compiler, ir->src2);
+        if (slot >= 0) uses[slot]++;
+    }
 
-                emit_code(compiler, "    movl    %%eax, -%d(%%rbp)  # %s = %s + %s\n",
-                    dest_var, ir->dest, ir->src1, ir->src2);
+    for (i = 0; i < compiler->ir_count; i++) {
+        IRInstruction ir = compiler->ir_code[i];
+
+        if (ir.type == IR_ASSIGN && operand_tag(ir.src1) == OPERAND_TEMP &&
+            operand_tag(ir.dest) == OPERAND_VAR && uses[value_slot(compiler, ir.src1)] == 1) {
+            int conflict = 0;
+
+            /* ѱָǰ t Ķ壬;д v ָ */
+            for (j = kept - 1; j >= 0; j--) {
+                IRInstruction* between = &compiler->ir_code[j];
+                if (between->dest == ir.src1) break;
+                if (between->dest == ir.dest || between->src1 == ir.dest || between->src2 == ir.dest) {
+                    conflict = 1;
+                    break;
+                }
             }
-            break;
+            if (!conflict && j >= 0) {
+                compiler->ir_code[j].dest = ir.dest;
+                continue;
+            }
+        }
+        compiler->ir_code[kept++] = ir;
+    }
 
-        case IR_MUL:
-            /* ˷dest = src1 * src2 */
-            if (is_temp_var(ir->dest)) {
-                dest_var = get_temp_var_offset(compiler, ir->dest);
-                /* Դ1 */
-                if (is_temp_var(ir->src1)) {
-                    src1_var = get_temp_var_offset(compiler, ir->src1);
-                    emit_code(compiler, "    movl    -%d(%%rbp), %%eax\n", src1_var);
+    removed = compiler->ir_count - kept;
+    compiler->ir_count = kept;
+
+    /* ڶд */
+    for (i = 0; i < compiler->ir_count; i++) {
+        IRInstruction* ir = &compiler->ir_code[i];
+        int source;
+
+        slot = value_slot(compiler, ir->src1);
+        if (slot >= 0 && copy_of[slot] != OPERAND_NONE &&
+            copy_version[slot] == version[value_slot(compiler, copy_of[slot])]) {
+            ir->src1 = copy_of[slot];
+        }
+        slot = value_slot(compiler, ir->src2);
+        if (slot >= 0 && copy_of[slot] != OPERAND_NONE &&
+            copy_version[slot] == version[value_slot(compiler, copy_of[slot])]) {
+            ir->src2 = copy_of[slot];
+        }
+
+        slot = value_slot(compiler, ir->dest);
+        if (slot < 0) continue;
+        version[slot]++;
+        copy_of[slot] = OPERAND_NONE;
+        source = value_slot(compiler, ir->src1);
+        if (ir->type == IR_ASSIGN && source >= 0 && source != slot) {
+            copy_of[slot] = ir->src1;
+            copy_version[slot] = version[source];
+        }
+    }
+
+    return removed;
+}
+
+/* ڻԾԵɾӺǰɨ裬ʱûлԾֵ
+   Ծûиõָɾinput ȡ롢output ʼձ
+   ɾָ */
+int eliminate_dead_code(Compiler* compiler)
+{
+    int slot_count = compiler->var_count + compiler->temp_var_counter;
+    unsigned char* live;
+    int kept;
+    int removed;
+    int slot;
+    int i;
+
+    if (compiler->ir_count == 0) return 0;
+    live = (unsigned char*)arena_alloc(&compiler->arena, (size_t)slot_count + 1);
+    if (live == NULL) {
+        compile_error(compiler, "ڴʧܣɾ\n");
+        return 0;
+    }
+    memset(live, 0, (size_t)slot_count + 1);
+
+    /* ѹָβǰţǰ */
+    kept = compiler->ir_count;
+    for (i = compiler->ir_count - 1; i >= 0; i--) {
+        IRInstruction ir = compiler->ir_code[i];
+
+        slot = value_slot(compiler, ir.dest);
+        if (ir.type != IR_INPUT && ir.type != IR_OUTPUT && slot >= 0 && !live[slot]) {
+            continue;
+        }
+        if (slot >= 0) live[slot] = 0;
+        slot = value_slot(compiler, ir.src1);
+        if (slot >= 0) live[slot] = 1;
+        slot = value_slot(compiler, ir.src2);
+        if (slot >= 0) live[slot] = 1;
+        compiler->ir_code[--kept] = ir;
+    }
+
+    removed = kept;
+    if (removed > 0) {
+        memmove(compiler->ir_code, compiler->ir_code + kept,
+            (size_t)(compiler->ir_count - kept) * sizeof(IRInstruction));
+        compiler->ir_count -= kept;
+    }
+    return removed;
+}
+
+/* ״ζ˳±ʹõʱɾʱռջ */
+void renumber_temps(Compiler* compiler)
+{
+    int* new_id;
+    int count = 0;
+    int i;
+
+    if (compiler->temp_var_counter == 0) return;
+    new_id = (int*)arena_alloc(&compiler->arena, (size_t)compiler->temp_var_counter * sizeof(int));
+    if (new_id == NULL) return;
+    for (i = 0; i < compiler->temp_var_counter; i++) new_id[i] = -1;
+
+    for (i = 0; i < compiler->ir_count; i++) {
+        IRInstruction* ir = &compiler->ir_code[i];
+        if (operand_tag(ir->src1) == OPERAND_TEMP) {
+            ir->src1 = make_operand(OPERAND_TEMP, new_id[operand_index(ir->src1)]);
+        }
+        if (operand_tag(ir->src2) == OPERAND_TEMP) {
+            ir->src2 = make_operand(OPERAND_TEMP, new_id[operand_index(ir->src2)]);
+        }
+        if (operand_tag(ir->dest) == OPERAND_TEMP) {
+            int id = operand_index(ir->dest);
+            if (new_id[id] < 0) new_id[id] = count++;
+            ir->dest = make_operand(OPERAND_TEMP, new_id[id]);
+        }
+    }
+    compiler->temp_var_counter = count;
+}
+
+/* мŻиŻ飬ɾָ compiler->stats */
+int optimize_ir(Compiler* compiler)
+{
+    compiler->stats.temps_before = compiler->temp_var_counter;
+    compiler->stats.folded = fold_constants(compiler);
+    compiler->stats.reused = number_values(compiler);
+    compiler->stats.copies = propagate_copies(compiler);
+    compiler->stats.dead = eliminate_dead_code(compiler);
+    renumber_temps(compiler);
+    compiler->stats.temps_after = compiler->temp_var_counter;
+    return compiler->stats.folded + compiler->stats.copies + compiler->stats.dead;
+}
+
+/* ָѡ */
+
+/* ʽֻʹһεʱɼӡ˻Է㳣
+   ͺϲʹָУָѡһÿڵϲһ
+   ࣨɽĲһϲָٵ
+   ɴ룬ԴȡĴݴӳԾ䡣
+   Աܴ쳣ϲ֤쳣ԭλáغϲָ */
+int build_expression_trees(Compiler* compiler)
+{
+    int temp_count = compiler->temp_var_counter;
+    int32_t* definition;
+    int32_t* uses;
+    int folded = 0;
+    int i;
+    int j;
+
+    compiler->tree_root = NULL;
+    compiler->tree_child = NULL;
+    compiler->tree_folded = 0;
+    if (compiler->ir_count == 0) return 0;
+
+    compiler->tree_root = (int32_t*)arena_alloc(&compiler->arena, (size_t)compiler->ir_count * sizeof(int32_t));
+    compiler->tree_child = (int32_t*)arena_alloc(&compiler->arena, (size_t)compiler->ir_count * sizeof(int32_t));
+    definition = (int32_t*)arena_alloc(&compiler->arena, ((size_t)temp_count + 1) * sizeof(int32_t));
+    uses = (int32_t*)arena_alloc(&compiler->arena, ((size_t)temp_count + 1) * sizeof(int32_t));
+    if (compiler->tree_root == NULL || compiler->tree_child == NULL || definition == NULL || uses == NULL) {
+        compile_error(compiler, "ڴʧܣʽ\n");
+        compiler->tree_root = NULL;
+        compiler->tree_child = NULL;
+        return 0;
+    }
+
+    /* ÿʱĸֵλãθֵΪ -2ʹô */
+    for (i = 0; i < temp_count; i++) {
+        definition[i] = -1;
+        uses[i] = 0;
+    }
+    for (i = 0; i < compiler->ir_count; i++) {
+        IRInstruction* ir = &compiler->ir_code[i];
+        if (operand_tag(ir->src1) == OPERAND_TEMP) uses[operand_index(ir->src1)]++;
+        if (operand_tag(ir->src2) == OPERAND_TEMP) uses[operand_index(ir->src2)]++;
+        if (operand_tag(ir->dest) == OPERAND_TEMP) {
+            int temp = operand_index(ir->dest);
+            definition[temp] = definition[temp] == -1 ? i : -2;
+        }
+        compiler->tree_root[i] = -1;
+        compiler->tree_child[i] = -1;
+    }
+
+    for (j = 0; j < compiler->ir_count; j++) {
+        IRInstruction* ir = &compiler->ir_code[j];
+        IROperand candidates[2];
+        int count;
+        int k;
+
+        if (ir->type == IR_INPUT) continue;
+        candidates[0] = ir->src1;
+        candidates[1] = ir->src2;
+        /* ܿԺϲҲֻڿɽкϲ */
+        count = ir->type == IR_ADD || ir->type == IR_MUL ? 2 : 1;
+        for (k = 0; k < count; k++) {
+            IRInstruction* child;
+            int temp;
+            int i_def;
+
+            if (operand_tag(candidates[k]) != OPERAND_TEMP) continue;
+            temp = operand_index(candidates[k]);
+            i_def = definition[temp];
+            if (i_def < 0 || i_def >= j || uses[temp] != 1) continue;
+            child = &compiler->ir_code[i_def];
+            if (child->type < IR_ADD) continue;
+            if ((child->type == IR_DIV || child->type == IR_MOD) &&
+                (!is_constant_operand(child->src2) || operand_constant(compiler, child->src2) == 0)) {
+                continue;
+            }
+            compiler->tree_child[j] = i_def;
+            folded++;
+            break;
+        }
+    }
+
+    /* ϲָҲϲϣʹں棩 */
+    for (i = compiler->ir_count - 1; i >= 0; i--) {
+        int child = compiler->tree_child[i];
+        if (child >= 0) compiler->tree_root[child] = compiler->tree_root[i] >= 0 ? compiler->tree_root[i] : i;
+    }
+
+    compiler->tree_folded = folded;
+    return folded;
+}
+
+/* Ĵ */
+
+/* ɷļĴǰ REG_CALLER_SAVED Ϊ߱棬Խ scanf/printf õֵ
+   ֻܷı߱ĴУ%eax%ecx%edx ͳʱĴ
+   %esi%edi ڴ */
+#define REG_COUNT 9
+#define REG_CALLER_SAVED 4
+static const int8_t allocatable_register[REG_COUNT] = {
+    REG_R8, REG_R9, REG_R10, REG_R11, REG_RBX, REG_R12, REG_R13, REG_R14, REG_R15
+};
+
+/* ɨĴ䣺һ飬ʱÿθֵһʹ
+   һԾ䣨ͬһĲֵͬԷֵͬĴ䰴˳ɨ裬
+   㴦ͷţͬһָȶԴдĿ꣩Ĵʱ
+   յԶ䣬ԭջС */
+int allocate_registers(Compiler* compiler)
+{
+    RegisterAllocation* regs = &compiler->regs;
+    int slot_count = compiler->var_count + compiler->temp_var_counter;
+    int* current;
+    int* calls_before;
+    int active[REG_COUNT];
+    int active_count = 0;
+    unsigned free_mask = (1u << REG_COUNT) - 1;
+    int i;
+    int j;
+
+    regs->intervals = NULL;
+    regs->interval_count = 0;
+    regs->used_registers = 0;
+    regs->spilled = 0;
+    if (compiler->ir_count == 0) return 0;
+
+    regs->intervals = (LiveInterval*)arena_alloc(&compiler->arena,
+        (size_t)compiler->ir_count * 3 * sizeof(LiveInterval));
+    regs->operand_interval = (int32_t*)arena_alloc(&compiler->arena,
+        (size_t)compiler->ir_count * 3 * sizeof(int32_t));
+    current = (int*)arena_alloc(&compiler->arena, ((size_t)slot_count + 1) * sizeof(int));
+    calls_before = (int*)arena_alloc(&compiler->arena, ((size_t)compiler->ir_count + 1) * sizeof(int));
+    if (regs->intervals == NULL || regs->operand_interval == NULL || current == NULL || calls_before == NULL) {
+        compile_error(compiler, "ڴʧܣĴ\n");
+        regs->intervals = NULL;
+        return 0;
+    }
+    for (i = 0; i < slot_count; i++) current[i] = -1;
+
+    /* Ծ䣺ʹӳǰֵ䣬ֵʼ䣻ϲʽеָ
+       ȡԴĽռλ */
+    calls_before[0] = 0;
+    for (i = 0; i < compiler->ir_count; i++) {
+        IRInstruction* ir = &compiler->ir_code[i];
+        IROperand sources[2];
+        int use_at = i;
+        int child = -1;
+        int slot;
+
+        if (compiler->tree_root != NULL) {
+            if (compiler->tree_root[i] >= 0) use_at = compiler->tree_root[i];
+            child = compiler->tree_child[i];
+        }
+        sources[0] = ir->src1;
+        sources[1] = ir->src2;
+        for (j = 0; j < 2; j++) {
+            regs->operand_interval[i * 3 + 1 + j] = -1;
+            slot = value_slot(compiler, sources[j]);
+            if (slot < 0) continue;
+            if (child >= 0 && sources[j] == compiler->ir_code[child].dest) continue;
+            if (current[slot] < 0) {
+                LiveInterval* fresh = &regs->intervals[regs->interval_count];
+                fresh->start = -1;
+                fresh->end = use_at;
+                fresh->slot = slot;
+                current[slot] = regs->interval_count++;
+            }
+            if (regs->intervals[current[slot]].end < use_at) regs->intervals[current[slot]].end = use_at;
+            regs->operand_interval[i * 3 + 1 + j] = current[slot];
+        }
+
+        regs->operand_interval[i * 3] = -1;
+        slot = value_slot(compiler, ir->dest);
+        if (slot >= 0 && use_at == i) {
+            LiveInterval* fresh = &regs->intervals[regs->interval_count];
+            fresh->start = i;
+            fresh->end = i;
+            fresh->slot = slot;
+            current[slot] = regs->interval_count;
+            regs->operand_interval[i * 3] = regs->interval_count++;
+        }
+
+        calls_before[i + 1] = calls_before[i] + (ir->type == IR_INPUT || ir->type == IR_OUTPUT);
+    }
+
+    /* ɨ */
+    for (i = 0; i < regs->interval_count; i++) {
+        LiveInterval* interval = &regs->intervals[i];
+        unsigned allowed;
+        int across_call;
+        int victim = -1;
+        int reg;
+
+        /* ûʹߣֻ벻ʹãֵռĴδֵʹõֵ
+           ջУջԭ */
+        interval->reg = -1;
+        if (interval->end == interval->start || interval->start < 0) continue;
+
+        /* ͷѾ */
+        for (j = 0; j < active_count; ) {
+            LiveInterval* old = &regs->intervals[active[j]];
+            if (old->end <= interval->start) {
+                free_mask |= 1u << old->reg;
+                active[j] = active[--active_count];
+            }
+            else {
+                j++;
+            }
+        }
+
+        /* ڲˣеʱֻñ߱Ĵ */
+        across_call = calls_before[interval->end] - calls_before[interval->start + 1] > 0;
+        allowed = across_call ? ((1u << REG_COUNT) - 1) & ~((1u << REG_CALLER_SAVED) - 1)
+            : (1u << REG_COUNT) - 1;
+
+        if (free_mask & allowed) {
+            for (reg = 0; !((free_mask & allowed) & (1u << reg)); reg++) {
+            }
+        }
+        else {
+            /* ûпмĴյԶ */
+            for (j = 0; j < active_count; j++) {
+                LiveInterval* old = &regs->intervals[active[j]];
+                if ((allowed & (1u << old->reg)) &&
+                    (victim < 0 || old->end > regs->intervals[active[victim]].end)) {
+                    victim = j;
                 }
-                else {
-                    src1_var = find_variable(compiler, ir->src1);
-                    if (src1_var != -1) {
-                        emit_code(compiler, "    movl    -%d(%%rbp), %%eax\n", compiler->vars[src1_var].offset);
-                    }
-                    else {
-                        /* ǳ */
-                        emit_code(compiler, "    movl    $%s, %%eax\n", ir->src1);
-                    }
+            }
+            if (victim < 0 || regs->intervals[active[victim]].end <= interval->end) {
+                regs->spilled++;
+                continue;
+            }
+            reg = regs->intervals[active[victim]].reg;
+            regs->intervals[active[victim]].reg = -1;
+            active[victim] = active[--active_count];
+            free_mask |= 1u << reg;
+            regs->spilled++;
+        }
+
+        interval->reg = reg;
+        free_mask &= ~(1u << reg);
+        regs->used_registers |= 1u << reg;
+        active[active_count++] = i;
+    }
+    return regs->spilled;
+}
+
+/* ջ۹ڼĴеĻԾ䰴˳ɨ裬յ㴦黹ջۣ
+   ʼȸѹ黹ջۣͬһָȶԴдĿ꣬
+   յͬԹãδֵʹõֵȷ䣬֤ջ
+   ֮ǰûбֵдعջ */
+int assign_stack_slots(Compiler* compiler)
+{
+    RegisterAllocation* regs = &compiler->regs;
+    int* release_head;
+    int* release_next;
+    int* free_slots;
+    int free_count = 0;
+    int next = 0;
+    int i;
+    int k;
+
+    regs->stack_slots = 0;
+    regs->scratch_slot = -1;
+    if (regs->intervals == NULL) return 0;
+
+    release_head = (int*)arena_alloc(&compiler->arena, ((size_t)compiler->ir_count + 1) * sizeof(int));
+    release_next = (int*)arena_alloc(&compiler->arena, ((size_t)regs->interval_count + 1) * sizeof(int));
+    free_slots = (int*)arena_alloc(&compiler->arena, ((size_t)regs->interval_count + 1) * sizeof(int));
+    if (release_head == NULL || release_next == NULL || free_slots == NULL) {
+        compile_error(compiler, "ڴʧܣջ۷\n");
+        return 0;
+    }
+    for (i = 0; i < compiler->ir_count; i++) release_head[i] = -1;
+
+    /* δֵʹõֵָ֮ǰ */
+    for (k = 0; k < regs->interval_count; k++) {
+        LiveInterval* interval = &regs->intervals[k];
+        interval->stack_slot = -1;
+        if (interval->start < 0) {
+            interval->stack_slot = next++;
+            release_next[k] = release_head[interval->end];
+            release_head[interval->end] = k;
+        }
+    }
+
+    k = 0;
+    for (i = 0; i < compiler->ir_count; i++) {
+        int released;
+
+        /* ȹ黹ڱָһʹõջ */
+        for (released = release_head[i]; released >= 0; released = release_next[released]) {
+            free_slots[free_count++] = regs->intervals[released].stack_slot;
+        }
+
+        for (; k < regs->interval_count && regs->intervals[k].start <= i; k++) {
+            LiveInterval* interval = &regs->intervals[k];
+            if (interval->start < i || interval->reg >= 0) continue;
+            interval->stack_slot = free_count > 0 ? free_slots[--free_count] : next++;
+            if (interval->end == i) {
+                /* ûʹߣֻڱָռ */
+                free_slots[free_count++] = interval->stack_slot;
+            }
+            else {
+                release_next[k] = release_head[interval->end];
+                release_head[interval->end] = k;
+            }
+        }
+
+        /* ֵڼĴе inputscanf Ҫһڴַ */
+        if (compiler->ir_code[i].type == IR_INPUT && regs->scratch_slot < 0) {
+            int dest = regs->operand_interval[i * 3];
+            if (dest >= 0 && regs->intervals[dest].reg >= 0) regs->scratch_slot = next++;
+        }
+    }
+
+    regs->stack_slots = next;
+    return next;
+}
+
+/* Ŀָ */
+
+static const char* const asm_reg32_name[16] = {
+    "%eax", "%ecx", "%edx", "%ebx", "%esp", "%ebp", "%esi", "%edi",
+    "%r8d", "%r9d", "%r10d", "%r11d", "%r12d", "%r13d", "%r14d", "%r15d"
+};
+static const char* const asm_reg64_name[16] = {
+    "%rax", "%rcx", "%rdx", "%rbx", "%rsp", "%rbp", "%rsi", "%rdi",
+    "%r8", "%r9", "%r10", "%r11", "%r12", "%r13", "%r14", "%r15"
+};
+static const char* const asm_symbol_name[] = { ".LC0", ".LC1", "scanf", "printf" };
+
+/* ǷȺ׺Ƿ l/q ׺ AsmOpcode  */
+static const char* const asm_opcode_name[] = {
+    "mov", "lea", "add", "sub", "imul", "imul", "idiv", "cltd",
+    "neg", "shl", "sar", "shr", "and", "xor", "push", "call",
+    "leave", "ret", "imul", "cmp", "je", "jne"
+};
+static const char asm_opcode_sized[] = {
+    1, 1, 1, 1, 1, 1, 1, 0,
+    1, 1, 1, 1, 1, 1, 1, 0,
+    0, 0, 1, 1, 0, 0
+};
+
+static AsmOperand asm_none(void)
+{
+    AsmOperand operand = { AO_NONE, -1, -1, 0, 0 };
+    return operand;
+}
+
+static AsmOperand asm_reg(int reg)
+{
+    AsmOperand operand = { AO_REG, (int8_t)reg, -1, 0, 0 };
+    return operand;
+}
+
+static AsmOperand asm_imm(int32_t value)
+{
+    AsmOperand operand = { AO_IMM, -1, -1, 0, value };
+    return operand;
+}
+
+static AsmOperand asm_mem(int base, int32_t offset)
+{
+    AsmOperand operand = { AO_MEM, (int8_t)base, -1, 0, offset };
+    return operand;
+}
+
+static AsmOperand asm_address(int base, int index, int scale, int32_t offset)
+{
+    AsmOperand operand = { AO_MEM, (int8_t)base, (int8_t)index, (uint8_t)scale, offset };
+    return operand;
+}
+
+static AsmOperand asm_rip(int symbol)
+{
+    AsmOperand operand = { AO_RIP, -1, -1, 0, symbol };
+    return operand;
+}
+
+static AsmOperand asm_symbol(int symbol)
+{
+    AsmOperand operand = { AO_SYMBOL, -1, -1, 0, symbol };
+    return operand;
+}
+
+static AsmOperand asm_label(int label)
+{
+    AsmOperand operand = { AO_LABEL, -1, -1, 0, label };
+    return operand;
+}
+
+/* Ƿʾͬһλãͬһ */
+static int asm_operand_equal(const AsmOperand* a, const AsmOperand* b)
+{
+    return a->kind == b->kind && a->base == b->base && a->index == b->index &&
+        a->scale == b->scale && a->value == b->value;
+}
+
+/* ׷һĿָĵַڴ治ʱ NULL */
+static AsmInstruction* asm_emit(Compiler* compiler, AsmOpcode op, int size, AsmOperand src, AsmOperand dst)
+{
+    AsmInstruction* insn;
+
+    if (compiler->asm_count >= compiler->asm_capacity) {
+        int capacity = compiler->asm_capacity ? compiler->asm_capacity * 2 : compiler->ir_count * 4 + 32;
+        AsmInstruction* code = (AsmInstruction*)realloc(compiler->asm_code, (size_t)capacity * sizeof(AsmInstruction));
+        if (code == NULL) {
+            compile_error(compiler, "ڴʧܣĿָ\n");
+            return NULL;
+        }
+        compiler->asm_code = code;
+        compiler->asm_capacity = capacity;
+    }
+    insn = &compiler->asm_code[compiler->asm_count++];
+    insn->op = (uint8_t)op;
+    insn->size = (uint8_t)size;
+    insn->src = src;
+    insn->dst = dst;
+    insn->immediate = 0;
+    insn->comment = NULL;
+    return insn;
+}
+
+/* ׷һעͣıڴر */
+static void asm_comment(Compiler* compiler, const char* format, ...)
+{
+    char buffer[96];
+    AsmInstruction* insn;
+    char* text;
+    va_list args;
+    int length;
+
+    va_start(args, format);
+    length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length < 0) return;
+    if (length >= (int)sizeof(buffer)) length = (int)sizeof(buffer) - 1;
+
+    text = (char*)arena_alloc(&compiler->arena, (size_t)length + 1);
+    insn = asm_emit(compiler, ASM_COMMENT, 0, asm_none(), asm_none());
+    if (text == NULL || insn == NULL) return;
+    memcpy(text, buffer, (size_t)length + 1);
+    insn->comment = text;
+}
+
+/*  index ָĲ0 Ŀꡢ1 Դ 12 Դ 2ջ %rbp ƫƣ
+   ջʱùջֵۣڼĴе input Ŀ scanf ʱջۣ
+   ˳ʱб֮ */
+static int operand_offset(Compiler* compiler, int index, int which)
+{
+    IRInstruction* ir = &compiler->ir_code[index];
+    IROperand operand = which == 0 ? ir->dest : which == 1 ? ir->src1 : ir->src2;
+    RegisterAllocation* regs = &compiler->regs;
+
+    if (regs->intervals != NULL) {
+        LiveInterval* interval = &regs->intervals[regs->operand_interval[index * 3 + which]];
+        return (interval->reg >= 0 ? regs->scratch_slot : interval->stack_slot) * 4 + 4;
+    }
+    if (operand_tag(operand) == OPERAND_VAR) {
+        return compiler->vars[operand_index(operand)].offset;
+    }
+    return (compiler->var_count + operand_index(operand) + 1) * 4;
+}
+
+/*  index ָĲ0 Ŀꡢ1 Դ 12 Դ 2λã
+   䵽ļĴջ -N(%rbp)  */
+static AsmOperand operand_location(Compiler* compiler, int index, int which)
+{
+    IRInstruction* ir = &compiler->ir_code[index];
+    IROperand operand = which == 0 ? ir->dest : which == 1 ? ir->src1 : ir->src2;
+    RegisterAllocation* regs = &compiler->regs;
+    int interval;
+
+    if (operand == OPERAND_NONE) {
+        return asm_none();
+    }
+    if (is_constant_operand(operand)) {
+        return asm_imm(operand_constant(compiler, operand));
+    }
+    if (regs->intervals != NULL) {
+        interval = regs->operand_interval[index * 3 + which];
+        if (interval >= 0 && regs->intervals[interval].reg >= 0) {
+            return asm_reg(allocatable_register[regs->intervals[interval].reg]);
+        }
+    }
+    return asm_mem(REG_RBP, -operand_offset(compiler, index, which));
+}
+
+/* ˷ķֽ⣺c ľֵֽΪֳ 2 ݣ lea
+   359 ĳ˻ 2^j1 λӼɣơȡ */
+typedef struct {
+    int zero;               /* c == 0 */
+    int lea_factors[2];
+    int lea_count;
+    int power_shift;        /* 2^j1 е j0 ʾ */
+    int power_subtract;     /* 1: 2^j - 10: 2^j + 1 */
+    int shift;
+    int negate;
+} MultiplyPlan;
+
+/* ֽⳣ˷ָװ뱻ֻ leaλʱ -1 */
+static int plan_multiply_constant(int32_t c, MultiplyPlan* plan)
+{
+    uint32_t magnitude = c < 0 ? 0u - (uint32_t)c : (uint32_t)c;
+    uint32_t odd = magnitude;
+    uint32_t rest;
+    int count;
+
+    memset(plan, 0, sizeof(*plan));
+    if (magnitude == 0) {
+        plan->zero = 1;
+        return 1;
+    }
+    while ((odd & 1) == 0) {
+        odd >>= 1;
+        plan->shift++;
+    }
+
+    rest = odd;
+    while (rest > 1 && plan->lea_count < 2) {
+        if (rest % 9 == 0) plan->lea_factors[plan->lea_count++] = 9, rest /= 9;
+        else if (rest % 5 == 0) plan->lea_factors[plan->lea_count++] = 5, rest /= 5;
+        else if (rest % 3 == 0) plan->lea_factors[plan->lea_count++] = 3, rest /= 3;
+        else break;
+    }
+
+    if (rest == 1) {
+        count = plan->lea_count;
+    }
+    else if ((odd & (odd + 1)) == 0 || ((odd - 1) & (odd - 2)) == 0) {
+        /* 2^j - 1  2^j + 1 */
+        uint32_t power = (odd & (odd + 1)) == 0 ? odd + 1 : odd - 1;
+        plan->lea_count = 0;
+        plan->power_subtract = power > odd;
+        for (plan->power_shift = 0; (1u << plan->power_shift) != power; plan->power_shift++) {
+        }
+        count = 3;
+    }
+    else {
+        return -1;
+    }
+
+    plan->negate = c < 0;
+    return count + (plan->shift > 0) + plan->negate;
+}
+
+/* ֽڼĴ reg гԳܸд %ecx */
+static void emit_multiply_constant(Compiler* compiler, const MultiplyPlan* plan, int reg)
+{
+    int j;
+
+    if (plan->zero) {
+        asm_emit(compiler, ASM_XOR, 4, asm_reg(reg), asm_reg(reg));
+        return;
+    }
+    for (j = 0; j < plan->lea_count; j++) {
+        asm_emit(compiler, ASM_LEA, 4, asm_address(reg, reg, plan->lea_factors[j] - 1, 0), asm_reg(reg));
+    }
+    if (plan->power_shift > 0) {
+        asm_emit(compiler, ASM_MOV, 4, asm_reg(reg), asm_reg(REG_RCX));
+        asm_emit(compiler, ASM_SHL, 4, asm_imm(plan->power_shift), asm_reg(reg));
+        asm_emit(compiler, plan->power_subtract ? ASM_SUB : ASM_ADD, 4, asm_reg(REG_RCX), asm_reg(reg));
+    }
+    if (plan->shift > 0) asm_emit(compiler, ASM_SHL, 4, asm_imm(plan->shift), asm_reg(reg));
+    if (plan->negate) asm_emit(compiler, ASM_NEG, 4, asm_none(), asm_reg(reg));
+}
+
+/* з 32 λԳ d|d| >= 2ħλ
+   q = ((x * multiplier) >> 32 [ x]) >> shiftټ q ķλHacker's Delight 10-1 */
+static void division_magic(int32_t d, int32_t* multiplier, int* shift)
+{
+    const uint32_t two31 = 0x80000000u;
+    uint32_t ad = d < 0 ? 0u - (uint32_t)d : (uint32_t)d;
+    uint32_t t = two31 + ((uint32_t)d >> 31);
+    uint32_t anc = t - 1 - t % ad;
+    uint32_t q1 = two31 / anc;
+    uint32_t r1 = two31 - q1 * anc;
+    uint32_t q2 = two31 / ad;
+    uint32_t r2 = two31 - q2 * ad;
+    uint32_t delta;
+    int p = 31;
+
+    do {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= ad) {
+            q2++;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    *multiplier = (int32_t)(q2 + 1);
+    if (d < 0) *multiplier = (int32_t)(0u - (uint32_t)*multiplier);
+    *shift = p - 32;
+}
+
+/* зųԡģ㳣 dضϳ C  /  % һ£ %eax У
+    %eaxд %ecx%edx2 üƫúƣħ˷
+   INT_MIN / -1  idivl ͬᴥ쳣ǻΪ INT_MIN */
+static void emit_divide_constant(Compiler* compiler, int32_t d, int modulo)
+{
+    uint32_t magnitude = d < 0 ? 0u - (uint32_t)d : (uint32_t)d;
+    int32_t multiplier;
+    int shift;
+
+    if (magnitude == 1) {
+        if (modulo) asm_emit(compiler, ASM_XOR, 4, asm_reg(REG_RAX), asm_reg(REG_RAX));
+        else if (d < 0) asm_emit(compiler, ASM_NEG, 4, asm_none(), asm_reg(REG_RAX));
+        return;
+    }
+
+    if (modulo) asm_emit(compiler, ASM_MOV, 4, asm_reg(REG_RAX), asm_reg(REG_RCX));
+
+    if ((magnitude & (magnitude - 1)) == 0) {
+        /* ȼ |d| - 1ʹض */
+        for (shift = 0; (1u << shift) != magnitude; shift++) {
+        }
+        asm_emit(compiler, ASM_MOV, 4, asm_reg(REG_RAX), asm_reg(REG_RDX));
+        if (shift > 1) asm_emit(compiler, ASM_SAR, 4, asm_imm(31), asm_reg(REG_RDX));
+        asm_emit(compiler, ASM_SHR, 4, asm_imm(32 - shift), asm_reg(REG_RDX));
+        asm_emit(compiler, ASM_ADD, 4, asm_reg(REG_RDX), asm_reg(REG_RAX));
+        if (modulo) {
+            /* x % d = x - (x + ƫ) & -|d| */
+            asm_emit(compiler, ASM_AND, 4, asm_imm((int32_t)(0u - magnitude)), asm_reg(REG_RAX));
+            asm_emit(compiler, ASM_SUB, 4, asm_reg(REG_RAX), asm_reg(REG_RCX));
+            asm_emit(compiler, ASM_MOV, 4, asm_reg(REG_RCX), asm_reg(REG_RAX));
+            return;
+        }
+        asm_emit(compiler, ASM_SAR, 4, asm_imm(shift), asm_reg(REG_RAX));
+        if (d < 0) asm_emit(compiler, ASM_NEG, 4, asm_none(), asm_reg(REG_RAX));
+        return;
+    }
+
+    division_magic(d, &multiplier, &shift);
+    if (!modulo) asm_emit(compiler, ASM_MOV, 4, asm_reg(REG_RAX), asm_reg(REG_RCX));
+    asm_emit(compiler, ASM_MOV, 4, asm_imm(multiplier), asm_reg(REG_RAX));
+    asm_emit(compiler, ASM_IMUL1, 4, asm_none(), asm_reg(REG_RCX));
+    if (d > 0 && multiplier < 0) asm_emit(compiler, ASM_ADD, 4, asm_reg(REG_RCX), asm_reg(REG_RDX));
+    if (d < 0 && multiplier > 0) asm_emit(compiler, ASM_SUB, 4, asm_reg(REG_RCX), asm_reg(REG_RDX));
+    if (shift > 0) asm_emit(compiler, ASM_SAR, 4, asm_imm(shift), asm_reg(REG_RDX));
+    asm_emit(compiler, ASM_MOV, 4, asm_reg(REG_RDX), asm_reg(REG_RAX));
+    asm_emit(compiler, ASM_SHR, 4, asm_imm(31), asm_reg(REG_RAX));
+    asm_emit(compiler, ASM_ADD, 4, asm_reg(REG_RDX), asm_reg(REG_RAX));
+    if (modulo) {
+        /* x % d = x - q * d */
+        asm_emit(compiler, ASM_IMUL, 4, asm_imm(d), asm_reg(REG_RAX));
+        asm_emit(compiler, ASM_SUB, 4, asm_reg(REG_RAX), asm_reg(REG_RCX));
+        asm_emit(compiler, ASM_MOV, 4, asm_reg(REG_RCX), asm_reg(REG_RAX));
+    }
+}
+
+/* idivl ֮ǰ 0INT_MIN / -1 ʱڣ0 űţ idivl Ӳ쳣
+    %eax  */
+static void emit_divide_check(Compiler* compiler, AsmOperand divisor)
+{
+    int next = ++compiler->label_count;
+
+    asm_emit(compiler, ASM_CMP, 4, asm_imm(0), divisor);
+    asm_emit(compiler, ASM_JE, 8, asm_none(), asm_label(0));
+    asm_emit(compiler, ASM_CMP, 4, asm_imm(-1), divisor);
+    asm_emit(compiler, ASM_JNE, 8, asm_none(), asm_label(next));
+    asm_emit(compiler, ASM_CMP, 4, asm_imm(INT32_MIN), asm_reg(REG_RAX));
+    asm_emit(compiler, ASM_JE, 8, asm_none(), asm_label(0));
+    asm_emit(compiler, ASM_LABEL, 8, asm_none(), asm_label(next));
+}
+
+/*  scanf/printf%rdi Ϊʽַ%eax ΪĴ 0 */
+static void emit_call(Compiler* compiler, int format, int function)
+{
+    asm_emit(compiler, ASM_LEA, 8, asm_rip(format), asm_reg(REG_RDI));
+    asm_emit(compiler, ASM_MOV, 4, asm_imm(0), asm_reg(REG_RAX));
+    asm_emit(compiler, ASM_CALL, 8, asm_none(), asm_symbol(function));
+}
+
+/* ĴۣԼΪִ x86-64 ϵӳ lea һڣ
+   ħаؼ·ƣidivl ӳټ */
+static const int tile_cost[TILE_COUNT] = { 1, 1, 2, 1, 3, 3, 1, 6, 26 };
+static const char* const tile_name[TILE_COUNT] = {
+    "mov", "lea", "lea3", "add/sub", "imul", "imul-imm", "shift-add", "div-const", "idiv"
+};
+#define TILE_INFINITE 0x3fffffff
+
+/* ַʽһ at * scalecomputed Ϊ 1 ʱ at һڵ㵽Ĵֵ */
+typedef struct {
+    AsmOperand at;
+    uint8_t scale;
+    uint8_t computed;
+} AddressTerm;
+
+/* ʽһڵıţBURS Ķ̬滮״̬
+   REG Ϊֵ㵽Ĵ W СۣADDR Ϊֵʾ disp(base,index,scale) С */
+typedef struct {
+    int node;               /* м± */
+    int has_child;          /* еһڵ */
+    AsmOperand left;        /* Ҷӣhas_child ʱã */
+    AsmOperand right;       /* Ҷ */
+    int reg_cost;
+    uint8_t reg_rule;       /* Tile */
+    int addr_cost;          /* TILE_INFINITE ʾܱʾɵַ */
+    uint8_t addr_from;      /* 0 ֻҶӣ1 չӽڵĵַʽ2 ӽڵֵ W  */
+    uint8_t term_count;
+    AddressTerm terms[2];
+    int32_t disp;
+    uint8_t emit;           /* ҪɵĽڵ */
+} TreeLabel;
+
+/* ҶΪַʽĴջΪһջҪװʱĴΪƫ */
+static int address_of_leaf(const AsmOperand* leaf, AddressTerm* terms, int* term_count, int32_t* disp)
+{
+    if (leaf->kind == AO_IMM) {
+        *term_count = 0;
+        *disp = leaf->value;
+        return 0;
+    }
+    terms[0].at = *leaf;
+    terms[0].scale = 1;
+    terms[0].computed = 0;
+    *term_count = 1;
+    *disp = 0;
+    return leaf->kind == AO_MEM ? tile_cost[TILE_MOVE] : 0;
+}
+
+/* ַʽܷһ lea ʾԼǷΪַַƫеʽ */
+static int address_shape(const TreeLabel* label, int* complex)
+{
+    int terms = label->term_count;
+    int scaled = 0;
+    int i;
+
+    if (terms == 0) return 0;
+    for (i = 0; i < terms; i++) {
+        if (label->terms[i].scale != 1) scaled++;
+    }
+    if (scaled > 1) return 0;
+    /* һ 2 д (x,x)Ҳռַͱַ */
+    *complex = label->disp != 0 && (terms == 2 || label->terms[0].scale == 2);
+    return 1;
+}
+
+/* Ͻڵ p  ADDR ţleft_terms Ϊĵַʽ */
+static void label_address(TreeLabel* label, const AddressTerm* left_terms, int left_count, int32_t left_disp,
+    int left_cost, int op, int w)
+{
+    AddressTerm right_terms[2];
+    int right_count;
+    int32_t right_disp;
+    int right_cost;
+    int has_computed = 0;
+    int i;
+
+    label->term_count = 0;
+    if (left_cost >= TILE_INFINITE) return;
+
+    if (op == IR_ADD) {
+        AddressTerm merged[3];
+        int merged_count = left_count;
+
+        right_cost = address_of_leaf(&label->right, right_terms, &right_count, &right_disp);
+        for (i = 0; i < left_count; i++) merged[i] = left_terms[i];
+        if (right_count == 1) {
+            /* ͬһλõϲx + x Ϊ x * 2 */
+            for (i = 0; i < left_count; i++) {
+                int scale = merged[i].scale + right_terms[0].scale;
+                if (merged[i].computed == right_terms[0].computed &&
+                    asm_operand_equal(&merged[i].at, &right_terms[0].at) && (scale == 2 || scale == 4 || scale == 8)) {
+                    merged[i].scale = (uint8_t)scale;
+                    right_cost = 0;
+                    break;
                 }
+            }
+            if (i == left_count) merged[merged_count++] = right_terms[0];
+        }
+        if (merged_count > 2) return;
+        for (i = 0; i < merged_count; i++) label->terms[i] = merged[i];
+        label->term_count = (uint8_t)merged_count;
+        label->disp = (int32_t)((uint32_t)left_disp + (uint32_t)right_disp);
+        left_cost += right_cost;
+    }
+    else if (op == IR_SUB && label->right.kind == AO_IMM) {
+        for (i = 0; i < left_count; i++) label->terms[i] = left_terms[i];
+        label->term_count = (uint8_t)left_count;
+        label->disp = (int32_t)((uint32_t)left_disp - (uint32_t)label->right.value);
+    }
+    else if (op == IR_MUL && label->right.kind == AO_IMM && left_count == 1) {
+        int32_t c = label->right.value;
+        int64_t scaled = (int64_t)left_terms[0].scale * c;  /* 64 λˣc ܴʱ */
+
+        if (scaled == 1 || scaled == 2 || scaled == 4 || scaled == 8) {
+            label->terms[0] = left_terms[0];
+            label->terms[0].scale = (uint8_t)scaled;
+            label->term_count = 1;
+            label->disp = (int32_t)((uint32_t)left_disp * (uint32_t)c);
+        }
+        else if (left_terms[0].scale == 1 && left_disp == 0 && (c == 3 || c == 5 || c == 9)) {
+            label->terms[0] = left_terms[0];
+            label->terms[1] = left_terms[0];
+            label->terms[1].scale = (uint8_t)(c - 1);
+            label->term_count = 2;
+            label->disp = 0;
+        }
+        else {
+            return;
+        }
+    }
+    else {
+        return;
+    }
+
+    /* ӽڵֵд W ֮ lea Ŷǲ W  */
+    for (i = 0; i < label->term_count; i++) {
+        if (label->terms[i].computed) has_computed = 1;
+    }
+    for (i = 0; has_computed && i < label->term_count; i++) {
+        if (!label->terms[i].computed && label->terms[i].at.kind == AO_REG && label->terms[i].at.base == w) {
+            label->term_count = 0;
+            return;
+        }
+    }
+    if (label->addr_cost > left_cost) {
+        label->addr_cost = left_cost;
+    }
+}
+
+/* ԵΪʽڵСĴΪ w */
+static void label_chain(Compiler* compiler, TreeLabel* labels, int count, int w)
+{
+    int p;
+
+    for (p = count - 1; p >= 0; p--) {
+        TreeLabel* label = &labels[p];
+        TreeLabel* child = label->has_child ? &labels[p + 1] : NULL;
+        IRInstruction* ir = &compiler->ir_code[label->node];
+        int op = (int)ir->type;
+        int left_in_w = !label->has_child && label->left.kind == AO_REG && label->left.base == w;
+        int left_cost = child != NULL ? child->reg_cost : left_in_w ? 0 : tile_cost[TILE_MOVE];
+        /* Ҷ֮ǰ W ѱдҶӾͲ W  */
+        int right_clobbered = !left_in_w && label->right.kind == AO_REG && label->right.base == w;
+        int best = TILE_INFINITE;
+        int rule = TILE_MOVE;
+        int complex = 0;
+        int cost;
+
+        /* ADDRҶӡӽڵĵַʽ W еӽڵֵչȡС */
+        label->addr_cost = TILE_INFINITE;
+        label->term_count = 0;
+        if (op == IR_ADD || op == IR_SUB || op == IR_MUL) {
+            AddressTerm left_terms[2];
+            int left_count;
+            int32_t left_disp;
+            TreeLabel extended;
+            TreeLabel computed;
+
+            if (child == NULL) {
+                cost = address_of_leaf(&label->left, left_terms, &left_count, &left_disp);
+                label_address(label, left_terms, left_count, left_disp, cost, op, w);
+                label->addr_from = 0;
+            }
+            else {
+                extended = *label;
+                computed = *label;
+                if (child->addr_cost < TILE_INFINITE) {
+                    label_address(&extended, child->terms, child->term_count, child->disp, child->addr_cost, op, w);
+                }
+                left_terms[0].at = asm_reg(w);
+                left_terms[0].scale = 1;
+                left_terms[0].computed = 1;
+                label_address(&computed, left_terms, 1, 0, child->reg_cost, op, w);
+                if (extended.addr_cost <= computed.addr_cost && extended.addr_cost < TILE_INFINITE) {
+                    *label = extended;
+                    label->addr_from = 1;
+                }
+                else if (computed.addr_cost < TILE_INFINITE) {
+                    *label = computed;
+                    label->addr_from = 2;
+                }
+            }
+            if (label->addr_cost < TILE_INFINITE && !address_shape(label, &complex)) {
+                label->addr_cost = TILE_INFINITE;
+            }
+        }
+
+        /* REGȡСۣͬʱȡг */
+        switch (op) {
+        case IR_ADD:
+        case IR_SUB:
+            if (!right_clobbered) {
+                best = left_cost + tile_cost[TILE_ADD];
+                rule = TILE_ADD;
+            }
+            break;
+        case IR_MUL:
+            if (label->right.kind == AO_IMM) {
+                MultiplyPlan plan;
+                int length = plan_multiply_constant(label->right.value, &plan);
+                if (length >= 0 && left_cost + length * tile_cost[TILE_SHIFT_ADD] < best) {
+                    best = left_cost + length * tile_cost[TILE_SHIFT_ADD];
+                    rule = TILE_SHIFT_ADD;
+                }
+                /* ʽ˳-O0ʱװ */
+                cost = (child != NULL ? child->reg_cost : label->left.kind == AO_IMM ? tile_cost[TILE_MOVE] : 0) +
+                    tile_cost[TILE_IMUL_IMM];
+                if (cost < best) {
+                    best = cost;
+                    rule = TILE_IMUL_IMM;
+                }
+            }
+            else if (!right_clobbered) {
+                best = left_cost + tile_cost[TILE_IMUL];
+                rule = TILE_IMUL;
+            }
+            break;
+        case IR_DIV:
+        case IR_MOD:
+            /* ֻ %eax н */
+            if (w != REG_RAX) break;
+            if (label->right.kind == AO_IMM && label->right.value != 0) {
+                best = left_cost + tile_cost[TILE_DIV_CONST];
+                rule = TILE_DIV_CONST;
+            }
+            else {
+                best = left_cost + tile_cost[TILE_IDIV] + (label->right.kind == AO_IMM ? tile_cost[TILE_MOVE] : 0) +
+                    (op == IR_MOD ? tile_cost[TILE_MOVE] : 0);
+                rule = TILE_IDIV;
+            }
+            break;
+        default:
+            break;
+        }
+        if (label->addr_cost < TILE_INFINITE) {
+            cost = label->addr_cost + tile_cost[complex ? TILE_LEA_COMPLEX : TILE_LEA];
+            if (cost < best) {
+                best = cost;
+                rule = complex ? TILE_LEA_COMPLEX : TILE_LEA;
+            }
+        }
+        label->reg_cost = best;
+        label->reg_rule = (uint8_t)rule;
+    }
+}
+
+/* Ҷװ빤Ĵʱָ */
+static void emit_load_leaf(Compiler* compiler, const AsmOperand* leaf, int w)
+{
+    if (leaf->kind == AO_REG && leaf->base == w) return;
+    asm_emit(compiler, ASM_MOV, 4, *leaf, asm_reg(w));
+}
+
+/* Ͻڵ p  REG Ӧָӽڵ㣨Ҫ㵽 W  */
+static void emit_tile(Compiler* compiler, const TreeLabel* label, int w)
+{
+    IRInstruction* ir = &compiler->ir_code[label->node];
+    AsmOperand base = asm_none();
+    AsmOperand index = asm_none();
+    AsmOperand loaded[2];
+    int loaded_scratch[2];
+    int loaded_count = 0;
+    int scratch = REG_RAX;
+    int scale = 1;
+    int i;
+    int k;
+
+    switch (label->reg_rule) {
+    case TILE_LEA:
+    case TILE_LEA_COMPLEX:
+        /* ջеװ W ʱĴͬջֻװһΣ */
+        for (i = 0; i < label->term_count; i++) {
+            AsmOperand at = label->terms[i].at;
+            if (at.kind == AO_MEM) {
+                for (k = 0; k < loaded_count && !asm_operand_equal(&loaded[k], &at); k++) {
+                }
+                if (k == loaded_count) {
+                    if (scratch == w) scratch++;
+                    loaded[loaded_count] = at;
+                    loaded_scratch[loaded_count++] = scratch;
+                    asm_emit(compiler, ASM_MOV, 4, at, asm_reg(scratch));
+                    scratch++;
+                }
+                at = asm_reg(loaded_scratch[k]);
+            }
+            if (label->term_count == 1) {
+                if (label->terms[i].scale == 2) {
+                    base = at;
+                    index = at;
+                }
+                else if (label->terms[i].scale == 1) {
+                    base = at;
+                }
+                else {
+                    index = at;
+                    scale = label->terms[i].scale;
+                }
+            }
+            else if (label->terms[i].scale != 1 || base.kind != AO_NONE) {
+                index = at;
+                scale = label->terms[i].scale;
+            }
+            else {
+                base = at;
+            }
+        }
+        if (base.kind == AO_NONE) {
+            asm_emit(compiler, ASM_LEA, 4, asm_address(-1, index.base, scale, label->disp), asm_reg(w));
+        }
+        else if (index.kind == AO_NONE) {
+            asm_emit(compiler, ASM_LEA, 4, asm_mem(base.base, label->disp), asm_reg(w));
+        }
+        else {
+            asm_emit(compiler, ASM_LEA, 4, asm_address(base.base, index.base, scale, label->disp), asm_reg(w));
+        }
+        break;
+
+    case TILE_ADD:
+    case TILE_IMUL:
+        if (!label->has_child) emit_load_leaf(compiler, &label->left, w);
+        asm_emit(compiler, label->reg_rule == TILE_IMUL ? ASM_IMUL : ir->type == IR_SUB ? ASM_SUB : ASM_ADD, 4,
+            label->right, asm_reg(w));
+        break;
+
+    case TILE_IMUL_IMM:
+        if (!label->has_child && label->left.kind == AO_IMM) emit_load_leaf(compiler, &label->left, w);
+        if (label->has_child || label->left.kind == AO_IMM) {
+            asm_emit(compiler, ASM_IMUL, 4, label->right, asm_reg(w));
+        }
+        else {
+            AsmInstruction* insn = asm_emit(compiler, ASM_IMUL3, 4, label->left, asm_reg(w));
+            if (insn != NULL) insn->immediate = label->right.value;
+        }
+        break;
+
+    case TILE_SHIFT_ADD:
+        {
+            MultiplyPlan plan;
+            plan_multiply_constant(label->right.value, &plan);
+            if (!label->has_child) emit_load_leaf(compiler, &label->left, w);
+            emit_multiply_constant(compiler, &plan, w);
+        }
+        break;
+
+    case TILE_DIV_CONST:
+        if (!label->has_child) emit_load_leaf(compiler, &label->left, w);
+        emit_divide_constant(compiler, label->right.value, ir->type == IR_MOD);
+        break;
+
+    case TILE_IDIV:
+        /* չ edx:eax  idivl eax edx */
+        {
+            AsmOperand divisor = label->right;
+            if (!label->has_child) emit_load_leaf(compiler, &label->left, w);
+            if (divisor.kind == AO_IMM) {
+                asm_emit(compiler, ASM_MOV, 4, divisor, asm_reg(REG_RCX));
+                divisor = asm_reg(REG_RCX);
+            }
+            if (compiler->check_division) emit_divide_check(compiler, divisor);
+            asm_emit(compiler, ASM_CLTD, 4, asm_none(), asm_none());
+            asm_emit(compiler, ASM_IDIV, 4, asm_none(), divisor);
+            if (ir->type == IR_MOD) asm_emit(compiler, ASM_MOV, 4, asm_reg(REG_RDX), asm_reg(REG_RAX));
+        }
+        break;
+
+    default:
+        break;
+    }
+    compiler->tile_counts[label->reg_rule]++;
+}
+
+/* Ϊ index ָעдм */
+static void comment_instruction(Compiler* compiler, int index)
+{
+    IRInstruction* ir = &compiler->ir_code[index];
+    char dest_buffer[16];
+    char src1_buffer[16];
+    char src2_buffer[16];
+    const char* dest = operand_text(compiler, ir->dest, dest_buffer);
+    const char* src1 = operand_text(compiler, ir->src1, src1_buffer);
+    const char* src2 = operand_text(compiler, ir->src2, src2_buffer);
+
+    switch (ir->type) {
+    case IR_INPUT:
+        asm_comment(compiler, "input(%s)", dest);
+        break;
+    case IR_OUTPUT:
+        asm_comment(compiler, "output(%s)", src1);
+        break;
+    case IR_ASSIGN:
+        asm_comment(compiler, "%s = %s", dest, src1);
+        break;
+    default:
+        asm_comment(compiler, "%s = %s %s %s", dest, src1, ir_type_name[ir->type], src2);
+        break;
+    }
+}
+
+/* Ե root ָΪıʽѡָд target
+   һԹĴ W ѡtarget  %eaxֱ BURS ţ
+   ȡܴСһԶҳõӽڵ㣬Եɡ */
+static void select_expression(Compiler* compiler, int root, AsmOperand target, TreeLabel** buffer, int* capacity)
+{
+    TreeLabel* labels;
+    IRInstruction* ir = &compiler->ir_code[root];
+    int candidates[2];
+    int candidate_count = 0;
+    int best_cost = TILE_INFINITE;
+    int w = REG_RAX;
+    int count = 0;
+    int node = root;
+    int in_register;
+    int p;
+    int k;
+
+    /* ֵĲʱֻһδͣڴ浽ڴ澭 %eax */
+    if (ir->type == IR_ASSIGN || ir->type == IR_OUTPUT) {
+        node = compiler->tree_child != NULL ? compiler->tree_child[root] : -1;
+        if (node < 0) {
+            AsmOperand source = operand_location(compiler, root, 1);
+            comment_instruction(compiler, root);
+            if (asm_operand_equal(&source, &target)) return;
+            if (target.kind == AO_MEM && source.kind == AO_MEM) {
+                asm_emit(compiler, ASM_MOV, 4, source, asm_reg(REG_RAX));
+                source = asm_reg(REG_RAX);
+            }
+            asm_emit(compiler, ASM_MOV, 4, source, target);
+            return;
+        }
+    }
+
+    /* ռlabels[0] Ϊ㣬labels[p + 1] Ϊ labels[p] ӽڵ */
+    for (p = node; p >= 0; p = compiler->tree_child != NULL ? compiler->tree_child[p] : -1) {
+        count++;
+    }
+    if (count > *capacity) {
+        int grown = *capacity ? *capacity : 16;
+        while (grown < count) grown *= 2;
+        labels = (TreeLabel*)realloc(*buffer, (size_t)grown * sizeof(TreeLabel));
+        if (labels == NULL) {
+            compile_error(compiler, "ڴʧܣָѡ\n");
+            return;
+        }
+        *buffer = labels;
+        *capacity = grown;
+    }
+    labels = *buffer;
+    count = 0;
+    for (; node >= 0; node = compiler->tree_child != NULL ? compiler->tree_child[node] : -1) {
+        IRInstruction* current = &compiler->ir_code[node];
+        TreeLabel* label = &labels[count++];
+        int child = compiler->tree_child != NULL ? compiler->tree_child[node] : -1;
+
+        label->node = node;
+        label->has_child = child >= 0;
+        label->emit = 0;
+        if (child >= 0 && current->src2 == compiler->ir_code[child].dest) {
+            label->right = operand_location(compiler, node, 1);
+        }
+        else {
+            /* ӽڵֵûջۡĴֻȡһ */
+            label->left = child >= 0 ? asm_none() : operand_location(compiler, node, 1);
+            label->right = operand_location(compiler, node, 2);
+            if (child < 0 && (current->type == IR_ADD || current->type == IR_MUL) &&
+                label->right.kind != AO_IMM && (label->left.kind == AO_IMM ||
+                (target.kind == AO_REG && label->right.kind == AO_REG && label->right.base == target.base))) {
+                /* ɽұߣҲĿĴʱȱ */
+                AsmOperand swap = label->left;
+                label->left = label->right;
+                label->right = swap;
+            }
+        }
+    }
+
+    /* עͣгкϲָ */
+    for (p = count - 1; p >= 0; p--) {
+        if (labels[p].node != root) comment_instruction(compiler, labels[p].node);
+    }
+    comment_instruction(compiler, root);
+
+    /* ѡĴ */
+    if (target.kind == AO_REG) candidates[candidate_count++] = target.base;
+    candidates[candidate_count++] = REG_RAX;
+    for (k = 0; k < candidate_count; k++) {
+        int cost;
+        label_chain(compiler, labels, count, candidates[k]);
+        cost = labels[0].reg_cost + (target.kind == AO_REG && target.base == candidates[k] ? 0 : tile_cost[TILE_MOVE]);
+        if (cost < best_cost) {
+            best_cost = cost;
+            w = candidates[k];
+        }
+    }
+    if (w != candidates[candidate_count - 1]) label_chain(compiler, labels, count, w);
+
+    /* Զ±ҪɵĽڵ㣺REG õӽڵֵʱӽڵɣ
+       lea صַʽ£ֵ W еӽڵʱͬ */
+    p = 0;
+    in_register = 1;
+    while (p < count) {
+        if (in_register) {
+            labels[p].emit = 1;
+            if (labels[p].reg_rule == TILE_LEA || labels[p].reg_rule == TILE_LEA_COMPLEX) {
+                in_register = 0;
+                continue;
+            }
+            if (!labels[p].has_child) break;
+        }
+        else {
+            if (labels[p].addr_from == 0) break;
+            in_register = labels[p].addr_from == 2;
+        }
+        p++;
+    }
+    for (p = count - 1; p >= 0; p--) {
+        if (labels[p].emit) emit_tile(compiler, &labels[p], w);
+    }
+    if (target.kind != AO_REG || target.base != w) {
+        asm_emit(compiler, ASM_MOV, 4, asm_reg(w), target);
+        compiler->tile_counts[TILE_MOVE]++;
+    }
+}
+
+/* ĿָУֱչָʽָѡ
+   䵽ĴֱֵڼĴ㣬ֵջ */
+void generate_assembly(Compiler* compiler)
+{
+    TreeLabel* labels = NULL;
+    int label_capacity = 0;
+    int saved[REG_COUNT];
+    int saved_count = 0;
+    int slot_count;
+    int save_base;
+    int i;
+    int stack_size;
+    IRInstruction* ir;
+    AsmOperand dest_at;
+    AsmInstruction* emitted;
+
+    compiler->asm_count = 0;
+    compiler->label_count = 0;
+    memset(compiler->tile_counts, 0, sizeof(compiler->tile_counts));
+    asm_emit(compiler, ASM_PUSH, 8, asm_none(), asm_reg(REG_RBP));
+    asm_emit(compiler, ASM_MOV, 8, asm_reg(REG_RSP), asm_reg(REG_RBP));
+
+    /* ջռ - ģջۣԼõı߱Ĵı
+       pushq %rbp ֮ %rsp Ѱ 16 ֽڶ룬֡Сȡ 16 ıʱȻ */
+    for (i = REG_CALLER_SAVED; i < REG_COUNT; i++) {
+        if (compiler->regs.used_registers & (1u << i)) saved[saved_count++] = allocatable_register[i];
+    }
+    slot_count = compiler->regs.intervals != NULL ? compiler->regs.stack_slots
+        : compiler->var_count + compiler->temp_var_counter;
+    save_base = (slot_count * 4 + 7) & ~7;
+    stack_size = (save_base + saved_count * 8 + 15) & ~15;
+    compiler->frame_size = stack_size;
+    compiler->frame_size_unshared =
+        ((((compiler->var_count + compiler->temp_var_counter) * 4 + 7) & ~7) + saved_count * 8 + 15) & ~15;
+    if (stack_size > 0) {
+        emitted = asm_emit(compiler, ASM_SUB, 8, asm_imm(stack_size), asm_reg(REG_RSP));
+        if (emitted != NULL) emitted->comment = "Ϊֲռ";
+    }
+    for (i = 0; i < saved_count; i++) {
+        asm_emit(compiler, ASM_MOV, 8, asm_reg(saved[i]), asm_mem(REG_RBP, -(save_base + (i + 1) * 8)));
+    }
+    asm_emit(compiler, ASM_BLANK, 0, asm_none(), asm_none());
+
+    /* мָϲʽеָһ */
+    for (i = 0; i < compiler->ir_count; i++) {
+        ir = &compiler->ir_code[i];
+        if (compiler->tree_root != NULL && compiler->tree_root[i] >= 0) continue;
+
+        switch (ir->type) {
+        case IR_INPUT:
+            /* scanf дջֵۣڼĴʱװ */
+            comment_instruction(compiler, i);
+            dest_at = operand_location(compiler, i, 0);
+            asm_emit(compiler, ASM_LEA, 8, asm_mem(REG_RBP, -operand_offset(compiler, i, 0)), asm_reg(REG_RSI));
+            emit_call(compiler, SYMBOL_SCAN_FORMAT, SYMBOL_SCANF);
+            if (dest_at.kind == AO_REG) {
+                asm_emit(compiler, ASM_MOV, 4, asm_mem(REG_RBP, -operand_offset(compiler, i, 0)), dest_at);
+            }
+            break;
+
+        case IR_OUTPUT:
+            select_expression(compiler, i, asm_reg(REG_RSI), &labels, &label_capacity);
+            emit_call(compiler, SYMBOL_PRINT_FORMAT, SYMBOL_PRINTF);
+            break;
+
+        default:
+            select_expression(compiler, i, operand_location(compiler, i, 0), &labels, &label_capacity);
+            break;
+        }
+        asm_emit(compiler, ASM_BLANK, 0, asm_none(), asm_none());
+    }
+    free(labels);
+
+    /* ӳ */
+    asm_comment(compiler, "return 0");
+    for (i = 0; i < saved_count; i++) {
+        asm_emit(compiler, ASM_MOV, 8, asm_mem(REG_RBP, -(save_base + (i + 1) * 8)), asm_reg(saved[i]));
+    }
+    asm_emit(compiler, ASM_MOV, 4, asm_imm(0), asm_reg(REG_RAX));
+    asm_emit(compiler, ASM_LEAVE, 8, asm_none(), asm_none());
+    asm_emit(compiler, ASM_RET, 8, asm_none(), asm_none());
+
+    /* ĳڣָͬĴ󷵻 -1 */
+    if (compiler->label_count > 0) {
+        asm_emit(compiler, ASM_BLANK, 0, asm_none(), asm_none());
+        emitted = asm_emit(compiler, ASM_LABEL, 8, asm_none(), asm_label(0));
+        if (emitted != NULL) emitted->comment = " 0 ";
+        for (i = 0; i < saved_count; i++) {
+            asm_emit(compiler, ASM_MOV, 8, asm_mem(REG_RBP, -(save_base + (i + 1) * 8)), asm_reg(saved[i]));
+        }
+        asm_emit(compiler, ASM_MOV, 4, asm_imm(-1), asm_reg(REG_RAX));
+        asm_emit(compiler, ASM_LEAVE, 8, asm_none(), asm_none());
+        asm_emit(compiler, ASM_RET, 8, asm_none(), asm_none());
+    }
+}
+
+/* Ż */
+
+/* ָֻ֮עͺͿʱ index ֮һʵָ±꣬ûз -1 */
+static int asm_next_real(Compiler* compiler, int index)
+{
+    int i;
+    for (i = index + 1; i < compiler->asm_count; i++) {
+        int op = compiler->asm_code[i].op;
+        if (op != ASM_COMMENT && op != ASM_BLANK) return i;
+    }
+    return -1;
+}
+
+/* Ż֣ PeepholeRule  */
+const char* peephole_rule_name(int rule)
+{
+    static const char* const names[PEEPHOLE_RULE_COUNT] = {
+        "store-load", "self-move", "zero", "add-zero", "mul-one"
+    };
+    return rule >= 0 && rule < PEEPHOLE_RULE_COUNT ? names[rule] : "?";
+}
+
+/* Żڽṹָϰдÿ򵥶
+   disabled λرչ1u << PEEPHOLE_...дԽúͱţ
+   Ҳ־λֻг cmpl ת֮־λظд */
+int peephole_optimize(Compiler* compiler, unsigned disabled)
+{
+    int* hits = compiler->peephole_hits;
+    int total = 0;
+    int changed = 1;
+    int kept;
+    int i;
+
+    memset(compiler->peephole_hits, 0, sizeof(compiler->peephole_hits));
+    while (changed) {
+        changed = 0;
+        for (i = 0; i < compiler->asm_count; i++) {
+            AsmInstruction* insn = &compiler->asm_code[i];
+            AsmInstruction* next;
+            int j;
+
+            if (insn->op == ASM_DELETED || insn->op == ASM_COMMENT || insn->op == ASM_BLANK) continue;
+
+            /* movl %r, %r */
+            if (!(disabled & (1u << PEEPHOLE_SELF_MOVE)) && insn->op == ASM_MOV && insn->size == 4 &&
+                insn->src.kind == AO_REG && asm_operand_equal(&insn->src, &insn->dst)) {
+                insn->op = ASM_DELETED;
+                hits[PEEPHOLE_SELF_MOVE]++;
+                changed = 1;
+                continue;
+            }
+
+            /* addl/subl $0 */
+            if (!(disabled & (1u << PEEPHOLE_ADD_ZERO)) && (insn->op == ASM_ADD || insn->op == ASM_SUB) &&
+                insn->src.kind == AO_IMM && insn->src.value == 0) {
+                insn->op = ASM_DELETED;
+                hits[PEEPHOLE_ADD_ZERO]++;
+                changed = 1;
+                continue;
+            }
+
+            /* imull $1ʽΪ */
+            if (!(disabled & (1u << PEEPHOLE_MUL_ONE)) && insn->op == ASM_IMUL &&
+                insn->src.kind == AO_IMM && insn->src.value == 1) {
+                insn->op = ASM_DELETED;
+                hits[PEEPHOLE_MUL_ONE]++;
+                changed = 1;
+                continue;
+            }
+            if (!(disabled & (1u << PEEPHOLE_MUL_ONE)) && insn->op == ASM_IMUL3 && insn->immediate == 1) {
+                insn->op = ASM_MOV;
+                hits[PEEPHOLE_MUL_ONE]++;
+                changed = 1;
+                continue;
+            }
+
+            /* movl $0, %r Ϊ xorl %r, %r */
+            if (!(disabled & (1u << PEEPHOLE_ZERO)) && insn->op == ASM_MOV && insn->size == 4 &&
+                insn->src.kind == AO_IMM && insn->src.value == 0 && insn->dst.kind == AO_REG) {
+                insn->op = ASM_XOR;
+                insn->src = insn->dst;
+                hits[PEEPHOLE_ZERO]++;
+                changed = 1;
+                continue;
+            }
+
+            /* ջдأmovl %r, M; movl M, %s еĶȡΪĴͻɾ
+               movl M, %r; movl %r, M едɾ */
+            if (!(disabled & (1u << PEEPHOLE_STORE_LOAD)) && insn->op == ASM_MOV && insn->size == 4) {
+                j = asm_next_real(compiler, i);
+                if (j < 0) continue;
+                next = &compiler->asm_code[j];
+                if (next->op != ASM_MOV || next->size != 4) continue;
+                if (insn->src.kind == AO_REG && insn->dst.kind == AO_MEM &&
+                    asm_operand_equal(&next->src, &insn->dst) && next->dst.kind == AO_REG) {
+                    if (next->dst.base == insn->src.base) next->op = ASM_DELETED;
+                    else next->src = insn->src;
+                    hits[PEEPHOLE_STORE_LOAD]++;
+                    changed = 1;
+                }
+                else if (insn->src.kind == AO_MEM && insn->dst.kind == AO_REG &&
+                    asm_operand_equal(&next->src, &insn->dst) && asm_operand_equal(&next->dst, &insn->src)) {
+                    next->op = ASM_DELETED;
+                    hits[PEEPHOLE_STORE_LOAD]++;
+                    changed = 1;
+                }
+            }
+        }
+    }
+
+    /* ѹɾָ */
+    kept = 0;
+    for (i = 0; i < compiler->asm_count; i++) {
+        if (compiler->asm_code[i].op != ASM_DELETED) compiler->asm_code[kept++] = compiler->asm_code[i];
+    }
+    compiler->asm_count = kept;
+
+    for (i = 0; i < PEEPHOLE_RULE_COUNT; i++) total += hits[i];
+    return total;
+}
+
+/* һд AT&T ﷨ı */
+static const char* asm_operand_text(const AsmOperand* operand, int size, char* buffer)
+{
+    switch (operand->kind) {
+    case AO_REG:
+        return size == 8 ? asm_reg64_name[operand->base] : asm_reg32_name[operand->base];
+    case AO_IMM:
+        sprintf_s(buffer, 48, "$%d", (int)operand->value);
+        return buffer;
+    case AO_MEM:
+        if (operand->index < 0 && operand->value == 0) {
+            sprintf_s(buffer, 48, "(%s)", asm_reg64_name[operand->base]);
+        }
+        else if (operand->index < 0) {
+            sprintf_s(buffer, 48, "%d(%s)", (int)operand->value, asm_reg64_name[operand->base]);
+        }
+        else if (operand->base < 0) {
+            sprintf_s(buffer, 48, "%d(,%s,%d)", (int)operand->value, asm_reg64_name[operand->index], operand->scale);
+        }
+        else {
+            int length = operand->value != 0 ? sprintf_s(buffer, 48, "%d", (int)operand->value) : 0;
+            if (operand->scale != 1) {
+                sprintf_s(buffer + length, 48 - length, "(%s,%s,%d)", asm_reg64_name[operand->base],
+                    asm_reg64_name[operand->index], operand->scale);
+            }
+            else {
+                sprintf_s(buffer + length, 48 - length, "(%s,%s)", asm_reg64_name[operand->base],
+                    asm_reg64_name[operand->index]);
+            }
+        }
+        return buffer;
+    case AO_RIP:
+        sprintf_s(buffer, 48, "%s(%%rip)", asm_symbol_name[operand->value]);
+        return buffer;
+    case AO_SYMBOL:
+        return asm_symbol_name[operand->value];
+    case AO_LABEL:
+        sprintf_s(buffer, 48, ".L%d", (int)operand->value);
+        return buffer;
+    default:
+        return "";
+    }
+}
+
+/* ָͬݶΡһдɻı */
+void write_assembly(Compiler* compiler)
+{
+    char src_buffer[48];
+    char dst_buffer[48];
+    char mnemonic[16];
+    int i;
+
+    /* ӻͷ */
+    emit_code(compiler, ".section .rodata\n");
+    emit_code(compiler, ".LC0:\n");
+    emit_code(compiler, "    .string \"%%d\"\n");
+    emit_code(compiler, ".LC1:\n");
+    emit_code(compiler, "    .string \"%%d\\n\"\n");
+    emit_code(compiler, "\n");
+    emit_code(compiler, ".section .text\n");
+    emit_code(compiler, ".globl main\n");
+    emit_code(compiler, "main:\n");
+
+    for (i = 0; i < compiler->asm_count; i++) {
+        AsmInstruction* insn = &compiler->asm_code[i];
+        const char* src;
+        const char* dst;
+
+        if (insn->op == ASM_BLANK) {
+            emit_code(compiler, "\n");
+            continue;
+        }
+        if (insn->op == ASM_COMMENT) {
+            emit_code(compiler, "    # %s\n", insn->comment);
+            continue;
+        }
+        if (insn->op == ASM_LABEL) {
+            emit_code(compiler, insn->comment != NULL ? ".L%d:  # %s\n" : ".L%d:\n", (int)insn->dst.value, insn->comment);
+            continue;
+        }
+
+        sprintf_s(mnemonic, sizeof(mnemonic), "%s%s", asm_opcode_name[insn->op],
+            asm_opcode_sized[insn->op] ? (insn->size == 8 ? "q" : "l") : "");
+        src = asm_operand_text(&insn->src, insn->size, src_buffer);
+        dst = asm_operand_text(&insn->dst, insn->size, dst_buffer);
+        if (insn->op == ASM_IMUL3) {
+            emit_code(compiler, "    %-8s$%d, %s, %s", mnemonic, (int)insn->immediate, src, dst);
+        }
+        else if (insn->src.kind != AO_NONE) {
+            emit_code(compiler, "    %-8s%s, %s", mnemonic, src, dst);
+        }
+        else if (insn->dst.kind != AO_NONE) {
+            emit_code(compiler, "    %-8s%s", mnemonic, dst);
+        }
+        else {
+            emit_code(compiler, "    %s", mnemonic);
+        }
+        emit_code(compiler, insn->comment != NULL ? "  # %s\n" : "\n", insn->comment);
+    }
+
+    emit_code(compiler, "\n");
+    emit_code(compiler, ".section .note.GNU-stack,\"\",@progbits\n");
+}
+
+/* Ŀļ */
+
+/* ָ󳤶 */
+#define ASM_MAX_ENCODING 15
+
+/* ELF64 ֻõ x86-64 ضλļҪĲ֣ */
+#define ELF_HEADER_SIZE 64
+#define ELF_SECTION_HEADER_SIZE 64
+#define ELF_SYMBOL_SIZE 24
+#define ELF_RELA_SIZE 24
+#define ELF_SHT_PROGBITS 1
+#define ELF_SHT_SYMTAB 2
+#define ELF_SHT_STRTAB 3
+#define ELF_SHT_RELA 4
+#define ELF_SHF_ALLOC 2
+#define ELF_SHF_EXECINSTR 4
+#define ELF_SHF_INFO_LINK 0x40
+#define ELF_R_X86_64_PC32 2
+#define ELF_R_X86_64_PLT32 4
+
+/* ĿļĽڣͷ˳ */
+enum {
+    SECTION_NULL, SECTION_TEXT, SECTION_RELA_TEXT, SECTION_RODATA, SECTION_NOTE,
+    SECTION_SYMTAB, SECTION_STRTAB, SECTION_SHSTRTAB, SECTION_COUNT
+};
+
+/* ű0 Ϊշţ1 Ϊ .rodata ĽڷţֲΪȫַ */
+enum { ELF_SYMBOL_RODATA = 1, ELF_SYMBOL_MAIN, ELF_SYMBOL_SCANF, ELF_SYMBOL_PRINTF, ELF_SYMBOL_COUNT };
+
+/* ֻݣʽƫư AsmSymbol  */
+static const char object_rodata[] = "%d\0%d\n";
+static const uint32_t object_rodata_offset[] = { 0, 3 };
+
+static const char object_strtab[] = "\0main\0scanf\0printf";
+static const uint32_t object_strtab_offset[ELF_SYMBOL_COUNT] = { 0, 0, 1, 6, 12 };
+static const char object_shstrtab[] = "\0.text\0.rela.text\0.rodata\0.note.GNU-stack\0.symtab\0.strtab\0.shstrtab";
+static const uint32_t object_shstrtab_offset[SECTION_COUNT] = { 0, 1, 7, 18, 26, 42, 50, 58 };
+
+/* Сд */
+static uint8_t* put16(uint8_t* p, uint32_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    return p + 2;
+}
+
+static uint8_t* put32(uint8_t* p, uint32_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+    return p + 4;
+}
+
+static uint8_t* put64(uint8_t* p, uint64_t value)
+{
+    p = put32(p, (uint32_t)value);
+    return put32(p, (uint32_t)(value >> 32));
+}
+
+static int fits_int8(int32_t value)
+{
+    return value >= -128 && value <= 127;
+}
+
+/* REX ǰ׺w Ϊ 64 λreg Ϊ ModRM.reg ֶεļĴţrm Ϊ r/m Ҫʱд */
+static uint8_t* encode_rex(uint8_t* p, int w, int reg, const AsmOperand* rm)
+{
+    int rex = (w ? 8 : 0) | (reg >= 8 ? 4 : 0);
+
+    if (rm->kind == AO_REG && rm->base >= 8) rex |= 1;
+    if (rm->kind == AO_MEM) {
+        if (rm->index >= 8) rex |= 2;
+        if (rm->base >= 8) rex |= 1;
+    }
+    if (rex != 0) *p++ = (uint8_t)(0x40 | rex);
+    return p;
+}
+
+/* ModRM ֽڼ SIBƫơ%rip Եַ 32 λƫд 0λü *rip_field */
+static uint8_t* encode_modrm(uint8_t* p, int reg, const AsmOperand* rm, uint8_t** rip_field)
+{
+    int mod;
+
+    reg &= 7;
+    if (rm->kind == AO_REG) {
+        *p++ = (uint8_t)(0xC0 | reg << 3 | (rm->base & 7));
+        return p;
+    }
+    if (rm->kind == AO_RIP) {
+        *p++ = (uint8_t)(0x05 | reg << 3);
+        *rip_field = p;
+        return put32(p, 0);
+    }
+
+    /* %rbp%r13 ַʱûƫƵʽ%rsp%r12 ַбַʱҪ SIB */
+    if (rm->base < 0) mod = 0;
+    else if (rm->value == 0 && (rm->base & 7) != REG_RBP) mod = 0;
+    else mod = fits_int8(rm->value) ? 1 : 2;
+
+    if (rm->index < 0 && rm->base >= 0 && (rm->base & 7) != REG_RSP) {
+        *p++ = (uint8_t)(mod << 6 | reg << 3 | (rm->base & 7));
+    }
+    else {
+        int scale = rm->scale == 8 ? 3 : rm->scale == 4 ? 2 : rm->scale == 2 ? 1 : 0;
+        *p++ = (uint8_t)(mod << 6 | reg << 3 | REG_RSP);
+        *p++ = (uint8_t)(scale << 6 | (rm->index >= 0 ? rm->index & 7 : REG_RSP) << 3
+            | (rm->base >= 0 ? rm->base & 7 : REG_RBP));
+    }
+    if (mod == 1) *p++ = (uint8_t)(int8_t)rm->value;
+    else if (mod == 2 || rm->base < 0) p = put32(p, (uint32_t)rm->value);
+    return p;
+}
+
+/*  8 λչʱд 1 ֽڣ 4 ֽ */
+static uint8_t* encode_immediate(uint8_t* p, int32_t value)
+{
+    if (fits_int8(value)) {
+        *p++ = (uint8_t)(int8_t)value;
+        return p;
+    }
+    return put32(p, (uint32_t)value);
+}
+
+/* һĿָ뵽 code + *lengthҪضλֶ׷ӵ relocations
+   ѡ GNU as ͬһıѡһ */
+static void encode_instruction(const AsmInstruction* insn, uint8_t* code, size_t* length,
+    ObjectRelocation* relocations, int* relocation_count)
+{
+    /* ADDSUBANDXOR  ModRM.reg չĴʽĻ룬 AsmOpcode  */
+    static const uint8_t alu_digit[] = { 0, 0, 0, 5, 0, 0, 0, 0, 0, 0, 0, 0, 4, 6 };
+    static const uint8_t alu_base[] = { 0, 0, 0x00, 0x28, 0, 0, 0, 0, 0, 0, 0, 0, 0x20, 0x30 };
+    /*  F7 顢λ C1/D1 չ */
+    static const uint8_t unary_digit[] = { 0, 0, 0, 0, 0, 5, 7, 0, 3, 4, 7, 5 };
+    const AsmOperand* src = &insn->src;
+    const AsmOperand* dst = &insn->dst;
+    uint8_t* start = code + *length;
+    uint8_t* p = start;
+    uint8_t* rip_field = NULL;
+    int w = insn->size == 8;
+
+    switch (insn->op) {
+    case ASM_MOV:
+        if (src->kind == AO_IMM && dst->kind == AO_REG && !w) {
+            if (dst->base >= 8) *p++ = 0x41;
+            *p++ = (uint8_t)(0xB8 | (dst->base & 7));
+            p = put32(p, (uint32_t)src->value);
+        }
+        else if (src->kind == AO_IMM) {
+            p = encode_rex(p, w, 0, dst);
+            *p++ = 0xC7;
+            p = encode_modrm(p, 0, dst, &rip_field);
+            p = put32(p, (uint32_t)src->value);
+        }
+        else if (src->kind == AO_REG) {
+            p = encode_rex(p, w, src->base, dst);
+            *p++ = 0x89;
+            p = encode_modrm(p, src->base, dst, &rip_field);
+        }
+        else {
+            p = encode_rex(p, w, dst->base, src);
+            *p++ = 0x8B;
+            p = encode_modrm(p, dst->base, src, &rip_field);
+        }
+        break;
+
+    case ASM_LEA:
+        p = encode_rex(p, w, dst->base, src);
+        *p++ = 0x8D;
+        p = encode_modrm(p, dst->base, src, &rip_field);
+        break;
+
+    case ASM_ADD:
+    case ASM_SUB:
+    case ASM_AND:
+    case ASM_XOR:
+    case ASM_CMP:
+        if (src->kind == AO_IMM && !fits_int8(src->value) && dst->kind == AO_REG && dst->base == REG_RAX) {
+            /* ۼĶʽ */
+            if (w) *p++ = 0x48;
+            *p++ = (uint8_t)((insn->op == ASM_CMP ? 0x38 : alu_base[insn->op]) | 0x05);
+            p = put32(p, (uint32_t)src->value);
+        }
+        else if (src->kind == AO_IMM) {
+            p = encode_rex(p, w, 0, dst);
+            *p++ = fits_int8(src->value) ? 0x83 : 0x81;
+            p = encode_modrm(p, insn->op == ASM_CMP ? 7 : alu_digit[insn->op], dst, &rip_field);
+            p = encode_immediate(p, src->value);
+        }
+        else if (src->kind == AO_REG) {
+            p = encode_rex(p, w, src->base, dst);
+            *p++ = (uint8_t)(alu_base[insn->op] | 0x01);
+            p = encode_modrm(p, src->base, dst, &rip_field);
+        }
+        else {
+            p = encode_rex(p, w, dst->base, src);
+            *p++ = (uint8_t)(alu_base[insn->op] | 0x03);
+            p = encode_modrm(p, dst->base, src, &rip_field);
+        }
+        break;
+
+    case ASM_IMUL:
+        if (src->kind == AO_IMM) {
+            p = encode_rex(p, w, dst->base, dst);
+            *p++ = fits_int8(src->value) ? 0x6B : 0x69;
+            p = encode_modrm(p, dst->base, dst, &rip_field);
+            p = encode_immediate(p, src->value);
+        }
+        else {
+            p = encode_rex(p, w, dst->base, src);
+            *p++ = 0x0F;
+            *p++ = 0xAF;
+            p = encode_modrm(p, dst->base, src, &rip_field);
+        }
+        break;
+
+    case ASM_IMUL3:
+        p = encode_rex(p, w, dst->base, src);
+        *p++ = fits_int8(insn->immediate) ? 0x6B : 0x69;
+        p = encode_modrm(p, dst->base, src, &rip_field);
+        p = encode_immediate(p, insn->immediate);
+        break;
+
+    case ASM_IMUL1:
+    case ASM_IDIV:
+    case ASM_NEG:
+        p = encode_rex(p, w, 0, dst);
+        *p++ = 0xF7;
+        p = encode_modrm(p, unary_digit[insn->op], dst, &rip_field);
+        break;
+
+    case ASM_SHL:
+    case ASM_SAR:
+    case ASM_SHR:
+        p = encode_rex(p, w, 0, dst);
+        *p++ = src->value == 1 ? 0xD1 : 0xC1;
+        p = encode_modrm(p, unary_digit[insn->op], dst, &rip_field);
+        if (src->value != 1) *p++ = (uint8_t)src->value;
+        break;
+
+    case ASM_CLTD:
+        *p++ = 0x99;
+        break;
+
+    case ASM_PUSH:
+        if (dst->base >= 8) *p++ = 0x41;
+        *p++ = (uint8_t)(0x50 | (dst->base & 7));
+        break;
+
+    case ASM_CALL:
+        /* þ PLTĿʱȷ */
+        *p++ = 0xE8;
+        relocations[*relocation_count].offset = (uint32_t)(p - code);
+        relocations[*relocation_count].symbol = dst->value;
+        relocations[*relocation_count].addend = -4;
+        (*relocation_count)++;
+        p = put32(p, 0);
+        break;
+
+    case ASM_LEAVE:
+        *p++ = 0xC9;
+        break;
+
+    case ASM_RET:
+        *p++ = 0xC3;
+        break;
+
+    case ASM_JE:
+    case ASM_JNE:
+        /*  32 λƫƣ encode_program ڱλȷ */
+        *p++ = 0x0F;
+        *p++ = insn->op == ASM_JE ? 0x84 : 0x85;
+        p = put32(p, 0);
+        break;
+
+    default:
+        /* ע͡Сšɾָ */
+        break;
+    }
+
+    /* %rip Եַһָʼ */
+    if (rip_field != NULL) {
+        const AsmOperand* rip = src->kind == AO_RIP ? src : dst;
+        relocations[*relocation_count].offset = (uint32_t)(rip_field - code);
+        relocations[*relocation_count].symbol = rip->value;
+        relocations[*relocation_count].addend =
+            (int32_t)object_rodata_offset[rip->value] - (int32_t)(p - rip_field);
+        (*relocation_count)++;
+    }
+    *length += (size_t)(p - start);
+}
+
+/* ָбɻ룬ضλд *relocationsͷߣ
+   ڴ治ʱ NULL */
+static uint8_t* encode_program(Compiler* compiler, size_t* length, ObjectRelocation** relocations,
+    int* relocation_count)
+{
+    /* ÿָ ASM_MAX_ENCODING ֽڡһضλ */
+    uint8_t* code = (uint8_t*)malloc((size_t)compiler->asm_count * ASM_MAX_ENCODING + 1);
+    ObjectRelocation* table = (ObjectRelocation*)malloc((size_t)compiler->asm_count * sizeof(ObjectRelocation) + 1);
+    size_t* label_offset = (size_t*)malloc(((size_t)compiler->label_count + 1) * sizeof(size_t));
+    int i;
+
+    *length = 0;
+    *relocation_count = 0;
+    if (code == NULL || table == NULL || label_offset == NULL) {
+        compile_error(compiler, "ڴʧܣ\n");
+        free(code);
+        free(table);
+        free(label_offset);
+        return NULL;
+    }
+    for (i = 0; i < compiler->asm_count; i++) {
+        if (compiler->asm_code[i].op == ASM_LABEL) label_offset[compiler->asm_code[i].dst.value] = *length;
+        encode_instruction(&compiler->asm_code[i], code, length, table, relocation_count);
+    }
+
+    /* תƫתָĩβбʱһõÿתλ */
+    if (compiler->label_count > 0) {
+        int count = 0;
+        *length = 0;
+        for (i = 0; i < compiler->asm_count; i++) {
+            const AsmInstruction* insn = &compiler->asm_code[i];
+            encode_instruction(insn, code, length, table, &count);
+            if (insn->op == ASM_JE || insn->op == ASM_JNE) {
+                put32(code + *length - 4, (uint32_t)((int64_t)label_offset[insn->dst.value] - (int64_t)*length));
+            }
+        }
+    }
+    free(label_offset);
+    *relocations = table;
+    return code;
+}
+
+/* дһͷ */
+static uint8_t* put_section_header(uint8_t* p, int section, uint32_t type, uint64_t flags, uint64_t offset,
+    uint64_t size, uint32_t link, uint32_t info, uint64_t align, uint64_t entry_size)
+{
+    p = put32(p, object_shstrtab_offset[section]);
+    p = put32(p, type);
+    p = put64(p, flags);
+    p = put64(p, 0);        /* ַضλļΪ 0 */
+    p = put64(p, offset);
+    p = put64(p, size);
+    p = put32(p, link);
+    p = put32(p, info);
+    p = put64(p, align);
+    return put64(p, entry_size);
+}
+
+/* ֱָӱɻ룬д x86-64  ELF64 ضλĿļ
+   .text  main.rodata ʽscanfprintf Ϊδȫַš
+   ֣ELF ͷ.text.rodata.rela.text.symtab.strtab.shstrtabͷ */
+void write_object(Compiler* compiler)
+{
+    uint8_t header[ELF_HEADER_SIZE];
+    uint8_t symbols[ELF_SYMBOL_COUNT * ELF_SYMBOL_SIZE];
+    uint8_t sections[SECTION_COUNT * ELF_SECTION_HEADER_SIZE];
+    uint8_t rela[ELF_RELA_SIZE];
+    static const uint8_t padding[16] = { 0 };
+    uint8_t* code;
+    uint8_t* p;
+    ObjectRelocation* relocations;
+    int relocation_count;
+    size_t code_length;
+    uint64_t rodata_offset, rela_offset, symtab_offset, strtab_offset, shstrtab_offset, section_offset;
+    int i;
+
+    code = encode_program(compiler, &code_length, &relocations, &relocation_count);
+    if (code == NULL) return;
+
+    rodata_offset = ELF_HEADER_SIZE + code_length;
+    rela_offset = (rodata_offset + sizeof(object_rodata) + 7) & ~(uint64_t)7;
+    symtab_offset = rela_offset + (uint64_t)relocation_count * ELF_RELA_SIZE;
+    strtab_offset = symtab_offset + sizeof(symbols);
+    shstrtab_offset = strtab_offset + sizeof(object_strtab);
+    section_offset = (shstrtab_offset + sizeof(object_shstrtab) + 7) & ~(uint64_t)7;
+
+    /* ELF ͷ */
+    memset(header, 0, sizeof(header));
+    memcpy(header, "\177ELF", 4);
+    header[4] = 2;          /* ELFCLASS64 */
+    header[5] = 1;          /* ELFDATA2LSB */
+    header[6] = 1;          /* EV_CURRENT */
+    p = put16(header + 16, 1);  /* ET_REL */
+    p = put16(p, 62);       /* EM_X86_64 */
+    p = put32(p, 1);
+    p = put64(p, 0);        /*  */
+    p = put64(p, 0);        /* ͷ */
+    p = put64(p, section_offset);
+    p = put32(p, 0);
+    p = put16(p, ELF_HEADER_SIZE);
+    p = put16(p, 0);
+    p = put16(p, 0);
+    p = put16(p, ELF_SECTION_HEADER_SIZE);
+    p = put16(p, SECTION_COUNT);
+    put16(p, SECTION_SHSTRTAB);
+    emit_bytes(compiler, header, sizeof(header));
+
+    emit_bytes(compiler, code, code_length);
+    emit_bytes(compiler, object_rodata, sizeof(object_rodata));
+    emit_bytes(compiler, padding, (size_t)(rela_offset - rodata_offset - sizeof(object_rodata)));
+
+    /* ضλʽ .rodata Ľڷżƫƣ scanfprintf */
+    for (i = 0; i < relocation_count; i++) {
+        const ObjectRelocation* relocation = &relocations[i];
+        int call = relocation->symbol == SYMBOL_SCANF || relocation->symbol == SYMBOL_PRINTF;
+        uint64_t symbol = !call ? ELF_SYMBOL_RODATA
+            : relocation->symbol == SYMBOL_SCANF ? ELF_SYMBOL_SCANF : ELF_SYMBOL_PRINTF;
+        p = put64(rela, relocation->offset);
+        p = put64(p, symbol << 32 | (call ? ELF_R_X86_64_PLT32 : ELF_R_X86_64_PC32));
+        put64(p, (uint64_t)(int64_t)relocation->addend);
+        emit_bytes(compiler, rela, sizeof(rela));
+    }
+
+    /* ű֡󶨡ڽڡֵС */
+    memset(symbols, 0, sizeof(symbols));
+    for (i = 1; i < ELF_SYMBOL_COUNT; i++) {
+        p = symbols + i * ELF_SYMBOL_SIZE;
+        put32(p, object_strtab_offset[i]);
+    }
+    symbols[ELF_SYMBOL_RODATA * ELF_SYMBOL_SIZE + 4] = 3;                 /* STB_LOCAL, STT_SECTION */
+    put16(symbols + ELF_SYMBOL_RODATA * ELF_SYMBOL_SIZE + 6, SECTION_RODATA);
+    symbols[ELF_SYMBOL_MAIN * ELF_SYMBOL_SIZE + 4] = 1 << 4 | 2;          /* STB_GLOBAL, STT_FUNC */
+    put16(symbols + ELF_SYMBOL_MAIN * ELF_SYMBOL_SIZE + 6, SECTION_TEXT);
+    put64(symbols + ELF_SYMBOL_MAIN * ELF_SYMBOL_SIZE + 16, code_length);
+    symbols[ELF_SYMBOL_SCANF * ELF_SYMBOL_SIZE + 4] = 1 << 4;             /* STB_GLOBAL, STT_NOTYPE */
+    symbols[ELF_SYMBOL_PRINTF * ELF_SYMBOL_SIZE + 4] = 1 << 4;
+    emit_bytes(compiler, symbols, sizeof(symbols));
+
+    emit_bytes(compiler, object_strtab, sizeof(object_strtab));
+    emit_bytes(compiler, object_shstrtab, sizeof(object_shstrtab));
+    emit_bytes(compiler, padding,
+        (size_t)(section_offset - shstrtab_offset - sizeof(object_shstrtab)));
+
+    /* ͷ */
+    memset(sections, 0, ELF_SECTION_HEADER_SIZE);
+    p = sections + ELF_SECTION_HEADER_SIZE;
+    p = put_section_header(p, SECTION_TEXT, ELF_SHT_PROGBITS, ELF_SHF_ALLOC | ELF_SHF_EXECINSTR,
+        ELF_HEADER_SIZE, code_length, 0, 0, 16, 0);
+    p = put_section_header(p, SECTION_RELA_TEXT, ELF_SHT_RELA, ELF_SHF_INFO_LINK,
+        rela_offset, (uint64_t)relocation_count * ELF_RELA_SIZE, SECTION_SYMTAB, SECTION_TEXT, 8, ELF_RELA_SIZE);
+    p = put_section_header(p, SECTION_RODATA, ELF_SHT_PROGBITS, ELF_SHF_ALLOC,
+        rodata_offset, sizeof(object_rodata), 0, 0, 1, 0);
+    p = put_section_header(p, SECTION_NOTE, ELF_SHT_PROGBITS, 0, rela_offset, 0, 0, 0, 1, 0);
+    p = put_section_header(p, SECTION_SYMTAB, ELF_SHT_SYMTAB, 0,
+        symtab_offset, sizeof(symbols), SECTION_STRTAB, ELF_SYMBOL_MAIN, 8, ELF_SYMBOL_SIZE);
+    p = put_section_header(p, SECTION_STRTAB, ELF_SHT_STRTAB, 0,
+        strtab_offset, sizeof(object_strtab), 0, 0, 1, 0);
+    put_section_header(p, SECTION_SHSTRTAB, ELF_SHT_STRTAB, 0,
+        shstrtab_offset, sizeof(object_shstrtab), 0, 0, 1, 0);
+    emit_bytes(compiler, sections, sizeof(sections));
+
+    free(code);
+    free(relocations);
+}
+
+/* ʱִ */
+
+/* ɵĴ밴 System V Լûصֻ x86-64  POSIX ƽִ̨ */
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(_WIN32)
+#define JIT_SUPPORTED 1
+#endif
+
+/* 壺movabs $context, %rdi; movabs $callback, %rax; jmp *%rax
+   ɵĴ scanfprintf ʱ %rsi Ϊֵַ %rdi еĸʽɻص context */
+#define JIT_TRAMPOLINE_SIZE 22
+
+/* ڣ·ջϵɵ mainغ󻻻ԭջ
+   pushq %rbx; movq %rsp, %rbx; movq %rdi, %rsp; call main; movq %rbx, %rsp; popq %rbx; ret */
+#define JIT_ENTRY_SIZE 17
+
+/* ջջ֮֡ scanfprintf ʹõĿռ */
+#define JIT_STACK_RESERVE (1024 * 1024)
+
+/* ʱ inputoutput ʵʵõĻصʱִִֽйã */
+typedef struct {
+    int (*input)(void* context, int* value);
+    void* input_context;
+    void (*output)(void* context, int value);
+    void* output_context;
+} RunIo;
+
+/* Ĭϵ׼롢׼ɵĳ򵥶ʱͬ */
+static int jit_stdin_input(void* context, int* value)
+{
+    (void)context;
+    return scanf("%d", value) == 1;
+}
+
+static void jit_stdout_output(void* context, int value)
+{
+    (void)context;
+    printf("%d\n", value);
+}
+
+/* ṩĻcontext Ϊ JitIo */
+static int jit_buffer_input(void* context, int* value)
+{
+    JitIo* io = (JitIo*)context;
+
+    if (io->input_used >= io->input_count) return 0;
+    *value = io->input_values[io->input_used++];
+    return 1;
+}
+
+static void jit_buffer_output(void* context, int value)
+{
+    JitIo* io = (JitIo*)context;
+
+    if (io->output_count < io->output_capacity) io->output_values[io->output_count] = value;
+    io->output_count++;
+}
+
+/*  JitIo Լѡصصȣλ׼ */
+static void resolve_io(JitIo* io, RunIo* run)
+{
+    run->input = jit_stdin_input;
+    run->input_context = NULL;
+    run->output = jit_stdout_output;
+    run->output_context = NULL;
+    if (io != NULL && io->input != NULL) {
+        run->input = io->input;
+        run->input_context = io->context;
+    }
+    else if (io != NULL && io->input_values != NULL) {
+        run->input = jit_buffer_input;
+        run->input_context = io;
+    }
+    if (io != NULL && io->output != NULL) {
+        run->output = io->output;
+        run->output_context = io->context;
+    }
+    else if (io != NULL && io->output_values != NULL) {
+        run->output = jit_buffer_output;
+        run->output_context = io;
+    }
+}
+
+#ifdef JIT_SUPPORTED
+static uint8_t* put_trampoline(uint8_t* p, void* context, uint64_t callback)
+{
+    *p++ = 0x48;
+    *p++ = 0xBF;
+    p = put64(p, (uint64_t)(uintptr_t)context);
+    *p++ = 0x48;
+    *p++ = 0xB8;
+    p = put64(p, callback);
+    *p++ = 0xFF;
+    *p++ = 0xE0;
+    return p;
+}
+
+/* ڴ룬main λƫ 0 entry Ϊڴƫ */
+static void put_entry(uint8_t* p, size_t entry)
+{
+    static const uint8_t prologue[] = { 0x53, 0x48, 0x89, 0xE3, 0x48, 0x89, 0xFC, 0xE8 };
+    static const uint8_t epilogue[] = { 0x48, 0x89, 0xDC, 0x5B, 0xC3 };
+
+    memcpy(p, prologue, sizeof(prologue));
+    p = put32(p + sizeof(prologue), (uint32_t)(0 - (int64_t)(entry + sizeof(prologue) + 4)));
+    memcpy(p, epilogue, sizeof(epilogue));
+}
+#endif
+
+/* ָб뵽ִڴвãسķֵʧʱ -1
+   ֣롢ʽ壨scanfprintf ĵøΪ壩ڴ롣
+   ӳջУ뵥еĳһδֵı 0 */
+static int jit_execute(Compiler* compiler, JitIo* io)
+{
+#ifdef JIT_SUPPORTED
+    RunIo run;
+    int (*entry)(void*);
+    ObjectRelocation* relocations;
+    int relocation_count;
+    size_t code_length;
+    size_t trampoline_offset;
+    size_t entry_offset;
+    size_t size;
+    size_t stack_size;
+    uint8_t* code;
+    uint8_t* memory;
+    uint8_t* stack;
+    uint8_t* p;
+    int status;
+    int i;
+
+    resolve_io(io, &run);
+    code = encode_program(compiler, &code_length, &relocations, &relocation_count);
+    if (code == NULL) return -1;
+    trampoline_offset = (code_length + sizeof(object_rodata) + 7) & ~(size_t)7;
+    entry_offset = trampoline_offset + 2 * JIT_TRAMPOLINE_SIZE;
+    size = entry_offset + JIT_ENTRY_SIZE;
+
+    /* ԿдʽãٸΪִֻУκʱ̶ͬʱдִ */
+    memory = (uint8_t*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        compile_error(compiler, "޷ִڴ\n");
+        free(code);
+        free(relocations);
+        return -1;
+    }
+    memcpy(memory, code, code_length);
+    memcpy(memory + code_length, object_rodata, sizeof(object_rodata));
+    p = put_trampoline(memory + trampoline_offset, run.input_context, (uint64_t)(uintptr_t)run.input);
+    put_trampoline(p, run.output_context, (uint64_t)(uintptr_t)run.output);
+    put_entry(memory + entry_offset, entry_offset);
+
+    /* ضλֵֶΪ ŵַ + addend - ֶεַͬһڴ */
+    for (i = 0; i < relocation_count; i++) {
+        const ObjectRelocation* relocation = &relocations[i];
+        size_t target = relocation->symbol == SYMBOL_SCANF ? trampoline_offset
+            : relocation->symbol == SYMBOL_PRINTF ? trampoline_offset + JIT_TRAMPOLINE_SIZE : code_length;
+        put32(memory + relocation->offset,
+            (uint32_t)((int64_t)target + relocation->addend - (int64_t)relocation->offset));
+    }
+    free(code);
+    free(relocations);
+
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        compile_error(compiler, "޷ѻΪִ\n");
+        munmap(memory, size);
+        return -1;
+    }
+
+    /* ջҳ룬ǰ 16 ֽڶҪ */
+    stack_size = (size_t)compiler->frame_size + JIT_STACK_RESERVE;
+    stack = (uint8_t*)mmap(NULL, stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (stack == MAP_FAILED) {
+        compile_error(compiler, "޷ջ\n");
+        munmap(memory, size);
+        return -1;
+    }
+    *(void**)&entry = memory + entry_offset;
+    status = entry(stack + stack_size);
+    munmap(stack, stack_size);
+    munmap(memory, size);
+    if (status != 0) {
+        compile_error(compiler, "д󣺳 0 \n");
+        return -1;
+    }
+    return status;
+#else
+    (void)io;
+    compile_error(compiler, "ʱִֻ֧ x86-64  POSIX ƽ̨\n");
+    return -1;
+#endif
+}
+
+/* ִֽ */
+
+/* GCCClang ñǩֱַɣ switch */
+#if defined(__GNUC__) && !defined(VM_NO_THREADING)
+#define VM_THREADED 1
+#endif
+
+/* ֽ롣ĴΪ± 0..var_count-1ʱ󣩣
+   ׺ I ָڶԴΪR ͷΪ
+   ָмֻͨһεʱָϳһ */
+typedef enum {
+    VM_INPUT,           /* input r[d]ǳе a  input */
+    VM_OUTPUT,          /* output r[a]ǳе b  output */
+    VM_MOV,             /* r[d] = r[a] */
+    VM_MOVI,            /* r[d] = b */
+    VM_ADD,             /* r[d] = r[a] + r[b] */
+    VM_ADDI,            /* r[d] = r[a] + b */
+    VM_SUB,             /* r[d] = r[a] - r[b] */
+    VM_RSUBI,           /* r[d] = b - r[a] */
+    VM_MUL,             /* r[d] = r[a] * r[b] */
+    VM_MULI,            /* r[d] = r[a] * b */
+    VM_DIV,             /* r[d] = r[a] / r[b] idivl һڳ 0INT_MIN / -1 ʱ */
+    VM_DIVI,            /* r[d] = r[a] / bb  0 */
+    VM_RDIVI,           /* r[d] = b / r[a] */
+    VM_MOD,             /* r[d] = r[a] % r[b] */
+    VM_MODI,            /* r[d] = r[a] % bb  0 */
+    VM_RMODI,           /* r[d] = b % r[a] */
+    VM_ADD3,            /* r[d] = r[a] + r[b] + r[c] add */
+    VM_ADDI_ADD,        /* r[d] = r[a] + b + r[c]ӷ add */
+    VM_MULI_ADD,        /* r[d] = r[a] * b + r[c]˷ add */
+    VM_HALT,
+    VM_OP_COUNT
+} VmOpcode;
+
+/* ָֽֱʱ op ִǰ滻Ϊĵַ */
+typedef struct {
+    union {
+        const void* handler;
+        int op;             /* VmOpcode */
+    } code;
+    int32_t d;
+    int32_t a;
+    int32_t b;
+    int32_t c;
+} VmInstruction;
+
+/* ֽregister_count ĴΪװ볣ʱĴ */
+typedef struct {
+    VmInstruction* code;
+    int count;
+    int register_count;
+    int fused;              /* ϳɳָָ */
+    int input_count;        /* inputoutput  */
+    int output_count;
+} VmProgram;
+
+/* 32 λ㣬ɵĻһ */
+#define VM_WRAP_ADD(x, y) ((int32_t)((uint32_t)(x) + (uint32_t)(y)))
+#define VM_WRAP_SUB(x, y) ((int32_t)((uint32_t)(x) - (uint32_t)(y)))
+#define VM_WRAP_MUL(x, y) ((int32_t)((uint32_t)(x) * (uint32_t)(y)))
+
+/* мӦļĴװʱĴ scratch */
+static int32_t vm_register(Compiler* compiler, VmProgram* program, IROperand operand, int scratch)
+{
+    VmInstruction* insn;
+
+    if (operand_tag(operand) == OPERAND_VAR) return operand_index(operand);
+    if (operand_tag(operand) == OPERAND_TEMP) return compiler->var_count + operand_index(operand);
+    insn = &program->code[program->count++];
+    insn->code.op = VM_MOVI;
+    insn->d = program->register_count - 2 + scratch;
+    insn->a = 0;
+    insn->b = operand_constant(compiler, operand);
+    insn->c = 0;
+    return insn->d;
+}
+
+/* ׷һָ */
+static void vm_emit(VmProgram* program, int op, int32_t d, int32_t a, int32_t b)
+{
+    VmInstruction* insn = &program->code[program->count++];
+
+    insn->code.op = op;
+    insn->d = d;
+    insn->a = a;
+    insn->b = b;
+    insn->c = 0;
+}
+
+/* һм뷭Ϊֽ룺ŽָΪ 0 ʱɵĻһʱ */
+static void vm_translate_binary(Compiler* compiler, VmProgram* program, const IRInstruction* ir, int32_t d)
+{
+    /*  IRType УĴʽҡ */
+    static const int reg_form[] = { 0, 0, 0, VM_ADD, VM_SUB, VM_MUL, VM_DIV, VM_MOD };
+    static const int imm_form[] = { 0, 0, 0, VM_ADDI, VM_ADDI, VM_MULI, VM_DIVI, VM_MODI };
+    static const int left_form[] = { 0, 0, 0, VM_ADDI, VM_RSUBI, VM_MULI, VM_RDIVI, VM_RMODI };
+    int left_constant = is_constant_operand(ir->src1);
+    int right_constant = is_constant_operand(ir->src2);
+    int32_t k;
+
+    if (right_constant && !(operand_constant(compiler, ir->src2) == 0 && (ir->type == IR_DIV || ir->type == IR_MOD))) {
+        k = operand_constant(compiler, ir->src2);
+        if (ir->type == IR_SUB) k = VM_WRAP_SUB(0, k);
+        vm_emit(program, imm_form[ir->type], d, vm_register(compiler, program, ir->src1, 0), k);
+    }
+    else if (left_constant && !right_constant) {
+        vm_emit(program, left_form[ir->type], d, vm_register(compiler, program, ir->src2, 1),
+            operand_constant(compiler, ir->src1));
+    }
+    else {
+        int32_t a = vm_register(compiler, program, ir->src1, 0);
+        vm_emit(program, reg_form[ir->type], d, a, vm_register(compiler, program, ir->src2, 1));
+    }
+}
+
+/* мֽ롣ָǰһĽֻһεʱһΪһ
+   ļĴӷʱϳ ADD3ADDI_ADDMULI_ADD ָ */
+static int vm_build(Compiler* compiler, VmProgram* program)
+{
+    int temp_count = compiler->temp_var_counter;
+    int* uses;
+    int i;
+
+    program->register_count = compiler->var_count + temp_count + 2;
+    program->count = 0;
+    program->fused = 0;
+    program->input_count = 0;
+    program->output_count = 0;
+    /* ÿмֽ루װ볣 HALT */
+    program->code = (VmInstruction*)malloc(((size_t)compiler->ir_count * 3 + 1) * sizeof(VmInstruction));
+    uses = (int*)calloc((size_t)temp_count + 1, sizeof(int));
+    if (program->code == NULL || uses == NULL) {
+        compile_error(compiler, "ڴʧܣֽ\n");
+        free(program->code);
+        free(uses);
+        program->code = NULL;
+        return 0;
+    }
+    for (i = 0; i < compiler->ir_count; i++) {
+        const IRInstruction* ir = &compiler->ir_code[i];
+        if (operand_tag(ir->src1) == OPERAND_TEMP) uses[operand_index(ir->src1)]++;
+        if (operand_tag(ir->src2) == OPERAND_TEMP) uses[operand_index(ir->src2)]++;
+    }
+
+    for (i = 0; i < compiler->ir_count; i++) {
+        const IRInstruction* ir = &compiler->ir_code[i];
+        const IRInstruction* next = i + 1 < compiler->ir_count ? &compiler->ir_code[i + 1] : NULL;
+        int32_t d = ir->dest != OPERAND_NONE ? vm_register(compiler, program, ir->dest, 0) : 0;
+
+        if (next != NULL && next->type == IR_ADD && operand_tag(ir->dest) == OPERAND_TEMP &&
+            uses[operand_index(ir->dest)] == 1 && (next->src1 == ir->dest || next->src2 == ir->dest)) {
+            IROperand other = next->src1 == ir->dest ? next->src2 : next->src1;
+            int op = -1;
+
+            if (ir->type == IR_ADD && !is_constant_operand(ir->src1) && !is_constant_operand(ir->src2)) {
+                op = VM_ADD3;
+            }
+            else if ((ir->type == IR_ADD || ir->type == IR_MUL) &&
+                is_constant_operand(ir->src1) != is_constant_operand(ir->src2)) {
+                op = ir->type == IR_ADD ? VM_ADDI_ADD : VM_MULI_ADD;
+            }
+            if (op >= 0 && operand_tag(other) != OPERAND_NONE && !is_constant_operand(other)) {
+                VmInstruction* insn = &program->code[program->count++];
+                IROperand left = is_constant_operand(ir->src1) ? ir->src2 : ir->src1;
+                IROperand right = is_constant_operand(ir->src1) ? ir->src1 : ir->src2;
+                insn->code.op = op;
+                insn->d = vm_register(compiler, program, next->dest, 0);
+                insn->a = vm_register(compiler, program, left, 0);
+                insn->b = op == VM_ADD3 ? vm_register(compiler, program, right, 0) : operand_constant(compiler, right);
+                insn->c = vm_register(compiler, program, other, 0);
+                program->fused++;
+                i++;
+                continue;
+            }
+        }
+
+        switch (ir->type) {
+        case IR_INPUT:
+            vm_emit(program, VM_INPUT, d, program->input_count++, 0);
+            break;
+        case IR_OUTPUT:
+            vm_emit(program, VM_OUTPUT, 0, vm_register(compiler, program, ir->src1, 0), program->output_count++);
+            break;
+        case IR_ASSIGN:
+            if (is_constant_operand(ir->src1)) {
+                vm_emit(program, VM_MOVI, d, 0, operand_constant(compiler, ir->src1));
+            }
+            else {
+                vm_emit(program, VM_MOV, d, vm_register(compiler, program, ir->src1, 0), 0);
+            }
+            break;
+        default:
+            vm_translate_binary(compiler, program, ir, d);
+            break;
+        }
+    }
+    vm_emit(program, VM_HALT, 0, 0, 0);
+    free(uses);
+    return 1;
+}
+
+/* ִֽ루ִֻһΣֱʱ͵ظд˲룩ĴֵΪ 0
+   뵥еĳδֵıһ£ 0 0  INT_MIN / -1еĳڴ˴Ӳ쳣ʱ -1 */
+static int vm_execute(Compiler* compiler, VmProgram* program, const RunIo* io)
+{
+    VmInstruction* pc = program->code;
+    int32_t* r;
+    int32_t divisor;
+
+#ifdef VM_THREADED
+    static const void* const handlers[VM_OP_COUNT] = {
+        &&op_VM_INPUT, &&op_VM_OUTPUT, &&op_VM_MOV, &&op_VM_MOVI, &&op_VM_ADD, &&op_VM_ADDI,
+        &&op_VM_SUB, &&op_VM_RSUBI, &&op_VM_MUL, &&op_VM_MULI, &&op_VM_DIV, &&op_VM_DIVI,
+        &&op_VM_RDIVI, &&op_VM_MOD, &&op_VM_MODI, &&op_VM_RMODI, &&op_VM_ADD3, &&op_VM_ADDI_ADD,
+        &&op_VM_MULI_ADD, &&op_VM_HALT
+    };
+    int i;
+
+    for (i = 0; i < program->count; i++) {
+        program->code[i].code.handler = handlers[program->code[i].code.op];
+    }
+#define VM_CASE(name) op_##name:
+#define VM_NEXT() goto *(++pc)->code.handler
+#else
+#define VM_CASE(name) case name:
+#define VM_NEXT() pc++; continue
+#endif
+
+    r = (int32_t*)calloc((size_t)program->register_count, sizeof(int32_t));
+    if (r == NULL) {
+        compile_error(compiler, "ڴʧܣֽĴ\n");
+        return -1;
+    }
+
+#ifdef VM_THREADED
+    goto *pc->code.handler;
+#else
+    for (;;) {
+        switch (pc->code.op) {
+#endif
+    VM_CASE(VM_INPUT)
+        io->input(io->input_context, &r[pc->d]);
+        VM_NEXT();
+    VM_CASE(VM_OUTPUT)
+        io->output(io->output_context, r[pc->a]);
+        VM_NEXT();
+    VM_CASE(VM_MOV)
+        r[pc->d] = r[pc->a];
+        VM_NEXT();
+    VM_CASE(VM_MOVI)
+        r[pc->d] = pc->b;
+        VM_NEXT();
+    VM_CASE(VM_ADD)
+        r[pc->d] = VM_WRAP_ADD(r[pc->a], r[pc->b]);
+        VM_NEXT();
+    VM_CASE(VM_ADDI)
+        r[pc->d] = VM_WRAP_ADD(r[pc->a], pc->b);
+        VM_NEXT();
+    VM_CASE(VM_SUB)
+        r[pc->d] = VM_WRAP_SUB(r[pc->a], r[pc->b]);
+        VM_NEXT();
+    VM_CASE(VM_RSUBI)
+        r[pc->d] = VM_WRAP_SUB(pc->b, r[pc->a]);
+        VM_NEXT();
+    VM_CASE(VM_MUL)
+        r[pc->d] = VM_WRAP_MUL(r[pc->a], r[pc->b]);
+        VM_NEXT();
+    VM_CASE(VM_MULI)
+        r[pc->d] = VM_WRAP_MUL(r[pc->a], pc->b);
+        VM_NEXT();
+    VM_CASE(VM_DIV)
+        divisor = r[pc->b];
+        if (divisor == 0 || (divisor == -1 && r[pc->a] == INT32_MIN)) goto divide_error;
+        r[pc->d] = r[pc->a] / divisor;
+        VM_NEXT();
+    VM_CASE(VM_DIVI)
+        /*  -1 ΪȡINT_MIN  */
+        r[pc->d] = pc->b == -1 ? VM_WRAP_SUB(0, r[pc->a]) : r[pc->a] / pc->b;
+        VM_NEXT();
+    VM_CASE(VM_RDIVI)
+        divisor = r[pc->a];
+        if (divisor == 0 || (divisor == -1 && pc->b == INT32_MIN)) goto divide_error;
+        r[pc->d] = pc->b / divisor;
+        VM_NEXT();
+    VM_CASE(VM_MOD)
+        divisor = r[pc->b];
+        if (divisor == 0 || (divisor == -1 && r[pc->a] == INT32_MIN)) goto divide_error;
+        r[pc->d] = r[pc->a] % divisor;
+        VM_NEXT();
+    VM_CASE(VM_MODI)
+        r[pc->d] = pc->b == -1 ? 0 : r[pc->a] % pc->b;
+        VM_NEXT();
+    VM_CASE(VM_RMODI)
+        divisor = r[pc->a];
+        if (divisor == 0 || (divisor == -1 && pc->b == INT32_MIN)) goto divide_error;
+        r[pc->d] = pc->b % divisor;
+        VM_NEXT();
+    VM_CASE(VM_ADD3)
+        r[pc->d] = VM_WRAP_ADD(VM_WRAP_ADD(r[pc->a], r[pc->b]), r[pc->c]);
+        VM_NEXT();
+    VM_CASE(VM_ADDI_ADD)
+        r[pc->d] = VM_WRAP_ADD(VM_WRAP_ADD(r[pc->a], pc->b), r[pc->c]);
+        VM_NEXT();
+    VM_CASE(VM_MULI_ADD)
+        r[pc->d] = VM_WRAP_ADD(VM_WRAP_MUL(r[pc->a], pc->b), r[pc->c]);
+        VM_NEXT();
+    VM_CASE(VM_HALT)
+        free(r);
+        return 0;
+#ifndef VM_THREADED
+        }
+    }
+#endif
+#undef VM_CASE
+#undef VM_NEXT
+
+divide_error:
+    compile_error(compiler, "д󣺳 0  %d ֽ룩\n", (int)(pc - program->code));
+    free(r);
+    return -1;
+}
+
+/* ʽֵ */
+
+/* ÿļ¼ÿֽһĴ COLUMN_BLOCK Ԫͬһ㣬
+   ȡָɵĿ̯¼ */
+#define COLUMN_BLOCK 64
+
+/* ʽ򣺼ĴžѹÿĴֵʱռһ飨COLUMN_BLOCK  int32_t */
+struct ColumnProgram {
+    VmInstruction* code;
+    int count;
+    int register_count;
+    int zero_count;         /* ȶдļĴδֵıǰÿ鿪ʼʱ */
+    int input_count;        /*  k жӦе k  input */
+    int output_count;       /*  k жӦе k  output */
+    uint8_t* machine_code;  /* ʱ AVX2 ںˣִֻУNULL ʱʹÿ */
+    size_t machine_size;
+    int32_t* constants;     /* ںõռһĴŽ register_count ֮ */
+    int constant_count;
+};
+
+/* ȡļĴֶΣ1a2b4c8 ʾд r[d] */
+static const unsigned char vm_register_fields[VM_OP_COUNT] = {
+    8, 1, 9, 8, 11, 9, 11, 9, 11, 9, 11, 9, 9, 11, 9, 9, 15, 13, 13, 0
+};
+
+/* ѹĴţʹڵļĴ龡 L1 СȶдļĴ̶ǰ
+   ĴһζͷţĶֵáɹ 1 */
+static int column_compact(Compiler* compiler, VmProgram* program, ColumnProgram* column)
+{
+    int n = program->register_count;
+    int* table = (int*)malloc((size_t)n * 4 * sizeof(int));
+    int* last_use;
+    int* map;
+    int* free_list;
+    int* defined;
+    int next = 0;
+    int free_count = 0;
+    int i, f;
+
+    if (table == NULL) {
+        compile_error(compiler, "ڴʧܣʽĴ\n");
+        return 0;
+    }
+    last_use = table;
+    map = table + n;
+    free_list = table + 2 * n;
+    defined = table + 3 * n;
+    for (i = 0; i < n; i++) {
+        last_use[i] = -1;
+        map[i] = -1;
+        defined[i] = 0;
+    }
+
+    for (i = 0; i < program->count; i++) {
+        VmInstruction* insn = &program->code[i];
+        int fields = vm_register_fields[insn->code.op];
+        int32_t operand[3];
+        operand[0] = insn->a;
+        operand[1] = insn->b;
+        operand[2] = insn->c;
+        for (f = 0; f < 3; f++) {
+            if ((fields & (1 << f)) == 0) continue;
+            last_use[operand[f]] = i;
+            if (!defined[operand[f]] && map[operand[f]] < 0) map[operand[f]] = next++;
+        }
+        if (fields & 8) defined[insn->d] = 1;
+    }
+    column->zero_count = next;
+
+    for (i = 0; i < program->count; i++) {
+        VmInstruction* insn = &program->code[i];
+        int fields = vm_register_fields[insn->code.op];
+        int32_t* operand[3];
+        int32_t source[3];
+        operand[0] = &insn->a;
+        operand[1] = &insn->b;
+        operand[2] = &insn->c;
+        for (f = 0; f < 3; f++) {
+            if ((fields & (1 << f)) == 0) continue;
+            source[f] = *operand[f];
+            *operand[f] = map[source[f]];
+        }
+        /* ͷűָһζļĴд֮һԪȶд */
+        for (f = 0; f < 3; f++) {
+            if ((fields & (1 << f)) == 0 || last_use[source[f]] != i || map[source[f]] < 0) continue;
+            free_list[free_count++] = map[source[f]];
+            map[source[f]] = -1;
+        }
+        if (fields & 8) {
+            int32_t reg = insn->d;
+            if (map[reg] < 0) map[reg] = free_count > 0 ? free_list[--free_count] : next++;
+            insn->d = map[reg];
+            /* ֮ٶĽͷ */
+            if (last_use[reg] <= i) {
+                free_list[free_count++] = map[reg];
+                map[reg] = -1;
+            }
+        }
+    }
+
+    column->code = program->code;
+    column->count = program->count;
+    column->register_count = next;
+    column->input_count = program->input_count;
+    column->output_count = program->output_count;
+    free(table);
+    return 1;
+}
+
+/* λͼλ 1 λü 1mask  0ֻڳʱ */
+static size_t column_first_fault(uint64_t mask)
+{
+    size_t lane = 1;
+    while ((mask & 1) == 0) {
+        mask >>= 1;
+        lane++;
+    }
+    return lane;
+}
+
+/* ں˵Ļ㣺V_vec Ϊһ lanes  int32_tӼ 32 λơתΪ
+   double ٽضϣܾȷʾ̵Сڵľ룬
+   ضϽȫͬdivide_fault  0INT_MIN / -1 Ԫλͼ */
+#ifdef COLUMN_SIMD
+typedef __m128i sse2_vec;
+
+FORCE_INLINE sse2_vec sse2_load(const int32_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+FORCE_INLINE void sse2_store(int32_t* p, sse2_vec v) { _mm_storeu_si128((__m128i*)p, v); }
+FORCE_INLINE sse2_vec sse2_set1(int32_t k) { return _mm_set1_epi32(k); }
+FORCE_INLINE sse2_vec sse2_add(sse2_vec x, sse2_vec y) { return _mm_add_epi32(x, y); }
+FORCE_INLINE sse2_vec sse2_sub(sse2_vec x, sse2_vec y) { return _mm_sub_epi32(x, y); }
+
+/* SSE2 û 32 λ˷pmulld  SSE4.1 pmuludq ֱżԪغ֯ */
+FORCE_INLINE sse2_vec sse2_mul(sse2_vec x, sse2_vec y)
+{
+    __m128i even = _mm_mul_epu32(x, y);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(x, 32), _mm_srli_epi64(y, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+FORCE_INLINE sse2_vec sse2_div(sse2_vec x, sse2_vec y)
+{
+    __m128d low = _mm_div_pd(_mm_cvtepi32_pd(x), _mm_cvtepi32_pd(y));
+    __m128d high = _mm_div_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2))),
+                              _mm_cvtepi32_pd(_mm_shuffle_epi32(y, _MM_SHUFFLE(1, 0, 3, 2))));
+    return _mm_unpacklo_epi64(_mm_cvttpd_epi32(low), _mm_cvttpd_epi32(high));
+}
+
+FORCE_INLINE unsigned int sse2_divide_fault(sse2_vec x, sse2_vec y)
+{
+    __m128i zero = _mm_cmpeq_epi32(y, _mm_setzero_si128());
+    __m128i overflow = _mm_and_si128(_mm_cmpeq_epi32(y, _mm_set1_epi32(-1)),
+                                     _mm_cmpeq_epi32(x, _mm_set1_epi32(INT32_MIN)));
+    return (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(_mm_or_si128(zero, overflow)));
+}
+
+typedef __m256i avx2_vec;
+
+TARGET_AVX2 FORCE_INLINE avx2_vec avx2_load(const int32_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+TARGET_AVX2 FORCE_INLINE void avx2_store(int32_t* p, avx2_vec v) { _mm256_storeu_si256((__m256i*)p, v); }
+TARGET_AVX2 FORCE_INLINE avx2_vec avx2_set1(int32_t k) { return _mm256_set1_epi32(k); }
+TARGET_AVX2 FORCE_INLINE avx2_vec avx2_add(avx2_vec x, avx2_vec y) { return _mm256_add_epi32(x, y); }
+TARGET_AVX2 FORCE_INLINE avx2_vec avx2_sub(avx2_vec x, avx2_vec y) { return _mm256_sub_epi32(x, y); }
+TARGET_AVX2 FORCE_INLINE avx2_vec avx2_mul(avx2_vec x, avx2_vec y) { return _mm256_mullo_epi32(x, y); }
+
+TARGET_AVX2 FORCE_INLINE avx2_vec avx2_div(avx2_vec x, avx2_vec y)
+{
+    __m256d low = _mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(x)),
+                                _mm256_cvtepi32_pd(_mm256_castsi256_si128(y)));
+    __m256d high = _mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(x, 1)),
+                                 _mm256_cvtepi32_pd(_mm256_extracti128_si256(y, 1)));
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm256_cvttpd_epi32(low)), _mm256_cvttpd_epi32(high), 1);
+}
+
+TARGET_AVX2 FORCE_INLINE unsigned int avx2_divide_fault(avx2_vec x, avx2_vec y)
+{
+    __m256i zero = _mm256_cmpeq_epi32(y, _mm256_setzero_si256());
+    __m256i overflow = _mm256_and_si256(_mm256_cmpeq_epi32(y, _mm256_set1_epi32(-1)),
+                                        _mm256_cmpeq_epi32(x, _mm256_set1_epi32(INT32_MIN)));
+    return (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_or_si256(zero, overflow)));
+}
+#else
+typedef int32_t scalar_vec;
+
+FORCE_INLINE scalar_vec scalar_load(const int32_t* p) { return *p; }
+FORCE_INLINE void scalar_store(int32_t* p, scalar_vec v) { *p = v; }
+FORCE_INLINE scalar_vec scalar_set1(int32_t k) { return k; }
+FORCE_INLINE scalar_vec scalar_add(scalar_vec x, scalar_vec y) { return VM_WRAP_ADD(x, y); }
+FORCE_INLINE scalar_vec scalar_sub(scalar_vec x, scalar_vec y) { return VM_WRAP_SUB(x, y); }
+FORCE_INLINE scalar_vec scalar_mul(scalar_vec x, scalar_vec y) { return VM_WRAP_MUL(x, y); }
+
+FORCE_INLINE unsigned int scalar_divide_fault(scalar_vec x, scalar_vec y)
+{
+    return y == 0 || (y == -1 && x == INT32_MIN);
+}
+
+FORCE_INLINE scalar_vec scalar_div(scalar_vec x, scalar_vec y)
+{
+    return scalar_divide_fault(x, y) ? 0 : x / y;
+}
+#endif
+
+/* һ¼ִȫֽ룺Ĵ i ռ r[i * COLUMN_BLOCK ..]ǰ valid ¼Ч
+    base ļ¼ 0Ч¼г 0 ʱصһļ¼ڿڵż 1 */
+#define COLUMN_REGISTER(field) (r + (size_t)insn->field * COLUMN_BLOCK)
+#define DEFINE_COLUMN_KERNEL(name, attribute, V, lanes) \
+attribute static size_t name(const ColumnProgram* program, int32_t* r, const int* const* inputs, \
+    int* const* outputs, size_t base, size_t valid) \
+{ \
+    uint64_t live = valid == COLUMN_BLOCK ? ~(uint64_t)0 : ((uint64_t)1 << valid) - 1; \
+    int i, j; \
+    for (i = 0; i < program->count; i++) { \
+        const VmInstruction* insn = &program->code[i]; \
+        int32_t* d = COLUMN_REGISTER(d); \
+        uint64_t fault = 0; \
+        V##_vec k = V##_set1(insn->b); \
+        V##_vec x, y, q; \
+        switch (insn->code.op) { \
+        case VM_INPUT: \
+            memcpy(d, inputs[insn->a] + base, valid * sizeof(int32_t)); \
+            memset(d + valid, 0, (COLUMN_BLOCK - valid) * sizeof(int32_t)); \
+            break; \
+        case VM_OUTPUT: \
+            memcpy(outputs[insn->b] + base, COLUMN_REGISTER(a), valid * sizeof(int32_t)); \
+            break; \
+        case VM_MOV: \
+            memmove(d, COLUMN_REGISTER(a), COLUMN_BLOCK * sizeof(int32_t)); \
+            break; \
+        case VM_MOVI: \
+            for (j = 0; j < COLUMN_BLOCK; j += lanes) V##_store(d + j, k); \
+            break; \
+        case VM_ADD: \
+            for (j = 0; j < COLUMN_BLOCK; j += lanes) \
+                V##_store(d + j, V##_add(V##_load(COLUMN_REGISTER(a) + j), V##_load(COLUMN_REGISTER(b) + j))); \
+            break; \
+        case VM_ADDI: \
+            for (j = 0; j < COLUMN_BLOCK; j += lanes) V##_store(d + j, V##_add(V##_load(COLUMN_REGISTER(a) + j), k)); \
+            break; \
+        case VM_SUB: \
+            for (j = 0; j < COLUMN_BLOCK; j += lanes) \
+                V##_store(d + j, V##_sub(V##_load(COLUMN_REGISTER(a) + j), V##_load(COLUMN_REGISTER(b) + j))); \
+            break; \
+        case VM_RSUBI: \
+            for (j = 0; j < COLUMN_BLOCK; j += lanes) V##_store(d + j, V##_sub(k, V##_load(COLUMN_REGISTER(a) + j))); \
+            break; \
+        case VM_MUL: \
+            for (j = 0; j < COLUMN_BLOCK; j += lanes) \
+                V##_store(d + j, V##_mul(V##_load(COLUMN_REGISTER(a) + j), V##_load(COLUMN_REGISTER(b) + j))); \
+            break; \
+        case VM_MULI: \
+            for (j = 0; j < COLUMN_BLOCK; j += lanes) V##_store(d + j, V##_mul(V##_load(COLUMN_REGISTER(a) + j), k)); \
+            break; \
+        case VM_DIV: \
+        case VM_MOD: \
+            for (j = 0; j < COLUMN_BLOCK; j += lanes) { \
+                x = V##_load(COLUMN_REGISTER(a) + j); \
+                y = V##_load(COLUMN_REGISTER(b) + j); \
+                fault |= (uint64_t)V##_divide_fault(x, y) << j; \
+                q = V##_div(x, y); \
+                V##_store(d + j, insn->code.op == VM_DIV ? q : V##_sub(x, V##_mul(q, y))); \
+            } \
+            break; \
+        case VM_RDIVI: \
+        case VM_RMODI: \
+            for (j = 0; j < COLUMN_BLOCK; j += lanes) { \
+                y = V##_load(COLUMN_REGISTER(a) + j); \
+                fault |= (uint64_t)V##_divide_fault(k, y) << j; \
+                q = V##_div(k, y); \
+                V##_store(d + j, insn->code.op == VM_RDIVI ? q : V##_sub(k, V##_mul(q, y))); \
+            } \
+            break; \
+        case VM_DIVI: \
+        case VM_MODI: \
+            /*  -1 ΪȡINT_MIN ƣΪ 0 */ \
+            for (j = 0; j < COLUMN_BLOCK; j += lanes) { \
+                x = V##_load(COLUMN_REGISTER(a) + j); \
+                q = insn->b == -1 ? V##_sub(V##_set1(0), x) : V##_div(x, k); \
+                V##_store(d + j, insn->code.op == VM_DIVI ? q : insn->b == -1 ? V##_set1(0) : V##_sub(x, V##_mul(q, k))); \
+            } \
+            break; \
+        case VM_ADD3: \
+            for (j = 0; j < COLUMN_BLOCK; j += lanes) \
+                V##_store(d + j, V##_add(V##_add(V##_load(COLUMN_REGISTER(a) + j), V##_load(COLUMN_REGISTER(b) + j)), \
+                                         V##_load(COLUMN_REGISTER(c) + j))); \
+            break; \
+        case VM_ADDI_ADD: \
+            for (j = 0; j < COLUMN_BLOCK; j += lanes) \
+                V##_store(d + j, V##_add(V##_add(V##_load(COLUMN_REGISTER(a) + j), k), V##_load(COLUMN_REGISTER(c) + j))); \
+            break; \
+        case VM_MULI_ADD: \
+            for (j = 0; j < COLUMN_BLOCK; j += lanes) \
+                V##_store(d + j, V##_add(V##_mul(V##_load(COLUMN_REGISTER(a) + j), k), V##_load(COLUMN_REGISTER(c) + j))); \
+            break; \
+        default: \
+            break; \
+        } \
+        if ((fault & live) != 0) return column_first_fault(fault & live); \
+    } \
+    return 0; \
+}
+
+#ifdef COLUMN_SIMD
+DEFINE_COLUMN_KERNEL(column_block_sse2, , sse2, 4)
+DEFINE_COLUMN_KERNEL(column_block_avx2, TARGET_AVX2, avx2, 8)
+#else
+DEFINE_COLUMN_KERNEL(column_block_scalar, , scalar, 1)
+#endif
+#undef COLUMN_REGISTER
+
+/* ʽֵļʱ룺AVX2  CPU ϰʽֽΪ룬ÿֽ 8 ¼ִһΣ
+   ʡȥָķѭɵں˰ System V Լ
+       uint64_t kernel(int32_t* r, const int* const* inputs, int* const* outputs, size_t base);
+   Ե base  COLUMN_BLOCK ¼ֵس 0 ļ¼λͼ
+   ¼໥ļ¼ֻõĽӰ¼˲㡣
+   Ĵ i ռ r[i * COLUMN_BLOCK ..]ռһĴŽ register_count ֮
+    column_program_evaluate ãȫ %rdi Ϊַڴ */
+#if defined(JIT_SUPPORTED) && defined(COLUMN_SIMD) && !defined(COLUMN_NO_JIT)
+#define COLUMN_JIT 1
+#endif
+
+#ifdef COLUMN_JIT
+typedef uint64_t (*ColumnJitKernel)(int32_t* r, const int* const* inputs, int* const* outputs, size_t base);
+
+/* ÿֽĻ */
+#define COLUMN_JIT_MAX_ENCODING 256
+
+/* ںʹõ ymm Ĵ0 Ϊ14 Ϊʱֵ1215 ڴ */
+enum {
+    YMM_INT_MIN = 12,       /* ÿԪΪ INT_MIN */
+    YMM_ZERO = 13,
+    YMM_ONES = 14,          /* ÿԪΪ -1 */
+    YMM_FAULT = 15          /*  8 ¼ĳλͼ */
+};
+
+/* VEX ǰ׺ 256 λ AVX2 ָW0pp Ϊǰ׺0ޣ1662F3map Ϊ
+   10F20F3830F3Aregvvvv Ϊ ymm ţrm Ϊ ymm Ĵڴ
+   ֽ VEX ʱ GNU as һֽʽ */
+static uint8_t* encode_vex(uint8_t* p, int pp, int map, uint8_t opcode, int reg, int vvvv, AsmOperand rm)
+{
+    int r = reg >= 8;
+    int x = rm.kind == AO_MEM && rm.index >= 8;
+    int b = rm.base >= 8;
+    uint8_t* rip_field = NULL;
+
+    if (map == 1 && !x && !b) {
+        *p++ = 0xC5;
+        *p++ = (uint8_t)((r ? 0 : 0x80) | (~vvvv & 15) << 3 | 4 | pp);
+    }
+    else {
+        *p++ = 0xC4;
+        *p++ = (uint8_t)((r ? 0 : 0x80) | (x ? 0 : 0x40) | (b ? 0 : 0x20) | map);
+        *p++ = (uint8_t)((~vvvv & 15) << 3 | 4 | pp);
+    }
+    *p++ = opcode;
+    return encode_modrm(p, reg, &rm, &rip_field);
+}
+
+/* ͨüĴָĿı */
+static uint8_t* encode_column_gp(uint8_t* p, AsmOpcode op, int size, AsmOperand src, AsmOperand dst)
+{
+    AsmInstruction insn;
+    size_t length = 0;
+    int relocation_count = 0;
+
+    memset(&insn, 0, sizeof(insn));
+    insn.op = (uint8_t)op;
+    insn.size = (uint8_t)size;
+    insn.src = src;
+    insn.dst = dst;
+    encode_instruction(&insn, p, &length, NULL, &relocation_count);
+    return p + length;
+}
+
+/* õ AVX2 ָʽ dst = src1 op src2src2 Ϊڴ */
+#define VEX_LOAD(p, ymm, m) encode_vex(p, 2, 1, 0x6F, ymm, 0, m)                /* vmovdqu m, ymm */
+#define VEX_STORE(p, m, ymm) encode_vex(p, 2, 1, 0x7F, ymm, 0, m)               /* vmovdqu ymm, m */
+#define VEX_OP(p, opcode, d, s1, s2) encode_vex(p, 1, 1, opcode, d, s1, s2)
+#define VPADDD 0xFE
+#define VPSUBD 0xFA
+#define VPAND 0xDB
+#define VPOR 0xEB
+#define VPXOR 0xEF
+#define VPCMPEQD 0x76
+#define VPMULLD(p, d, s1, s2) encode_vex(p, 1, 2, 0x40, d, s1, s2)
+
+/* Ĵ i ڱеλ */
+static AsmOperand column_slot(int32_t i, int half)
+{
+    return asm_mem(REG_RDI, i * COLUMN_BLOCK * (int32_t)sizeof(int32_t) + half * 16);
+}
+
+/* ضϳ %ymm0 = x / yxy ΪĴţ 4 ԪתΪ double ٽضϣ
+    avx2_div ͬcheck  0 ʱѳ 0INT_MIN / -1 Ԫزλͼ */
+static uint8_t* encode_column_divide(uint8_t* p, int32_t x, int32_t y, int check)
+{
+    if (check) {
+        p = VEX_LOAD(p, 1, column_slot(y, 0));
+        p = VEX_OP(p, VPCMPEQD, 2, 1, asm_reg(YMM_ZERO));
+        p = VEX_OP(p, VPCMPEQD, 3, 1, asm_reg(YMM_ONES));
+        p = VEX_OP(p, VPCMPEQD, 4, YMM_INT_MIN, column_slot(x, 0));
+        p = VEX_OP(p, VPAND, 3, 3, asm_reg(4));
+        p = VEX_OP(p, VPOR, 2, 2, asm_reg(3));
+        p = VEX_OP(p, VPOR, YMM_FAULT, YMM_FAULT, asm_reg(2));
+    }
+    p = encode_vex(p, 2, 1, 0xE6, 2, 0, column_slot(x, 0));         /* vcvtdq2pd */
+    p = encode_vex(p, 2, 1, 0xE6, 3, 0, column_slot(y, 0));
+    p = encode_vex(p, 1, 1, 0x5E, 2, 2, asm_reg(3));                /* vdivpd */
+    p = encode_vex(p, 1, 1, 0xE6, 2, 0, asm_reg(2));                /* vcvttpd2dq */
+    p = encode_vex(p, 2, 1, 0xE6, 4, 0, column_slot(x, 1));
+    p = encode_vex(p, 2, 1, 0xE6, 3, 0, column_slot(y, 1));
+    p = encode_vex(p, 1, 1, 0x5E, 4, 4, asm_reg(3));
+    p = encode_vex(p, 1, 1, 0xE6, 4, 0, asm_reg(4));
+    p = encode_vex(p, 1, 3, 0x38, 0, 2, asm_reg(4));                /* vinserti128 $1 */
+    *p++ = 1;
+    return p;
+}
+
+/* ȡģ %ymm0 = x - (x / y) * y%ymm0  */
+static uint8_t* encode_column_remainder(uint8_t* p, int32_t x, int32_t y)
+{
+    p = VPMULLD(p, 0, 0, column_slot(y, 0));
+    p = VEX_LOAD(p, 2, column_slot(x, 0));
+    return VEX_OP(p, VPSUBD, 0, 2, asm_reg(0));
+}
+
+/* ĴıţŶַɢУд泣± 1 */
+static int32_t column_constant(ColumnProgram* column, int32_t* table, int table_size, int32_t value)
+{
+    uint32_t h = ((uint32_t)value * 2654435761u) & (uint32_t)(table_size - 1);
+
+    while (table[h] != 0 && column->constants[table[h] - 1] != value) h = (h + 1) & (uint32_t)(table_size - 1);
+    if (table[h] == 0) {
+        column->constants[column->constant_count++] = value;
+        table[h] = column->constant_count;
+    }
+    return column->register_count + table[h] - 1;
+}
+
+/* ʽںˣдִֻڴ档CPU ֧ AVX2 ڴ治ʱ 0ʹÿ */
+static int column_jit_compile(ColumnProgram* column)
+{
+    size_t capacity = (size_t)column->count * COLUMN_JIT_MAX_ENCODING + 256;
+    uint8_t* code;
+    uint8_t* p;
+    uint8_t* loop;
+    uint8_t* memory;
+    int32_t* table;
+    int table_size = 16;
+    int32_t cached = -1;    /* %ymm0 ĸĴֵ-1 ʾ */
+    int i;
+
+    if (!cpu_has_avx2()) return 0;
+    while (table_size < column->count * 2) table_size *= 2;
+    code = (uint8_t*)malloc(capacity);
+    table = (int32_t*)calloc((size_t)table_size, sizeof(int32_t));
+    column->constants = (int32_t*)malloc(((size_t)column->count + 1) * sizeof(int32_t));
+    if (code == NULL || table == NULL || column->constants == NULL) {
+        free(code);
+        free(table);
+        free(column->constants);
+        column->constants = NULL;
+        return 0;
+    }
+
+    /* ڣĴλͼ㣬%rcx Ϊһ¼±꣬%r9 Ϊʣ */
+    p = code;
+    p = VEX_OP(p, VPCMPEQD, YMM_ONES, YMM_ONES, asm_reg(YMM_ONES));
+    p = VEX_OP(p, VPXOR, YMM_ZERO, YMM_ZERO, asm_reg(YMM_ZERO));
+    p = encode_vex(p, 1, 1, 0x72, 6, YMM_INT_MIN, asm_reg(YMM_ONES));     /* vpslld $31 */
+    *p++ = 31;
+    p = encode_column_gp(p, ASM_XOR, 4, asm_reg(REG_R8), asm_reg(REG_R8));
+    p = encode_column_gp(p, ASM_MOV, 4, asm_imm(COLUMN_BLOCK / 8), asm_reg(REG_R9));
+
+    loop = p;
+    p = VEX_OP(p, VPXOR, YMM_FAULT, YMM_FAULT, asm_reg(YMM_FAULT));
+    for (i = 0; i < column->count; i++) {
+        const VmInstruction* insn = &column->code[i];
+        int32_t k = 0;
+
+        switch (insn->code.op) {
+        case VM_MOVI: case VM_ADDI: case VM_RSUBI: case VM_MULI: case VM_DIVI: case VM_MODI:
+        case VM_RDIVI: case VM_RMODI: case VM_ADDI_ADD: case VM_MULI_ADD:
+            k = column_constant(column, table, table_size, insn->b);
+            break;
+        default:
+            break;
+        }
+
+        /* Ҫʱ r[a] װ %ymm0 */
+#define LOAD_A() do { if (cached != insn->a) p = VEX_LOAD(p, 0, column_slot(insn->a, 0)); } while (0)
+        switch (insn->code.op) {
+        case VM_INPUT:
+            p = encode_column_gp(p, ASM_MOV, 8, asm_mem(REG_RSI, insn->a * 8), asm_reg(REG_RAX));
+            p = VEX_LOAD(p, 0, asm_address(REG_RAX, REG_RCX, 4, 0));
+            break;
+        case VM_OUTPUT:
+            LOAD_A();
+            cached = insn->a;
+            p = encode_column_gp(p, ASM_MOV, 8, asm_mem(REG_RDX, insn->b * 8), asm_reg(REG_RAX));
+            p = VEX_STORE(p, asm_address(REG_RAX, REG_RCX, 4, 0), 0);
+            continue;
+        case VM_MOV:
+            LOAD_A();
+            break;
+        case VM_MOVI:
+            p = VEX_LOAD(p, 0, column_slot(k, 0));
+            break;
+        case VM_ADD:
+            LOAD_A();
+            p = VEX_OP(p, VPADDD, 0, 0, column_slot(insn->b, 0));
+            break;
+        case VM_ADDI:
+            LOAD_A();
+            p = VEX_OP(p, VPADDD, 0, 0, column_slot(k, 0));
+            break;
+        case VM_SUB:
+            LOAD_A();
+            p = VEX_OP(p, VPSUBD, 0, 0, column_slot(insn->b, 0));
+            break;
+        case VM_RSUBI:
+            p = VEX_LOAD(p, 0, column_slot(k, 0));
+            p = VEX_OP(p, VPSUBD, 0, 0, column_slot(insn->a, 0));
+            break;
+        case VM_MUL:
+            LOAD_A();
+            p = VPMULLD(p, 0, 0, column_slot(insn->b, 0));
+            break;
+        case VM_MULI:
+            LOAD_A();
+            p = VPMULLD(p, 0, 0, column_slot(k, 0));
+            break;
+        case VM_DIV:
+        case VM_MOD:
+            p = encode_column_divide(p, insn->a, insn->b, 1);
+            if (insn->code.op == VM_MOD) p = encode_column_remainder(p, insn->a, insn->b);
+            break;
+        case VM_RDIVI:
+        case VM_RMODI:
+            p = encode_column_divide(p, k, insn->a, 1);
+            if (insn->code.op == VM_RMODI) p = encode_column_remainder(p, k, insn->a);
+            break;
+        case VM_DIVI:
+        case VM_MODI:
+            /*  -1 ΪȡINT_MIN ƣΪ 0 */
+            if (insn->b == -1 && insn->code.op == VM_DIVI) {
+                p = VEX_OP(p, VPSUBD, 0, YMM_ZERO, column_slot(insn->a, 0));
+            }
+            else if (insn->b == -1) {
+                p = VEX_OP(p, VPXOR, 0, 0, asm_reg(0));
+            }
+            else {
+                p = encode_column_divide(p, insn->a, k, 0);
+                if (insn->code.op == VM_MODI) p = encode_column_remainder(p, insn->a, k);
+            }
+            break;
+        case VM_ADD3:
+            LOAD_A();
+            p = VEX_OP(p, VPADDD, 0, 0, column_slot(insn->b, 0));
+            p = VEX_OP(p, VPADDD, 0, 0, column_slot(insn->c, 0));
+            break;
+        case VM_ADDI_ADD:
+            LOAD_A();
+            p = VEX_OP(p, VPADDD, 0, 0, column_slot(k, 0));
+            p = VEX_OP(p, VPADDD, 0, 0, column_slot(insn->c, 0));
+            break;
+        case VM_MULI_ADD:
+            LOAD_A();
+            p = VPMULLD(p, 0, 0, column_slot(k, 0));
+            p = VEX_OP(p, VPADDD, 0, 0, column_slot(insn->c, 0));
+            break;
+        default:
+            continue;
+        }
+#undef LOAD_A
+        /*  %ymm0  */
+        p = VEX_STORE(p, column_slot(insn->d, 0), 0);
+        cached = insn->d;
+    }
+
+    /* ĳλͼ %r8 ĸ 8 λ8 ֮ g λڵ 8g λ */
+    p = encode_vex(p, 0, 1, 0x50, REG_RAX, 0, asm_reg(YMM_FAULT));       /* vmovmskps */
+    p = encode_column_gp(p, ASM_SHL, 8, asm_imm(56), asm_reg(REG_RAX));
+    p = encode_column_gp(p, ASM_SHR, 8, asm_imm(8), asm_reg(REG_R8));
+    p = encode_column_gp(p, ASM_ADD, 8, asm_reg(REG_RAX), asm_reg(REG_R8));
+    p = encode_column_gp(p, ASM_ADD, 8, asm_imm(32), asm_reg(REG_RDI));
+    p = encode_column_gp(p, ASM_ADD, 8, asm_imm(8), asm_reg(REG_RCX));
+    p = encode_column_gp(p, ASM_SUB, 4, asm_imm(1), asm_reg(REG_R9));
+    p = encode_column_gp(p, ASM_JNE, 8, asm_none(), asm_label(0));
+    put32(p - 4, (uint32_t)(0 - (int64_t)(p - loop)));
+    p = encode_column_gp(p, ASM_MOV, 8, asm_reg(REG_R8), asm_reg(REG_RAX));
+    *p++ = 0xC5;            /* vzeroupper */
+    *p++ = 0xF8;
+    *p++ = 0x77;
+    p = encode_column_gp(p, ASM_RET, 8, asm_none(), asm_none());
+    free(table);
+
+    /*  jit_execute ͬдٸΪִֻ */
+    column->machine_size = (size_t)(p - code);
+    memory = (uint8_t*)mmap(NULL, column->machine_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory != MAP_FAILED) {
+        memcpy(memory, code, column->machine_size);
+        if (mprotect(memory, column->machine_size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(memory, column->machine_size);
+            memory = MAP_FAILED;
+        }
+    }
+    free(code);
+    if (memory == MAP_FAILED) {
+        free(column->constants);
+        column->constants = NULL;
+        column->constant_count = 0;
+        return 0;
+    }
+    column->machine_code = memory;
+    return 1;
+}
+
+#undef VEX_LOAD
+#undef VEX_STORE
+#undef VEX_OP
+#undef VPMULLD
+#endif
+
+/* ׶ʾ echo ʱӡĻ */
+static void compile_progress(Compiler* compiler, const char* message)
+{
+    if (compiler->echo) {
+        printf("%s", message);
+    }
+}
+
+/* ǰ˸׶Σʷ﷨мŻ compiler ем룻
+   optimize_ir ɾָд result */
+static void compile_front(Compiler* compiler, const char* source, size_t length, const CompileOptions* options,
+    CompileResult* result)
+{
+    /* ʷֻѡ˶Ӧʱű */
+    compile_progress(compiler, "1. дʷ...\n");
+    lexer(compiler, source, length);
+    if (options->token_dump != NULL) {
+        compile_progress(compiler, "\nʷ:\n");
+        print_tokens(compiler, options->token_dump);
+    }
+
+    /* ﷨ */
+    compile_progress(compiler, "2. ﷨...\n");
+    parser(compiler);
+    if (options->ast_dump != NULL) {
+        compile_progress(compiler, "\n﷨:\n");
+        print_ast(compiler, options->ast_dump);
+    }
+
+    /* м */
+    compile_progress(compiler, "3. м...\n");
+    generate_ir(compiler);
+    if (options->ir_dump != NULL) {
+        compile_progress(compiler, "\nмɽ:\n");
+        print_ir(compiler, options->ir_dump, "мɽ (ַ)");
+    }
+    if (!options->no_optimize) {
+        result->ir_removed = optimize_ir(compiler);
+        if (options->ir_dump != NULL) {
+            dump_printf(compiler, options->ir_dump, "=== мŻ ===\n");
+            dump_printf(compiler, options->ir_dump, "۵봫: ɾ %d ָ\n", compiler->stats.folded);
+            dump_printf(compiler, options->ir_dump, "ֲֵ:      %d ظ\n", compiler->stats.reused);
+            dump_printf(compiler, options->ir_dump, "д:       ɾ %d ָ\n", compiler->stats.copies);
+            dump_printf(compiler, options->ir_dump, "ɾ:     ɾ %d ָ\n", compiler->stats.dead);
+            dump_printf(compiler, options->ir_dump, "ʱ:       %d -> %d\n\n",
+                compiler->stats.temps_before, compiler->stats.temps_after);
+            print_ir(compiler, options->ir_dump, "Żм");
+        }
+    }
+
+}
+
+/* ˸׶Σָѡ񡢼Ĵ䡢Ż compiler еĿָ */
+static void compile_back(Compiler* compiler, const CompileOptions* options)
+{
+    /* Ŀɣ-O0 ʱĴֵջ */
+    compile_progress(compiler, "4. ɻ...\n");
+    if (!options->no_optimize) {
+        build_expression_trees(compiler);
+        allocate_registers(compiler);
+        assign_stack_slots(compiler);
+        if (options->ir_dump != NULL) {
+            dump_printf(compiler, options->ir_dump, "=== Ĵ ===\n");
+            dump_printf(compiler, options->ir_dump, "Ծ: %d: %d\n",
+                compiler->regs.interval_count, compiler->regs.spilled);
+            dump_printf(compiler, options->ir_dump, "ջ: %dÿʱռʱ %d\n\n",
+                compiler->regs.stack_slots, compiler->var_count + compiler->temp_var_counter);
+        }
+    }
+    generate_assembly(compiler);
+    if (options->ir_dump != NULL) {
+        int tile;
+        dump_printf(compiler, options->ir_dump, "=== ָѡ ===\n");
+        dump_printf(compiler, options->ir_dump, "ʽ: ϲ %d ָ\n", compiler->tree_folded);
+        for (tile = 0; tile < TILE_COUNT; tile++) {
+            dump_printf(compiler, options->ir_dump, "%-12s%d\n", tile_name[tile], compiler->tile_counts[tile]);
+        }
+        dump_printf(compiler, options->ir_dump, "\n");
+    }
+    if (!options->no_optimize) {
+        int rule;
+        peephole_optimize(compiler, options->peephole_disabled);
+        if (options->ir_dump != NULL) {
+            dump_printf(compiler, options->ir_dump, "=== Ż ===\n");
+            for (rule = 0; rule < PEEPHOLE_RULE_COUNT; rule++) {
+                dump_printf(compiler, options->ir_dump, "%-12s%d%s\n", peephole_rule_name(rule),
+                    compiler->peephole_hits[rule], options->peephole_disabled & (1u << rule) ? "ѹرգ" : "");
+            }
+            dump_printf(compiler, options->ir_dump, "\n");
+        }
+    }
+}
+
+/* ѡʱʹõĬֵ */
+static const CompileOptions quiet_options = { NULL, NULL, NULL, 0, 0, 0, 0 };
+
+/* һԴ룺ڶϷ䣬״̬У */
+int compile_buffer(const char* source, size_t length, const CompileOptions* options, CompileResult* result)
+{
+    Compiler* compiler;
+
+    result->assembly = NULL;
+    result->assembly_length = 0;
+    result->error_count = 0;
+    result->arena_peak = 0;
+    result->ir_removed = 0;
+    result->frame_size = 0;
+    result->frame_size_unshared = 0;
+    memset(result->peephole_hits, 0, sizeof(result->peephole_hits));
+
+    compiler = (Compiler*)malloc(sizeof(Compiler));
+    if (compiler == NULL) {
+        fprintf(stderr, "ڴʧܣ\n");
+        result->error_count = 1;
+        return 1;
+    }
+    compiler_init(compiler);
+    if (options != NULL) {
+        compiler->echo = options->echo;
+    }
+    else {
+        options = &quiet_options;
+    }
+
+    compile_front(compiler, source, length, options, result);
+    compile_back(compiler, options);
+    if (options->object) {
+        write_object(compiler);
+    }
+    else {
+        write_assembly(compiler);
+    }
+
+    /* ֱֿתƣ漴ͷ */
+    result->assembly = compiler->output.head;
+    result->assembly_length = compiler->output.length;
+    memset(&compiler->output, 0, sizeof(compiler->output));
+    result->error_count = compiler->error_count;
+    result->arena_peak = compiler->arena.peak;
+    result->frame_size = compiler->frame_size;
+    result->frame_size_unshared = compiler->frame_size_unshared;
+    memcpy(result->peephole_hits, compiler->peephole_hits, sizeof(result->peephole_hits));
+
+    /* ﷨мڴһͷ */
+    compiler_free(compiler);
+    free(compiler);
+    return result->error_count == 0 ? 0 : 1;
+}
+
+/* 벢ڱִУɻıĿļֱָӱ뵽ִڴ */
+int compile_and_run(const char* source, size_t length, const CompileOptions* options, JitIo* io)
+{
+    CompileResult result;
+    Compiler* compiler;
+    int status = -1;
 
-                /* Դ2 */
-                if (is_temp_var(ir->src2)) {
-                    src2_var = get_temp_var_offset(compiler, ir->src2);
-                    emit_code(compiler, "    imull   -%d(%%rbp), %%eax\n", src2_var);
+    compiler = (Compiler*)malloc(sizeof(Compiler));
+    if (compiler == NULL) {
+        fprintf(stderr, "ڴʧܣ\n");
+        return -1;
+    }
+    compiler_init(compiler);
+    if (options != NULL) {
+        compiler->echo = options->echo;
+    }
+    else {
+        options = &quiet_options;
+    }
+
+    compile_front(compiler, source, length, options, &result);
+    compiler->check_division = 1;
+    compile_back(compiler, options);
+    if (compiler->error_count == 0) {
+        status = jit_execute(compiler, io);
+    }
+
+    compiler_free(compiler);
+    free(compiler);
+    return status;
+}
+
+/* Ϊֽ벢ִУֻǰˣĴָѡ죬ƽ̨޹ */
+int compile_and_interpret(const char* source, size_t length, const CompileOptions* options, JitIo* io)
+{
+    CompileResult result;
+    Compiler* compiler;
+    VmProgram program;
+    RunIo run;
+    int status = -1;
+
+    compiler = (Compiler*)malloc(sizeof(Compiler));
+    if (compiler == NULL) {
+        fprintf(stderr, "ڴʧܣ\n");
+        return -1;
+    }
+    compiler_init(compiler);
+    if (options != NULL) {
+        compiler->echo = options->echo;
+    }
+    else {
+        options = &quiet_options;
+    }
+
+    compile_front(compiler, source, length, options, &result);
+    compile_progress(compiler, "4. ֽ...\n");
+    if (compiler->error_count == 0 && vm_build(compiler, &program)) {
+        if (options->ir_dump != NULL) {
+            dump_printf(compiler, options->ir_dump, "=== ֽ ===\n");
+            dump_printf(compiler, options->ir_dump, "ָ: %dĴ: %dָ: %d\n\n",
+                program.count, program.register_count, program.fused);
+        }
+        resolve_io(io, &run);
+        status = vm_execute(compiler, &program, &run);
+        free(program.code);
+    }
+
+    compiler_free(compiler);
+    free(compiler);
+    return status;
+}
+
+/* ΪʽֻǰˣֽѹĴõбʱ NULL */
+ColumnProgram* column_program_compile(const char* source, size_t length, const CompileOptions* options)
+{
+    CompileResult result;
+    Compiler* compiler;
+    VmProgram program;
+    ColumnProgram* column = NULL;
+
+    compiler = (Compiler*)malloc(sizeof(Compiler));
+    if (compiler == NULL) {
+        fprintf(stderr, "ڴʧܣ\n");
+        return NULL;
+    }
+    compiler_init(compiler);
+    if (options != NULL) {
+        compiler->echo = options->echo;
+    }
+    else {
+        options = &quiet_options;
+    }
+
+    compile_front(compiler, source, length, options, &result);
+    compile_progress(compiler, "4. ʽֽ...\n");
+    if (compiler->error_count == 0 && vm_build(compiler, &program)) {
+        column = (ColumnProgram*)malloc(sizeof(ColumnProgram));
+        if (column == NULL) {
+            compile_error(compiler, "ڴʧܣʽ\n");
+            free(program.code);
+        }
+        else if (!column_compact(compiler, &program, column)) {
+            free(program.code);
+            free(column);
+            column = NULL;
+        }
+        else {
+            column->machine_code = NULL;
+            column->machine_size = 0;
+            column->constants = NULL;
+            column->constant_count = 0;
+#ifdef COLUMN_JIT
+            column_jit_compile(column);
+#endif
+            if (options->ir_dump != NULL) {
+                dump_printf(compiler, options->ir_dump, "=== ʽֽ ===\n");
+                dump_printf(compiler, options->ir_dump, "ָ: %dĴ: %d -> %dÿ %d: %d: %d\n",
+                    column->count, program.register_count, column->register_count, column->zero_count,
+                    column->input_count, column->output_count);
+                if (column->machine_code != NULL) {
+                    dump_printf(compiler, options->ir_dump, "AVX2 : %zu ֽڣĴ: %d\n\n",
+                        column->machine_size, column->constant_count);
                 }
                 else {
-                    src2_var = find_variable(compiler, ir->src2);
-                    if (src2_var != -1) {
-                        emit_code(compiler, "    imull   -%d(%%rbp), %%eax\n", compiler->vars[src2_var].offset);
-                    }
-                    else {
-                        /* ǳ */
-                        emit_code(compiler, "    imull   $%s, %%eax\n", ir->src2);
-                    }
+                    dump_printf(compiler, options->ir_dump, "\n\n");
                 }
+            }
+        }
+    }
+
+    compiler_free(compiler);
+    free(compiler);
+    return column;
+}
+
+/*  */
+int column_program_inputs(const ColumnProgram* program)
+{
+    return program->input_count;
+}
+
+/*  */
+int column_program_outputs(const ColumnProgram* program)
+{
+    return program->output_count;
+}
+
+#ifdef COLUMN_JIT
+/* üʱں˰ֵһļ¼Ƶ 0 ֵٸƻȥ
+    0 ļ¼ 0  */
+static int column_jit_evaluate(const ColumnProgram* program, int32_t* r, const int* const* inputs,
+    int* const* outputs, size_t count, size_t* fault)
+{
+    ColumnJitKernel kernel;
+    int32_t* constants = r + (size_t)program->register_count * COLUMN_BLOCK;
+    int columns = program->input_count + program->output_count;
+    int32_t* scratch = NULL;
+    int** tail = NULL;
+    size_t base;
+    int i, j;
+
+    *(void**)&kernel = program->machine_code;
+    for (i = 0; i < program->constant_count; i++) {
+        for (j = 0; j < COLUMN_BLOCK; j++) constants[(size_t)i * COLUMN_BLOCK + j] = program->constants[i];
+    }
+    if (count % COLUMN_BLOCK != 0) {
+        scratch = (int32_t*)calloc((size_t)columns * COLUMN_BLOCK + 1, sizeof(int32_t));
+        tail = (int**)malloc(((size_t)columns + 1) * sizeof(int*));
+        if (scratch == NULL || tail == NULL) {
+            free(scratch);
+            free(tail);
+            if (fault != NULL) *fault = count;
+            return -1;
+        }
+        for (i = 0; i < columns; i++) tail[i] = scratch + (size_t)i * COLUMN_BLOCK;
+    }
 
-                emit_code(compiler, "    movl    %%eax, -%d(%%rbp)  # %s = %s * %s\n",
-                    dest_var, ir->dest, ir->src1, ir->src2);
+    for (base = 0; base < count; base += COLUMN_BLOCK) {
+        size_t valid = count - base < COLUMN_BLOCK ? count - base : COLUMN_BLOCK;
+        uint64_t mask;
+
+        memset(r, 0, (size_t)program->zero_count * COLUMN_BLOCK * sizeof(int32_t));
+        if (valid == COLUMN_BLOCK) {
+            mask = kernel(r, inputs, outputs, base);
+        }
+        else {
+            for (i = 0; i < program->input_count; i++) memcpy(tail[i], inputs[i] + base, valid * sizeof(int32_t));
+            mask = kernel(r, (const int* const*)tail, tail + program->input_count, 0);
+            mask &= ((uint64_t)1 << valid) - 1;
+            for (i = 0; i < program->output_count; i++) {
+                memcpy(outputs[i] + base, tail[program->input_count + i], valid * sizeof(int32_t));
             }
+        }
+        if (mask != 0) {
+            if (fault != NULL) *fault = base + column_first_fault(mask) - 1;
             break;
         }
-        emit_code(compiler, "\n");
     }
+    free(scratch);
+    free(tail);
+    return base < count ? -1 : 0;
+}
+#endif
 
-    /* ӳ */
-    emit_code(compiler, "    # return 0\n");
-    emit_code(compiler, "    movl    $0, %%eax\n");
-    emit_code(compiler, "    leave\n");
-    emit_code(compiler, "    ret\n");
+/* ֵ count ¼мʱںʱʹںˣʱ CPU ֧ѡ AVX2 > SSE2 
+   ƽ̨Ϊʵ֣Ĵ鰴η䣬ֻڶ߳ͬʱֵ */
+int column_program_evaluate(const ColumnProgram* program, const int* const* inputs, int* const* outputs,
+    size_t count, size_t* fault)
+{
+    size_t (*kernel)(const ColumnProgram*, int32_t*, const int* const*, int* const*, size_t, size_t);
+    int32_t* r;
+    size_t base;
+
+#ifdef COLUMN_SIMD
+    kernel = cpu_has_avx2() ? column_block_avx2 : column_block_sse2;
+#else
+    kernel = column_block_scalar;
+#endif
+    r = (int32_t*)malloc(((size_t)program->register_count + (size_t)program->constant_count + 1)
+        * COLUMN_BLOCK * sizeof(int32_t));
+    if (r == NULL) {
+        if (fault != NULL) *fault = count;
+        return -1;
+    }
+#ifdef COLUMN_JIT
+    if (program->machine_code != NULL) {
+        int status = column_jit_evaluate(program, r, inputs, outputs, count, fault);
+        free(r);
+        return status;
+    }
+#endif
+
+    for (base = 0; base < count; base += COLUMN_BLOCK) {
+        size_t valid = count - base < COLUMN_BLOCK ? count - base : COLUMN_BLOCK;
+        size_t lane;
+        int status = 0;
+
+        /* ʱֻ¼֮ǰĲ֣õЩ¼ǰļ¼Ҳںָ
+           ظûдΪֹһγļǵһļ¼ */
+        for (;;) {
+            memset(r, 0, (size_t)program->zero_count * COLUMN_BLOCK * sizeof(int32_t));
+            lane = kernel(program, r, inputs, outputs, base, valid);
+            if (lane == 0) break;
+            if (fault != NULL) *fault = base + lane - 1;
+            valid = lane - 1;
+            status = -1;
+        }
+        if (status != 0) {
+            free(r);
+            return -1;
+        }
+    }
+    free(r);
+    return 0;
+}
+
+/* ͷʽ */
+void column_program_free(ColumnProgram* program)
+{
+    if (program == NULL) return;
+#ifdef COLUMN_JIT
+    if (program->machine_code != NULL) munmap(program->machine_code, program->machine_size);
+#endif
+    free(program->constants);
+    free(program->code);
+    free(program);
+}
+
+/* ĿļдļPOSIX ° writev ֱύֿ飬ƽ̨ fwrite */
+int compile_result_write(const CompileResult* result, FILE* file)
+{
+    const OutputChunk* chunk = result->assembly;
+
+    /* Ƚ FILE еݣ֤˳ */
+    if (fflush(file) != 0) return -1;
+
+#ifndef _WIN32
+    {
+        struct iovec iov[OUTPUT_IOV_BATCH];
+        size_t skip = 0;    /* ׿дֽ */
+        int fd = fileno(file);
+
+        while (chunk != NULL) {
+            const OutputChunk* current = chunk;
+            ssize_t written;
+            int count = 0;
+
+            for (; current != NULL && count < OUTPUT_IOV_BATCH; current = current->next) {
+                size_t offset = count == 0 ? skip : 0;
+                iov[count].iov_base = (char*)(current + 1) + offset;
+                iov[count].iov_len = current->used - offset;
+                count++;
+            }
+
+            written = writev(fd, iov, count);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return -1;
+            }
+
+            /* ʵдֽǰƣд */
+            while (chunk != NULL && (size_t)written >= chunk->used - skip) {
+                written -= (ssize_t)(chunk->used - skip);
+                skip = 0;
+                chunk = chunk->next;
+            }
+            if (chunk != NULL) {
+                skip += (size_t)written;
+            }
+        }
+    }
+#else
+    for (; chunk != NULL; chunk = chunk->next) {
+        if (fwrite(chunk + 1, 1, chunk->used, file) != chunk->used) return -1;
+    }
+#endif
+    return 0;
+}
+
+/* ͷű */
+void compile_result_free(CompileResult* result)
+{
+    output_chunks_free(result->assembly);
+    result->assembly = NULL;
+    result->assembly_length = 0;
+}
+
+#ifndef COMPILER_NO_MAIN
+/* 룺ÿ߳һ䣬ȡԼ߳βȡһ */
+typedef struct {
+    mtx_t lock;
+    int head;               /* һɱ̴߳ļ± */
+    int tail;               /* ĩβ */
+} WorkQueue;
+
+typedef struct {
+    char** files;
+    int file_count;
+    const char* output_dir; /* NULL ʾԴļ */
+    int dumps;              /* ҪDUMP_* λϣĬֻɻ */
+    int verbose;            /*  0 ʱļ */
+    int no_optimize;        /* -O0мŻ */
+    unsigned peephole_disabled; /* -PرյĿŻ */
+    int object;             /* -cֱĿļ */
+    int run;                /* -rڱУļ2 Ϊ -i ִֽ룬3 Ϊ -e ʽֵ */
+    WorkQueue* queues;
+    int worker_count;
+} BatchJob;
+
+typedef struct {
+    BatchJob* job;
+    int id;
+    int compiled;           /* ̱߳ɹļ */
+    int failed;             /* ߳ʧܵļ */
+    int stolen;             /* ߳ȡĴ */
+    long long peephole_hits[PEEPHOLE_RULE_COUNT];   /* ̸߳Żĸд */
+} BatchWorker;
+
+/* ģʽѡ */
+#define DUMP_TOKENS 1
+#define DUMP_AST 2
+#define DUMP_IR 4
+#define DUMP_BUFFER_SIZE (64 * 1024)
+
+/*  -d ŷָ tokensastir  all޷ʶ -1 */
+static int parse_dump_list(const char* list)
+{
+    int dumps = 0;
+
+    while (*list) {
+        size_t length = strcspn(list, ",");
+        if (length == 6 && strncmp(list, "tokens", 6) == 0) dumps |= DUMP_TOKENS;
+        else if (length == 3 && strncmp(list, "ast", 3) == 0) dumps |= DUMP_AST;
+        else if (length == 2 && strncmp(list, "ir", 2) == 0) dumps |= DUMP_IR;
+        else if (length == 3 && strncmp(list, "all", 3) == 0) dumps |= DUMP_TOKENS | DUMP_AST | DUMP_IR;
+        else return -1;
+        list += length;
+        if (*list == ',') list++;
+    }
+    return dumps;
+}
+
+/*  -P ŷָĿŻ allҪرյĹλͼ޷ʶ -1 */
+static long parse_peephole_list(const char* list)
+{
+    long disabled = 0;
+    int rule;
+
+    while (*list) {
+        size_t length = strcspn(list, ",");
+        if (length == 3 && strncmp(list, "all", 3) == 0) {
+            disabled |= (1L << PEEPHOLE_RULE_COUNT) - 1;
+        }
+        else {
+            for (rule = 0; rule < PEEPHOLE_RULE_COUNT; rule++) {
+                const char* name = peephole_rule_name(rule);
+                if (strlen(name) == length && strncmp(list, name, length) == 0) break;
+            }
+            if (rule == PEEPHOLE_RULE_COUNT) return -1;
+            disabled |= 1L << rule;
+        }
+        list += length;
+        if (*list == ',') list++;
+    }
+    return disabled;
+}
+
+/* һļļӺ׺ʹöĴ󻺳δѡʧܷ NULL */
+static FILE* open_dump(const BatchJob* job, int dump, const char* output, const char* suffix)
+{
+    char name[4096 + 16];
+    FILE* file;
+
+    if (!(job->dumps & dump)) return NULL;
+    sprintf_s(name, sizeof(name), "%s%s", output, suffix);
+    file = fopen(name, "w");
+    if (file == NULL) {
+        fprintf(stderr, ": ޷ %s\n", name);
+        return NULL;
+    }
+    setvbuf(file, NULL, _IOFBF, DUMP_BUFFER_SIZE);
+    return file;
+}
+
+/* ׷ļʱ */
+static int file_list_push(char*** files, int* count, int* capacity, const char* path)
+{
+    char* copy;
+
+    if (*count >= *capacity) {
+        int new_capacity = *capacity ? *capacity * 2 : 256;
+        char** grown = (char**)realloc(*files, (size_t)new_capacity * sizeof(char*));
+        if (grown == NULL) return 0;
+        *files = grown;
+        *capacity = new_capacity;
+    }
+    copy = (char*)malloc(strlen(path) + 1);
+    if (copy == NULL) return 0;
+    strcpy(copy, path);
+    (*files)[(*count)++] = copy;
+    return 1;
+}
+
+/* ļǷ .c β */
+static int has_c_extension(const char* name)
+{
+    size_t length = strlen(name);
+    return length > 2 && strcmp(name + length - 2, ".c") == 0;
+}
+
+/* ռвͨļֱӼ룬Ŀ¼չΪе .c ļݹ飩ʧܷ 0 */
+static int collect_sources(const char* path, char*** files, int* count, int* capacity)
+{
+    char full[4096];
+#ifdef _WIN32
+    struct _finddata_t entry;
+    intptr_t handle;
+    struct _stat info;
+
+    if (_stat(path, &info) != 0) return 0;
+    if (!(info.st_mode & _S_IFDIR)) {
+        return file_list_push(files, count, capacity, path);
+    }
+
+    sprintf_s(full, sizeof(full), "%s\\*.c", path);
+    handle = _findfirst(full, &entry);
+    if (handle == -1) return 1;
+    do {
+        if (!(entry.attrib & _A_SUBDIR)) {
+            sprintf_s(full, sizeof(full), "%s\\%s", path, entry.name);
+            if (!file_list_push(files, count, capacity, full)) {
+                _findclose(handle);
+                return 0;
+            }
+        }
+    } while (_findnext(handle, &entry) == 0);
+    _findclose(handle);
+#else
+    DIR* dir;
+    struct dirent* entry;
+    struct stat info;
+
+    if (stat(path, &info) != 0) return 0;
+    if (!S_ISDIR(info.st_mode)) {
+        return file_list_push(files, count, capacity, path);
+    }
+
+    dir = opendir(path);
+    if (dir == NULL) return 0;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!has_c_extension(entry->d_name)) continue;
+        sprintf_s(full, sizeof(full), "%s/%s", path, entry->d_name);
+        if (stat(full, &info) != 0 || !S_ISREG(info.st_mode)) continue;
+        if (!file_list_push(files, count, capacity, full)) {
+            closedir(dir);
+            return 0;
+        }
+    }
+    closedir(dir);
+#endif
+    return 1;
+}
+
+/* ļԴļ .c  .sĿļΪ .oָĿ¼ʱֻļ */
+static void batch_output_name(const char* input, const char* output_dir, int object, char* output, size_t size)
+{
+    const char* base = input;
+    const char* p;
+    size_t length;
+
+    if (output_dir != NULL) {
+        for (p = input; *p; p++) {
+            if (*p == '/' || *p == '\\') base = p + 1;
+        }
+        sprintf_s(output, size, "%s/%s", output_dir, base);
+    }
+    else {
+        sprintf_s(output, size, "%s", input);
+    }
+
+    length = strlen(output);
+    if (has_c_extension(output)) {
+        output[length - 1] = object ? 'o' : 's';
+    }
+    else if (length + 2 < size) {
+        strcat(output, object ? ".o" : ".s");
+    }
+}
+
+/* һļŻĸдۼӵ hitsɹ 1 */
+static int batch_compile_file(const BatchJob* job, const char* input, long long* hits)
+{
+    SourceView source;
+    CompileOptions options;
+    CompileResult result;
+    char output[4096];
+    FILE* file;
+    int ok;
+    int rule;
+
+    if (source_open(&source, input) != 0) {
+        fprintf(stderr, "ʧ: %s޷򿪣\n", input);
+        return 0;
+    }
+    batch_output_name(input, job->output_dir, job->object, output, sizeof(output));
+
+    /* ĬϲκѡеÿһдԵļ */
+    options.token_dump = open_dump(job, DUMP_TOKENS, output, ".tokens");
+    options.ast_dump = open_dump(job, DUMP_AST, output, ".ast");
+    options.ir_dump = open_dump(job, DUMP_IR, output, ".ir");
+    options.echo = 0;
+    options.no_optimize = job->no_optimize;
+    options.peephole_disabled = job->peephole_disabled;
+    options.object = job->object;
+    compile_buffer(source.data, source.length, &options, &result);
+    source_close(&source);
+    if (options.token_dump != NULL) fclose(options.token_dump);
+    if (options.ast_dump != NULL) fclose(options.ast_dump);
+    if (options.ir_dump != NULL) fclose(options.ir_dump);
+
+    if (result.error_count > 0) {
+        fprintf(stderr, "ʧ: %s%d \n", input, result.error_count);
+        compile_result_free(&result);
+        return 0;
+    }
+    for (rule = 0; rule < PEEPHOLE_RULE_COUNT; rule++) {
+        hits[rule] += result.peephole_hits[rule];
+    }
+
+    file = fopen(output, "wb");
+    ok = file != NULL && compile_result_write(&result, file) == 0;
+    if (file != NULL && fclose(file) != 0) ok = 0;
+    if (!ok) {
+        fprintf(stderr, "ʧ: %s޷д %s\n", input, output);
+    }
+    else if (job->verbose) {
+        printf("%s -> %s%zu ֽڣջ֡ %d -> %d ֽڣ\n", input, output, result.assembly_length,
+            result.frame_size_unshared, result.frame_size);
+    }
+    compile_result_free(&result);
+    return ok;
+}
+
+/* һļڱУֽ룩Ϊ׼ɹ 1 */
+static int batch_run_file(const BatchJob* job, const char* input)
+{
+    SourceView source;
+    CompileOptions options;
+    int status;
+
+    if (source_open(&source, input) != 0) {
+        fprintf(stderr, "ʧ: %s޷򿪣\n", input);
+        return 0;
+    }
+    options.token_dump = NULL;
+    options.ast_dump = NULL;
+    options.ir_dump = NULL;
+    options.echo = 0;
+    options.no_optimize = job->no_optimize;
+    options.peephole_disabled = job->peephole_disabled;
+    options.object = 0;
+    status = job->run == 2 ? compile_and_interpret(source.data, source.length, &options, NULL)
+        : compile_and_run(source.data, source.length, &options, NULL);
+    source_close(&source);
+    fflush(stdout);
+    if (status != 0) {
+        fprintf(stderr, "ʧ: %s޷У\n", input);
+        return 0;
+    }
+    return 1;
+}
+
+/* ֵһļӱ׼ȫÿ column_program_inputs Ϊһ¼һ
+   βԣתΪкһֵٰ¼¼гͬɹ 1 */
+static int batch_evaluate_file(const BatchJob* job, const char* input)
+{
+    SourceView source;
+    CompileOptions options;
+    ColumnProgram* program;
+    int* values = NULL;
+    size_t value_count = 0;
+    size_t value_capacity = 0;
+    int** columns;
+    int inputs, outputs, k;
+    size_t records, record, fault = 0;
+    int value, status;
+
+    if (source_open(&source, input) != 0) {
+        fprintf(stderr, "ʧ: %s޷򿪣\n", input);
+        return 0;
+    }
+    options.token_dump = NULL;
+    options.ast_dump = NULL;
+    options.ir_dump = NULL;
+    options.echo = 0;
+    options.no_optimize = job->no_optimize;
+    options.peephole_disabled = job->peephole_disabled;
+    options.object = 0;
+    program = column_program_compile(source.data, source.length, &options);
+    source_close(&source);
+    if (program == NULL) {
+        fprintf(stderr, "ʧ: %s޷룩\n", input);
+        return 0;
+    }
+    inputs = column_program_inputs(program);
+    outputs = column_program_outputs(program);
+
+    while (scanf("%d", &value) == 1) {
+        if (value_count == value_capacity) {
+            size_t capacity = value_capacity ? value_capacity * 2 : 4096;
+            int* grown = (int*)realloc(values, capacity * sizeof(int));
+            if (grown == NULL) break;
+            values = grown;
+            value_capacity = capacity;
+        }
+        values[value_count++] = value;
+    }
+    /* û input ĳֵһ */
+    records = inputs > 0 ? value_count / (size_t)inputs : 1;
+
+    columns = (int**)calloc((size_t)inputs + (size_t)outputs + 1, sizeof(int*));
+    status = columns != NULL ? 0 : -1;
+    for (k = 0; status == 0 && k < inputs + outputs; k++) {
+        columns[k] = (int*)malloc((records + 1) * sizeof(int));
+        if (columns[k] == NULL) status = -1;
+    }
+    if (status != 0) {
+        fprintf(stderr, "ڴʧܣ\n");
+    }
+    else {
+        for (record = 0; record < records; record++) {
+            for (k = 0; k < inputs; k++) {
+                columns[k][record] = values[record * (size_t)inputs + (size_t)k];
+            }
+        }
+        status = column_program_evaluate(program, (const int* const*)columns, columns + inputs, records, &fault);
+        for (record = 0; record < (status == 0 ? records : fault); record++) {
+            for (k = 0; k < outputs; k++) {
+                printf("%d\n", columns[inputs + k][record]);
+            }
+        }
+        fflush(stdout);
+        if (status != 0) {
+            fprintf(stderr, "ʧ: %s %zu ¼ 0 \n", input, fault + 1);
+        }
+    }
+
+    if (columns != NULL) {
+        for (k = 0; k < inputs + outputs; k++) free(columns[k]);
+        free(columns);
+    }
+    free(values);
+    column_program_free(program);
+    return status == 0;
+}
+
+/* ȡһȡԼͷٴ߳βȡһ룻ȫȡ귵 -1 */
+static int batch_next(BatchWorker* worker)
+{
+    BatchJob* job = worker->job;
+    WorkQueue* own = &job->queues[worker->id];
+    int index = -1;
+    int i;
+
+    mtx_lock(&own->lock);
+    if (own->head < own->tail) {
+        index = own->head++;
+    }
+    mtx_unlock(&own->lock);
+    if (index >= 0) return index;
+
+    for (i = 1; i < job->worker_count; i++) {
+        WorkQueue* victim = &job->queues[(worker->id + i) % job->worker_count];
+        int begin = 0;
+        int end = 0;
+
+        mtx_lock(&victim->lock);
+        if (victim->head < victim->tail) {
+            int half = (victim->tail - victim->head + 1) / 2;
+            end = victim->tail;
+            begin = end - half;
+            victim->tail = begin;
+        }
+        mtx_unlock(&victim->lock);
+
+        if (begin < end) {
+            /* һֱӴŽԼ乩ȡ */
+            mtx_lock(&own->lock);
+            own->head = begin + 1;
+            own->tail = end;
+            mtx_unlock(&own->lock);
+            worker->stolen++;
+            return begin;
+        }
+    }
+    return -1;
+}
+
+/* ߳ */
+static int batch_worker(void* arg)
+{
+    BatchWorker* worker = (BatchWorker*)arg;
+    int index;
+
+    while ((index = batch_next(worker)) >= 0) {
+        if (batch_compile_file(worker->job, worker->job->files[index], worker->peephole_hits)) {
+            worker->compiled++;
+        }
+        else {
+            worker->failed++;
+        }
+    }
+    return 0;
+}
+
+/* ߴ */
+static int cpu_count(void)
+{
+#ifdef _WIN32
+    const char* env = getenv("NUMBER_OF_PROCESSORS");
+    int count = env ? atoi(env) : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return count > 0 ? (int)count : 1;
+}
+
+/* ģʽиļĿ¼ؽ˳ */
+static int batch_main(int argc, char** argv)
+{
+    BatchJob job;
+    BatchWorker* workers;
+    thrd_t* threads;
+    struct timespec start;
+    struct timespec end;
+    char** files = NULL;
+    int file_count = 0;
+    int file_capacity = 0;
+    int worker_count = 0;
+    int compiled = 0;
+    int failed = 0;
+    int stolen = 0;
+    long long peephole_hits[PEEPHOLE_RULE_COUNT] = { 0 };
+    long disabled;
+    int rule;
+    int i;
+    double seconds;
+
+    job.output_dir = NULL;
+    job.dumps = 0;
+    job.verbose = 0;
+    job.no_optimize = 0;
+    job.peephole_disabled = 0;
+    job.object = 0;
+    job.run = 0;
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            worker_count = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            job.dumps = parse_dump_list(argv[++i]);
+            if (job.dumps < 0) {
+                fprintf(stderr, ": -d ֻ tokensastirallŷָ\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-v") == 0) {
+            job.verbose = 1;
+        }
+        else if (strcmp(argv[i], "-O0") == 0) {
+            job.no_optimize = 1;
+        }
+        else if (strcmp(argv[i], "-c") == 0) {
+            job.object = 1;
+        }
+        else if (strcmp(argv[i], "-r") == 0) {
+            job.run = 1;
+        }
+        else if (strcmp(argv[i], "-i") == 0) {
+            job.run = 2;
+        }
+        else if (strcmp(argv[i], "-e") == 0) {
+            job.run = 3;
+        }
+        else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc) {
+            disabled = parse_peephole_list(argv[++i]);
+            if (disabled < 0) {
+                fprintf(stderr, ": -P ֻ store-loadself-movezeroadd-zeromul-oneallŷָ\n");
+                return 1;
+            }
+            job.peephole_disabled = (unsigned)disabled;
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            job.output_dir = argv[++i];
+        }
+        else if (!collect_sources(argv[i], &files, &file_count, &file_capacity)) {
+            fprintf(stderr, ": ޷ȡ '%s'\n", argv[i]);
+            failed++;
+        }
+    }
+    if (file_count == 0) {
+        fprintf(stderr, "÷: %s [-j ߳] [-o Ŀ¼] [-d tokens,ast,ir|all] [-v] [-O0] [-c] [-r|-i|-e] [-P رյĿ׹] ԴļĿ¼...\n", argv[0]);
+        return 1;
+    }
+
+    /* -r-i-eļ˳Уñ׼ */
+    if (job.run) {
+        for (i = 0; i < file_count; i++) {
+            if (!(job.run == 3 ? batch_evaluate_file(&job, files[i]) : batch_run_file(&job, files[i]))) failed++;
+            free(files[i]);
+        }
+        free(files);
+        return failed == 0 ? 0 : 1;
+    }
+
+    if (worker_count <= 0) worker_count = cpu_count();
+    if (worker_count > file_count) worker_count = file_count;
+
+    job.files = files;
+    job.file_count = file_count;
+    job.worker_count = worker_count;
+    job.queues = (WorkQueue*)malloc((size_t)worker_count * sizeof(WorkQueue));
+    workers = (BatchWorker*)calloc((size_t)worker_count, sizeof(BatchWorker));
+    threads = (thrd_t*)malloc((size_t)worker_count * sizeof(thrd_t));
+    if (job.queues == NULL || workers == NULL || threads == NULL) {
+        fprintf(stderr, "ڴʧܣ̳߳\n");
+        return 1;
+    }
+
+    /* ļ±ƽֳ䣬ÿ߳һ */
+    for (i = 0; i < worker_count; i++) {
+        mtx_init(&job.queues[i].lock, mtx_plain);
+        job.queues[i].head = (int)((long long)file_count * i / worker_count);
+        job.queues[i].tail = (int)((long long)file_count * (i + 1) / worker_count);
+        workers[i].job = &job;
+        workers[i].id = i;
+    }
+
+    timespec_get(&start, TIME_UTC);
+    for (i = 1; i < worker_count; i++) {
+        if (thrd_create(&threads[i], batch_worker, &workers[i]) != thrd_success) {
+            fprintf(stderr, ": ޷߳\n");
+            return 1;
+        }
+    }
+    batch_worker(&workers[0]);  /* ߳ҲΪ߳ */
+    for (i = 1; i < worker_count; i++) {
+        thrd_join(threads[i], NULL);
+    }
+    timespec_get(&end, TIME_UTC);
+
+    for (i = 0; i < worker_count; i++) {
+        compiled += workers[i].compiled;
+        failed += workers[i].failed;
+        stolen += workers[i].stolen;
+        for (rule = 0; rule < PEEPHOLE_RULE_COUNT; rule++) {
+            peephole_hits[rule] += workers[i].peephole_hits[rule];
+        }
+        mtx_destroy(&job.queues[i].lock);
+    }
+    seconds = (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf(": %d ļɹ %dʧ %d\n", file_count, compiled, failed);
+    printf("߳: %dȡ: %dʱ %.3f 룬%.1f ļ/\n",
+        worker_count, stolen, seconds, seconds > 0 ? file_count / seconds : 0.0);
+    if (!job.no_optimize) {
+        printf("Ż:");
+        for (rule = 0; rule < PEEPHOLE_RULE_COUNT; rule++) {
+            printf(" %s %lld%s", peephole_rule_name(rule), peephole_hits[rule],
+                rule + 1 < PEEPHOLE_RULE_COUNT ? "" : "\n");
+        }
+    }
+
+    for (i = 0; i < file_count; i++) {
+        free(files[i]);
+    }
+    free(files);
+    free(job.queues);
+    free(workers);
+    free(threads);
+    return failed == 0 ? 0 : 1;
 }
 
-/*  */
-int main(void)
+/* ʱģʽ뽻˵ */
+int main(int argc, char** argv)
 {
-    FILE* input_file;
     FILE* output_file;
-    char source[MAX_CODE_LENGTH];
-    char buffer[MAX_LINE_LENGTH];
+    SourceView source;
     char input_filename[MAX_FILENAME_LENGTH];
     char output_filename[MAX_FILENAME_LENGTH];
-    static Compiler compiler;  /* ̬䣬Сջʹ */
+    CompileOptions options;
+    CompileResult result;
     int choice;
 
+    if (argc > 1) {
+        return batch_main(argc, argv);
+    }
+
     printf("=========================================\n");
     printf("       CԱ ()\n");
     printf("=========================================\n");
@@ -1210,95 +6868,62 @@ int main(void)
             continue;
         }
 
-        /* ȡԴļ */
-        input_file = fopen(input_filename, "r");
-        if (!input_file) {
+        /* ȡԴļֻӳ䣬ƣ */
+        if (source_open(&source, input_filename) != 0) {
             printf(": ޷ļ '%s'\n", input_filename);
             continue;
         }
 
-        memset(source, 0, sizeof(source));
-        while (fgets(buffer, sizeof(buffer), input_file)) {
-            size_t curr_len = strlen(source);
-            size_t buf_len = strlen(buffer);
-
-            if (curr_len + buf_len < MAX_CODE_LENGTH) {
-                strncat(source, buffer, MAX_CODE_LENGTH - curr_len - 1);
-            }
-            else {
-                /* ֻƴӻɵĲֹ֣Խ */
-                strncat(source, buffer, MAX_CODE_LENGTH - curr_len - 1);
-                source[MAX_CODE_LENGTH - 1] = '\0';
-                printf(": Դļ󣬲ݱض\n");
-                break;
-            }
-        }
-        source[MAX_CODE_LENGTH - 1] = '\0';
-        fclose(input_file);
-
         printf("\nڱļ: %s\n", input_filename);
 
-        /* ʼ */
-        compiler_init(&compiler);
-
-        /* ʷ */
-        printf("1. дʷ...\n");
-        lexer(&compiler, source);
-
-        /* ļ */
         output_file = fopen(output_filename, "w");
         if (!output_file) {
             printf(": ޷ļ '%s'\n", output_filename);
+            source_close(&source);
             continue;
         }
 
         /* дı */
         print_to_both(output_file, "ļ: %s -> %s\n\n", input_filename, output_filename);
-        print_to_both(output_file, "Դ:\n%s\n", source);
-        print_to_both(output_file, "----------------------------------------\n\n");
-
-        /* ʾʷ */
-        printf("\nʷ:\n");
-        print_tokens(&compiler, output_file);
-
-        /* ﷨ */
-        printf("2. ﷨...\n");
-        parser(&compiler);
-
-        /* ʾ﷨ */
-        printf("\n﷨:\n");
-        print_to_both(output_file, "=== ﷨ ===\n");
-        print_ast(compiler.ast_root, 0, output_file);
+        print_to_both(output_file, "Դ:\n");
+        write_to_both(output_file, source.data, source.length);
         print_to_both(output_file, "\n");
+        print_to_both(output_file, "----------------------------------------\n\n");
 
-        /* м */
-        printf("3. м...\n");
-        generate_ir(&compiler);
-
-        /* ʾм */
-        printf("\nмɽ:\n");
-        print_ir(&compiler, output_file);
-
-        /* Ŀ */
-        printf("4. ɻ...\n");
-        generate_assembly(&compiler);
+        /* 룬׶νдļʾ */
+        options.token_dump = output_file;
+        options.ast_dump = output_file;
+        options.ir_dump = output_file;
+        options.echo = 1;
+        options.no_optimize = 0;
+        options.peephole_disabled = 0;
+        options.object = 0;
+        compile_buffer(source.data, source.length, &options, &result);
 
         /* ʾ */
         printf("\nɽ:\n");
-        print_to_both(output_file, "%s", compiler.output);
+        print_to_both(output_file, "=== ջ ===\n");
+        compile_result_write(&result, stdout);
+        compile_result_write(&result, output_file);
 
         fclose(output_file);
 
-        printf("\nɹ\n");
+        if (result.error_count == 0) {
+            printf("\nɹ\n");
+        }
+        else {
+            printf("\nɣ %d \n", result.error_count);
+        }
         printf("ļ: %s\n", input_filename);
         printf("ļ: %s\n", output_filename);
         printf("ɣ\n");
 
-        /* ͷ﷨ */
-        if (compiler.ast_root) {
-            free_ast(compiler.ast_root);
-            compiler.ast_root = NULL;
-        }
+        printf("Żɾм: %d \n", result.ir_removed);
+        printf("ջ֡: %d ֽڣջ۹ǰ %d ֽڣ\n", result.frame_size, result.frame_size_unshared);
+        printf("ڴطֵ: %zu ֽ\n", result.arena_peak);
+
+        compile_result_free(&result);
+        source_close(&source);
 
         printf("\nس...");
         clear_input_buffer();
@@ -1306,3 +6931,4 @@ int main(void)
 
     return 0;
 }
+#endif
@@ -0,0 +1,107 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* ŻCompileOptions.peephole_disabled а 1u <<  ر */
+typedef enum {
+    PEEPHOLE_STORE_LOAD,    /* дջۺءд */
+    PEEPHOLE_SELF_MOVE,     /* Ĵ */
+    PEEPHOLE_ZERO,          /* movl $0, %r Ϊ xorl %r, %r */
+    PEEPHOLE_ADD_ZERO,      /* ӡ 0 */
+    PEEPHOLE_MUL_ONE,       /*  1 */
+    PEEPHOLE_RULE_COUNT
+} PeepholeRule;
+
+/* ѡ NULL ȼȫȡĬֵֻɻ롢κ */
+typedef struct {
+    FILE* token_dump;       /* ʷNULL ʾ */
+    FILE* ast_dump;         /* ﷨NULL ʾ */
+    FILE* ir_dump;          /* м룬NULL ʾ */
+    int echo;               /*  0 ʱѡͽ׶ʾͬʱӡ׼ */
+    int no_optimize;        /*  0 ʱмŻͿŻ */
+    unsigned peephole_disabled; /* رյĿŻλͼ0 ʾȫ */
+    int object;             /*  0 ʱֱ x86-64 ELF64 ضλĿļ.oɻı */
+} CompileOptions;
+
+/* Ŀļֿ飨ڱڲ */
+typedef struct OutputChunk OutputChunk;
+
+/*  */
+typedef struct {
+    OutputChunk* assembly;  /* ɵĻ루Ŀļֿ compile_result_write  */
+    size_t assembly_length; /* ֽ */
+    int error_count;        /* ʷ﷨ڴʧܵĴ */
+    size_t arena_peak;      /* ڴطֵֽ */
+    int ir_removed;         /* Żɾм */
+    int frame_size;         /* ջֽ֡ */
+    int frame_size_unshared;    /* ջ۹ǰÿʱռջۣջֽ֡ */
+    int peephole_hits[PEEPHOLE_RULE_COUNT]; /* Żĸд */
+} CompileResult;
+
+/* ʱִСִֽʱ inputoutput ȥ򡣻صΪ NULL ʱʹöӦĻ
+   ҲΪ NULL ʱʹñ׼롢׼ */
+typedef struct {
+    int (*input)(void* context, int* value);    /* һ *valueɹ 1ʧʱд *value */
+    void (*output)(void* context, int value);   /* һ */
+    void* context;          /* ԭص */
+    const int* input_values;    /* 뻺ζ input ı */
+    size_t input_count;
+    size_t input_used;      /* Ѷĸ */
+    int* output_values;     /* дֻ */
+    size_t output_capacity;
+    size_t output_count;    /* ĸ */
+} JitIo;
+
+/* Ż֣ -P ѡʹã */
+const char* peephole_rule_name(int rule);
+
+/* һԴ롣ÿεʹöĶϱģдȫ״̬
+   ڶ߳ͬʱásource Ҫ '\0' β
+   ɹ 0дʱط 0Իᾡ롣 */
+int compile_buffer(const char* source, size_t length, const CompileOptions* options, CompileResult* result);
+
+/* һԴ벢ڱֱִУд mmap ڴΪִֻУW^X
+   inputoutput  io ĻصҲ̡io Ϊ NULL ʱʹ
+   ׼롢׼سķֵ0бƽֻ̨֧֣֧ x86-64  POSIX
+   ƽ̨޷ִڴʱִг򣬷 -1ʱ 0  INT_MIN / -1 ʱִֹͣ
+    -1ʱĴ idivl ֮ǰ񵥶еĳ SIGFPE */
+int compile_and_run(const char* source, size_t length, const CompileOptions* options, JitIo* io);
+
+/* һԴΪĴʽֽ벢ýִУɻ룬κƽ̨ʹã
+    compile_and_run ͬ 0бʱ 0
+   еĳڴ˴Ӳ쳣ʱ -1 */
+int compile_and_interpret(const char* source, size_t length, const CompileOptions* options, JitIo* io);
+
+/* ʽ򣨶ڱڲѳе k  input  k С k  output 
+    k Уһ¼ֵ */
+typedef struct ColumnProgram ColumnProgram;
+
+/* һԴΪʽбʱ NULL */
+ColumnProgram* column_program_compile(const char* source, size_t length, const CompileOptions* options);
+
+/* Сеĸ */
+int column_program_inputs(const ColumnProgram* program);
+int column_program_outputs(const ColumnProgram* program);
+
+/*  count ¼ֵinputs[k][i] Ϊ i ¼ĵ k 룬д outputs[k][i]
+   δֵʹõıΪ 0Ϊ 32 λƣȡɵĻλͬ
+   ֧ AVX2  x86-64 POSIX ƽ̨ʹñʱɵĻ루ÿָ 8 ¼ x86-64
+   ƽ̨ CPU ֧ʹ AVX2  SSE2 Ŀֻڶ߳
+   ͬʱֵ 0м¼ 0 ʱ -1*faultΪ NULLΪһ
+   ¼±֮꣬ǰļ¼ȫֵ֮ȷڴ治ʱ -1*fault Ϊ count */
+int column_program_evaluate(const ColumnProgram* program, const int* const* inputs, int* const* outputs,
+    size_t count, size_t* fault);
+
+/* ͷʽprogram Ϊ NULL */
+void column_program_free(ColumnProgram* program);
+
+/* Ŀļд filePOSIX  writev һύֿ飩ɹ 0
+   ĿļԶƷʽ file */
+int compile_result_write(const CompileResult* result, FILE* file);
+
+/* ͷűеڴ */
+void compile_result_free(CompileResult* result);
+
+#endif
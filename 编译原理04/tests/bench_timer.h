@@ -0,0 +1,29 @@
+/* ׼Թõļʱ */
+#ifndef BENCH_TIMER_H
+#define BENCH_TIMER_H
+
+#ifdef _WIN32
+#include <windows.h>
+
+/* ʱӣλ */
+static double bench_now(void)
+{
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+#else
+#include <time.h>
+
+/* ʱӣλ */
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+#endif
+
+#endif
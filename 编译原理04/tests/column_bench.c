@@ -0,0 +1,109 @@
+/* ʽֵ׼ͬһֱüʱ AVX2 ں˺ͿAVX2  SSE2һ¼ֵ
+   ȡһΣÿ¼˶ߵͬ
+    ԭ04 Ŀ¼¹У
+       gcc -O2 -o column_bench tests/column_bench.c && ./column_bench [¼]
+   ¼Ĭ 4000000 */
+#define COMPILER_NO_MAIN
+#include "../001.c"
+#include "bench_timer.h"
+
+#define REPEAT 5
+
+static const char arithmetic_source[] =
+    "{\n"
+    "int a; int b; int c; int d; int e;\n"
+    "input(a); input(b);\n"
+    "c = a * 3 + b * 5 - 7;\n"
+    "d = (a + b) * (a - b) + c * 11;\n"
+    "e = d * d + c - a * b + 12345;\n"
+    "output(c); output(d); output(e);\n"
+    "}\n";
+
+static const char division_source[] =
+    "{\n"
+    "int a; int b; int c; int d; int e;\n"
+    "input(a); input(b);\n"
+    "c = a * 3 + b * 5 - 7;\n"
+    "d = c / 10 + a % 7 + (a + b) / b;\n"
+    "e = d * 13 - c % b + 1000 / b;\n"
+    "output(c); output(d); output(e);\n"
+    "}\n";
+
+/* ֵȡһΣÿ¼ */
+static double time_evaluate(const ColumnProgram* program, const int* const* inputs, int* const* outputs, size_t count)
+{
+    double best = 1e30;
+    int i;
+
+    for (i = 0; i < REPEAT; i++) {
+        double start = bench_now();
+        if (column_program_evaluate(program, inputs, outputs, count, NULL) != 0) return -1;
+        start = bench_now() - start;
+        if (start < best) best = start;
+    }
+    return best * 1e9 / (double)count;
+}
+
+static int run_workload(const char* title, const char* source, size_t count)
+{
+    ColumnProgram* program = column_program_compile(source, strlen(source), NULL);
+    int* inputs[2];
+    int* jit_outputs[3];
+    int* block_outputs[3];
+    uint8_t* machine_code;
+    double jit_time = -1, block_time;
+    int ok = 1;
+    size_t i;
+    int k;
+
+    if (program == NULL) return 0;
+    for (k = 0; k < 2; k++) {
+        inputs[k] = (int*)malloc(count * sizeof(int));
+        if (inputs[k] == NULL) return 0;
+        for (i = 0; i < count; i++) inputs[k][i] = (int)((i * 2654435761u + (size_t)k * 40503u) % 100000) + 1;
+    }
+    for (k = 0; k < 3; k++) {
+        jit_outputs[k] = (int*)malloc(count * sizeof(int));
+        block_outputs[k] = (int*)malloc(count * sizeof(int));
+        if (jit_outputs[k] == NULL || block_outputs[k] == NULL) return 0;
+    }
+
+    /* ʱȥ뼴õ */
+    machine_code = program->machine_code;
+    if (machine_code != NULL) jit_time = time_evaluate(program, (const int* const*)inputs, jit_outputs, count);
+    program->machine_code = NULL;
+    block_time = time_evaluate(program, (const int* const*)inputs, block_outputs, count);
+    program->machine_code = machine_code;
+
+    printf("%s%zu ¼\n", title, count);
+    if (machine_code != NULL) {
+        printf("  ʱ    %6.2f ns/¼  %.2fx\n", jit_time, block_time / jit_time);
+        for (k = 0; k < 3; k++) {
+            if (memcmp(jit_outputs[k], block_outputs[k], count * sizeof(int)) != 0) ok = 0;
+        }
+        if (!ok) printf("  һ\n");
+    }
+    else {
+        printf("  ʱ    ãҪ AVX2  x86-64 POSIX ƽ̨\n");
+    }
+    printf("      %6.2f ns/¼\n", block_time);
+
+    for (k = 0; k < 2; k++) free(inputs[k]);
+    for (k = 0; k < 3; k++) {
+        free(jit_outputs[k]);
+        free(block_outputs[k]);
+    }
+    column_program_free(program);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = argc > 1 ? (size_t)atol(argv[1]) : 4000000;
+    int ok;
+
+    printf("ȡ %d һ\n", REPEAT);
+    ok = run_workload("Ӽ", arithmetic_source, count);
+    ok = run_workload("ȡģ", division_source, count) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,310 @@
+/* ʽֵԣcolumn_program_evaluate Ľ¼ compile_and_interpret Ƚϡ
+   ¼ȡ 163651301003 ȷ 64 ĩβһļ¼ѡļ¼Ϸ
+   0-1INT_MIN -1 ͬʱ INT_MIN 鷵ֵ*fault Ϊִеһ
+   ¼Լǰ¼мʱںʱں˺Ϳֵһ顣
+   ʧܵļ¼ڱ׼ϴӡдԤڡ
+    ԭ04 Ŀ¼¹Уڶֻÿ
+       gcc -O2 -o column_test tests/column_test.c && ./column_test
+       gcc -O2 -DCOLUMN_NO_JIT -o column_test tests/column_test.c && ./column_test
+   ȫһʱ 0 */
+#define COMPILER_NO_MAIN
+#include "../001.c"
+
+#define MAX_COLUMNS 32
+#define MAX_VARIABLES 6
+#define MAX_STATEMENTS 20
+#define RANDOM_PROGRAMS 150
+
+static const size_t record_counts[] = { 1, 7, 63, 65, 130, 1003 };
+
+/*  abb Ϊ */
+static const char* const divide_sources[] = {
+    "{ int a; int b; int c; input(a); input(b); c = a / b; output(c); c = a % b; output(c); }",
+    "{ int a; int b; int c; input(a); input(b); c = 1000 / b + a % b; output(c); c = a * 3 + c; output(c); }",
+    "{ int a; int b; int c; int d; input(a); input(b); d = d + a; c = (a + b) * 5 - d / b; output(c); output(d); }",
+};
+
+static uint64_t random_state = 0x6A09E667F3BCC908ull;
+
+/* xorshift64 */
+static uint32_t next_random(void)
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return (uint32_t)random_state;
+}
+
+static int reported;
+static int fault_batches;   /* м¼ */
+
+/* ֵһ¼ִбȽϣزһµĴexpected_fault Ϊ (size_t)-1 ʱ
+   ִеһļ¼Ϊ expected_faultʱΪ countԷĳ */
+static int check_batch(const char* source, int* const* inputs, size_t count, size_t expected_fault)
+{
+    ColumnProgram* program = column_program_compile(source, strlen(source), NULL);
+    int* reference[MAX_COLUMNS];
+    int* outputs[MAX_COLUMNS];
+    uint8_t* machine_code;
+    size_t first_fault = count;
+    int input_count, output_count;
+    int failures = 0;
+    int engine;
+    size_t i;
+    int k;
+
+    if (program == NULL) {
+        printf("ʽʧܣ\n%s\n", source);
+        return 1;
+    }
+    input_count = column_program_inputs(program);
+    output_count = column_program_outputs(program);
+    for (k = 0; k < output_count; k++) {
+        reference[k] = (int*)malloc(count * sizeof(int));
+        outputs[k] = (int*)malloc(count * sizeof(int));
+        if (reference[k] == NULL || outputs[k] == NULL) return 1;
+    }
+
+    /* ִУһļ¼Ϊֹ֮ļ¼ȷ */
+    for (i = 0; i < count; i++) {
+        int record_inputs[MAX_COLUMNS];
+        int record_outputs[MAX_COLUMNS];
+        JitIo io;
+
+        for (k = 0; k < input_count; k++) record_inputs[k] = inputs[k][i];
+        memset(&io, 0, sizeof(io));
+        io.input_values = record_inputs;
+        io.input_count = (size_t)input_count;
+        io.output_values = record_outputs;
+        io.output_capacity = MAX_COLUMNS;
+        if (compile_and_interpret(source, strlen(source), NULL, &io) != 0) {
+            first_fault = i;
+            break;
+        }
+        for (k = 0; k < output_count; k++) reference[k][i] = record_outputs[k];
+    }
+    if (first_fault != count) fault_batches++;
+    if (expected_fault != (size_t)-1 && first_fault != expected_fault) {
+        printf("ִеһļ¼Ϊ %zuӦΪ %zu\n", first_fault, expected_fault);
+        failures++;
+    }
+
+    /* ںʱںˣʱȥÿ */
+    machine_code = program->machine_code;
+    for (engine = machine_code != NULL ? 0 : 1; engine < 2; engine++) {
+        const char* name = engine == 0 ? "ʱں" : "";
+        size_t fault = (size_t)-1;
+        int status;
+
+        program->machine_code = engine == 0 ? machine_code : NULL;
+        for (k = 0; k < output_count; k++) memset(outputs[k], 0x5A, count * sizeof(int));
+        status = column_program_evaluate(program, (const int* const*)inputs, outputs, count, &fault);
+        if (first_fault == count ? status != 0 : status != -1 || fault != first_fault) {
+            if (reported++ < 5) {
+                printf("%s%zu ¼ %d¼ %zuӦΪ %d%zu\n%s\n", name, count, status,
+                    status != 0 ? fault : count, first_fault == count ? 0 : -1, first_fault, source);
+            }
+            failures++;
+            continue;
+        }
+        for (i = 0; i < first_fault; i++) {
+            for (k = 0; k < output_count; k++) {
+                if (outputs[k][i] != reference[k][i]) break;
+            }
+            if (k < output_count) {
+                if (reported++ < 5) {
+                    printf("%s%zu ¼е %zu  %d Ϊ %dӦΪ %d\n%s\n", name, count, i, k,
+                        outputs[k][i], reference[k][i], source);
+                }
+                failures++;
+                break;
+            }
+        }
+    }
+    program->machine_code = machine_code;
+
+    for (k = 0; k < output_count; k++) {
+        free(reference[k]);
+        free(outputs[k]);
+    }
+    column_program_free(program);
+    return failures;
+}
+
+/* ѡ¼ϵĳ0-1 INT_MIN INT_MIN  -1ͨ */
+static void put_divisor(int* const* inputs, size_t record, int kind)
+{
+    switch (kind) {
+    case 0: inputs[1][record] = 0; break;
+    case 1: inputs[0][record] = INT32_MIN; inputs[1][record] = -1; break;
+    case 2: inputs[1][record] = INT32_MIN; break;
+    default: inputs[1][record] = -1; break;
+    }
+}
+
+/* ɲѡĳ */
+static int check_divisors(size_t* batches)
+{
+    int* inputs[2];
+    int failures = 0;
+    int s, c, k;
+
+    for (s = 0; s < (int)(sizeof(divide_sources) / sizeof(divide_sources[0])); s++) {
+        for (c = 0; c < (int)(sizeof(record_counts) / sizeof(record_counts[0])); c++) {
+            size_t count = record_counts[c];
+            size_t faults[] = { 0, 1, 62, 63, 64, 65, 127, 128, 500, count - 1 };
+            size_t i;
+            int f;
+
+            for (k = 0; k < 2; k++) {
+                inputs[k] = (int*)malloc(count * sizeof(int));
+                if (inputs[k] == NULL) return 1;
+            }
+
+            /* -1INT_MIN ֲڸ¼ */
+            for (i = 0; i < count; i++) {
+                inputs[0][i] = (int)next_random();
+                inputs[1][i] = (int)(next_random() % 2001) - 1000;
+                if (inputs[1][i] == 0) inputs[1][i] = 1;
+                if (i % 5 == 2) put_divisor(inputs, i, 2 + (int)(i / 5 % 2));
+                if (i % 11 == 3) inputs[0][i] = INT32_MIN;
+                if (inputs[0][i] == INT32_MIN && inputs[1][i] == -1) inputs[1][i] = INT32_MIN;
+            }
+            failures += check_batch(divide_sources[s], inputs, count, count);
+            (*batches)++;
+
+            /* ѡļ¼Ϸ 0  -1 ٷһ */
+            for (f = 0; f < (int)(sizeof(faults) / sizeof(faults[0])); f++) {
+                size_t record = faults[f];
+                int saved[2][2];
+                int kind = f % 2;
+
+                if (record >= count) continue;
+                for (k = 0; k < 2; k++) {
+                    saved[k][0] = inputs[k][record];
+                    saved[k][1] = record + 9 < count ? inputs[k][record + 9] : 0;
+                }
+                put_divisor(inputs, record, kind);
+                if (record + 9 < count) put_divisor(inputs, record + 9, 1 - kind);
+                failures += check_batch(divide_sources[s], inputs, count, record);
+                (*batches)++;
+                for (k = 0; k < 2; k++) {
+                    inputs[k][record] = saved[k][0];
+                    if (record + 9 < count) inputs[k][record + 9] = saved[k][1];
+                }
+            }
+            for (k = 0; k < 2; k++) free(inputs[k]);
+        }
+    }
+    return failures;
+}
+
+/* ֵȡ 01ֵּ¼˳ */
+static int random_value(void)
+{
+    static const int special[] = { 0, 1, -1, 2, 7, INT32_MIN, INT32_MAX, INT32_MIN + 1 };
+    uint32_t r = next_random() % 16;
+
+    if (r == 0) return special[next_random() % (sizeof(special) / sizeof(special[0]))];
+    if (r < 8) return (int)(next_random() % 2001) - 1000;
+    return (int)next_random();
+}
+
+/*  0 д (0 - n)INT_MIN д (0 - 2147483647 - 1) */
+static char* random_operand(char* p, int variables)
+{
+    static const int constants[] = { 1, -1, 2, 3, 5, 8, 10, 100, 65536, INT32_MAX, INT32_MIN };
+    int32_t c;
+
+    if (next_random() % 2 == 0) return p + sprintf(p, "v%u", next_random() % (unsigned)variables);
+    c = constants[next_random() % (sizeof(constants) / sizeof(constants[0]))];
+    if (c == INT32_MIN) return p + sprintf(p, "(0 - 2147483647 - 1)");
+    if (c < 0) return p + sprintf(p, "(0 - %d)", -c);
+    return p + sprintf(p, "%d", c);
+}
+
+static char* random_expression(char* p, int variables, int depth)
+{
+    static const char operators[] = "+-*/%+-*";
+
+    if (depth == 0 || next_random() % 4 == 0) return random_operand(p, variables);
+    *p++ = '(';
+    p = random_expression(p, variables, depth - 1);
+    p += sprintf(p, ") %c (", operators[next_random() % (sizeof(operators) - 1)]);
+    p = random_expression(p, variables, depth - 1);
+    *p++ = ')';
+    return p;
+}
+
+/* ȶȫִһֵinputoutputȫ */
+static void random_program(char* source)
+{
+    int variables = (int)(next_random() % MAX_VARIABLES) + 1;
+    int statements = (int)(next_random() % MAX_STATEMENTS) + 1;
+    int columns = variables * 2;
+    char* p = source;
+    int i;
+
+    p += sprintf(p, "{\n");
+    for (i = 0; i < variables; i++) p += sprintf(p, "int v%d;\ninput(v%d);\n", i, i);
+    for (i = 0; i < statements; i++) {
+        uint32_t kind = next_random() % 10;
+        int v = (int)(next_random() % (unsigned)variables);
+        if (kind < 7) {
+            p += sprintf(p, "v%d = ", v);
+            p = random_expression(p, variables, (int)(next_random() % 4));
+            p += sprintf(p, ";\n");
+        }
+        else if (kind < 9 && columns < MAX_COLUMNS) {
+            p += sprintf(p, "output(v%d);\n", v);
+            columns++;
+        }
+        else if (columns < MAX_COLUMNS) {
+            p += sprintf(p, "input(v%d);\n", v);
+            columns++;
+        }
+    }
+    for (i = 0; i < variables; i++) p += sprintf(p, "output(v%d);\n", i);
+    p += sprintf(p, "}\n");
+}
+
+static int check_random(size_t* batches)
+{
+    static char source[MAX_STATEMENTS * 512 + 1024];
+    int* inputs[MAX_COLUMNS];
+    int failures = 0;
+    int n, k;
+
+    for (n = 0; n < RANDOM_PROGRAMS; n++) {
+        size_t count = record_counts[n % (sizeof(record_counts) / sizeof(record_counts[0]))];
+        size_t i;
+
+        random_program(source);
+        for (k = 0; k < MAX_COLUMNS; k++) {
+            inputs[k] = (int*)malloc(count * sizeof(int));
+            if (inputs[k] == NULL) return 1;
+            for (i = 0; i < count; i++) inputs[k][i] = random_value();
+        }
+        failures += check_batch(source, inputs, count, (size_t)-1);
+        (*batches)++;
+        for (k = 0; k < MAX_COLUMNS; k++) free(inputs[k]);
+    }
+    return failures;
+}
+
+int main(void)
+{
+    const char* probe = "{ int a; input(a); a = a + 1; output(a); }";
+    ColumnProgram* program = column_program_compile(probe, strlen(probe), NULL);
+    size_t batches = 0;
+    int failures;
+
+    printf("ʽֵ%s\n", program != NULL && program->machine_code != NULL ?
+        "ʱں" : "");
+    column_program_free(program);
+
+    failures = check_divisors(&batches);
+    failures += check_random(&batches);
+    printf("%zu ¼ %d м¼һ %d\n", batches, fault_batches, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+/* ȡģ˷΢׼ͬһ x = x op d + c ֱԳħ˷
+   λ lea ķֽ⣩ʱĳidivlimullʱִС
+   ֻɴʱ䣺ڶһĻصصȡʱ䣬룻
+   ÿȡһΣÿ
+    ԭ04 Ŀ¼¹У
+       gcc -O2 -o divide_bench tests/divide_bench.c && ./divide_bench
+   ƽּ̨֧ʱʱ */
+#define COMPILER_NO_MAIN
+#include "../001.c"
+#include "bench_timer.h"
+
+#ifdef JIT_SUPPORTED
+#define CHAIN_LENGTH 4000
+#define REPEAT 30
+
+typedef struct {
+    const int* values;
+    int count;
+    int used;
+    double start;
+    double stop;
+} BenchIo;
+
+static int bench_input(void* context, int* value)
+{
+    BenchIo* io = (BenchIo*)context;
+    if (io->used >= io->count) return 0;
+    *value = io->values[io->used++];
+    if (io->used == io->count) io->start = bench_now();
+    return 1;
+}
+
+static void bench_output(void* context, int value)
+{
+    BenchIo* io = (BenchIo*)context;
+    io->stop = bench_now();
+    (void)value;
+}
+
+/* divisors еֵΪvariable Ϊʱ input  */
+static char* build_chain(char op, const int* divisors, int divisor_count, int variable, size_t* length)
+{
+    char* source = (char*)malloc((size_t)CHAIN_LENGTH * 48 + 1024);
+    char* p = source;
+    int i;
+
+    if (source == NULL) return NULL;
+    p += sprintf(p, "{\nint x;\n");
+    for (i = 0; i < divisor_count; i++) {
+        p += sprintf(p, "int d%d;\n", i);
+        if (variable) p += sprintf(p, "input(d%d);\n", i);
+    }
+    p += sprintf(p, "input(x);\n");
+    for (i = 0; i < CHAIN_LENGTH; i++) {
+        int d = divisors[i % divisor_count];
+        if (variable) p += sprintf(p, "x = x %c d%d + 1000003;\n", op, i % divisor_count);
+        else if (d < 0) p += sprintf(p, "x = x %c (0 - %d) + 1000003;\n", op, -d);
+        else p += sprintf(p, "x = x %c %d + 1000003;\n", op, d);
+    }
+    p += sprintf(p, "output(x);\n}\n");
+    *length = (size_t)(p - source);
+    return source;
+}
+
+/* αִȡһΣÿʧܷظ */
+static double time_chain(const char* source, size_t length, const int* inputs, int input_count)
+{
+    double best = 1e30;
+    int i;
+
+    for (i = 0; i < REPEAT; i++) {
+        BenchIo bench;
+        JitIo io;
+        memset(&io, 0, sizeof(io));
+        bench.values = inputs;
+        bench.count = input_count;
+        bench.used = 0;
+        io.input = bench_input;
+        io.output = bench_output;
+        io.context = &bench;
+        if (compile_and_run(source, length, NULL, &io) != 0) return -1;
+        if (bench.stop - bench.start < best) best = bench.stop - bench.start;
+    }
+    return best * 1e9 / CHAIN_LENGTH;
+}
+
+int main(void)
+{
+    static const int divisors[] = { 3, 7, 10, 641, -5, 1000, 16, 999983 };
+    static const char ops[] = { '/', '%', '*' };
+    static const char* const names[] = { "", "ȡģ", "˷" };
+    const int divisor_count = (int)(sizeof(divisors) / sizeof(divisors[0]));
+    /*  x ĳֵ汾ȶ */
+    int constant_inputs[1] = { 123456789 };
+    int variable_inputs[16];
+    int k, i;
+
+    for (i = 0; i < divisor_count; i++) variable_inputs[i] = divisors[i];
+    variable_inputs[divisor_count] = constant_inputs[0];
+    printf(" %d 㣬 3 7 10 641 -5 1000 16 999983 ȡ %d һ\n",
+        CHAIN_LENGTH, REPEAT);
+    printf("        (ns)  (ns)  ٱ\n");
+    for (k = 0; k < 3; k++) {
+        size_t constant_length = 0;
+        size_t variable_length = 0;
+        char* constant = build_chain(ops[k], divisors, divisor_count, 0, &constant_length);
+        char* variable = build_chain(ops[k], divisors, divisor_count, 1, &variable_length);
+        double constant_time, variable_time;
+
+        if (constant == NULL || variable == NULL) return 1;
+        constant_time = time_chain(constant, constant_length, constant_inputs, 1);
+        variable_time = time_chain(variable, variable_length, variable_inputs, divisor_count + 1);
+        if (constant_time < 0 || variable_time < 0) {
+            printf("ʱִʧ\n");
+            return 1;
+        }
+        printf("%s  %8.2f  %8.2f  %6.2fx\n", names[k], constant_time, variable_time, variable_time / constant_time);
+        free(constant);
+        free(variable);
+    }
+    return 0;
+}
+#else
+int main(void)
+{
+    printf("ƽּ̨֧ʱ룬\n");
+    return 0;
+}
+#endif
@@ -0,0 +1,196 @@
+/* ȡģ˷ԣһ[-1100, 1100] ȫ2^k  1
+   ֵֵ x / dx % dx * d ĳüʱִУħ˷
+   ˷λ lea ķֽ⣩ C  64 λȽϡ
+    01ֵڽֵֵ
+    ԭ04 Ŀ¼¹У
+       gcc -O2 -o divide_test tests/divide_test.c && ./divide_test
+   ȫһʱ 0ƽּ̨֧ʱ루 x86-64  POSIX ƽ̨ʱ */
+#define COMPILER_NO_MAIN
+#include "../001.c"
+
+#ifdef JIT_SUPPORTED
+#define CHUNK_DIVISORS 64   /* ÿеĳ */
+#define CHUNK_INPUTS 8      /* ÿжı */
+#define RANDOM_DIVIDENDS 160
+
+static uint64_t random_state = 0x2545F4914F6CDD1Dull;
+
+/* xorshift64 */
+static uint32_t next_random(void)
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return (uint32_t)random_state;
+}
+
+static int compare_int(const void* a, const void* b)
+{
+    int32_t x = *(const int32_t*)a;
+    int32_t y = *(const int32_t*)b;
+    return (x > y) - (x < y);
+}
+
+/* ȥأظ */
+static int build_divisors(int32_t* divisors)
+{
+    static const int32_t extra[] = { INT32_MAX, INT32_MIN, INT32_MIN + 1, 641, 6700417, 1000000007 };
+    int count = 0;
+    int unique = 0;
+    int i, k, e;
+
+    for (i = -1100; i <= 1100; i++) {
+        if (i != 0) divisors[count++] = i;
+    }
+    for (k = 1; k < 32; k++) {
+        for (e = -1; e <= 1; e++) {
+            int64_t v = ((int64_t)1 << k) + e;
+            if (v <= INT32_MAX) divisors[count++] = (int32_t)v;
+            if (-v >= INT32_MIN) divisors[count++] = (int32_t)-v;
+        }
+    }
+    for (i = 0; i < (int)(sizeof(extra) / sizeof(extra[0])); i++) divisors[count++] = extra[i];
+    for (i = 0; i < 300; i++) {
+        int32_t d = (int32_t)next_random();
+        divisors[count++] = d != 0 ? d : 1;
+    }
+
+    qsort(divisors, (size_t)count, sizeof(int32_t), compare_int);
+    for (i = 0; i < count; i++) {
+        if (unique == 0 || divisors[unique - 1] != divisors[i]) divisors[unique++] = divisors[i];
+    }
+    return unique;
+}
+
+/* Դеĳд (0 - n)INT_MIN д (0 - 2147483647 - 1)ɳ۵ԭ */
+static int format_constant(char* p, int32_t d)
+{
+    if (d >= 0) return sprintf(p, "%d", d);
+    if (d == INT32_MIN) return sprintf(p, "(0 - 2147483647 - 1)");
+    return sprintf(p, "(0 - %d)", -d);
+}
+
+/* һĳ򣺶 CHUNK_INPUTS ÿÿ̡ */
+static char* build_program(const int32_t* divisors, int count, size_t* length)
+{
+    char* source = (char*)malloc((size_t)count * CHUNK_INPUTS * 160 + 1024);
+    char* p = source;
+    char constant[32];
+    int i, k;
+
+    if (source == NULL) return NULL;
+    p += sprintf(p, "{\nint y;\n");
+    for (i = 0; i < CHUNK_INPUTS; i++) p += sprintf(p, "int x%d;\ninput(x%d);\n", i, i);
+    for (k = 0; k < count; k++) {
+        format_constant(constant, divisors[k]);
+        for (i = 0; i < CHUNK_INPUTS; i++) {
+            p += sprintf(p, "y = x%d / %s;\noutput(y);\n", i, constant);
+            p += sprintf(p, "y = x%d %% %s;\noutput(y);\n", i, constant);
+            p += sprintf(p, "y = x%d * %s;\noutput(y);\n", i, constant);
+        }
+    }
+    p += sprintf(p, "}\n");
+    *length = (size_t)(p - source);
+    return source;
+}
+
+/* һõıֵ߽ڽֵֵ */
+static int build_dividends(const int32_t* divisors, int count, int32_t* dividends)
+{
+    static const int32_t edges[] = { 0, 1, -1, 2, -2, 3, -3, 7, -7, 100, -100,
+        INT32_MAX, INT32_MIN, INT32_MAX - 1, INT32_MIN + 1, 1 << 30, -(1 << 30) };
+    int n = 0;
+    int i;
+
+    for (i = 0; i < (int)(sizeof(edges) / sizeof(edges[0])); i++) dividends[n++] = edges[i];
+    for (i = 0; i < count; i++) {
+        int64_t d = divisors[i];
+        int64_t q = (int64_t)INT32_MAX / (d < 0 ? -d : d);
+        int64_t m = d * (int64_t)(next_random() % (uint32_t)(q + 1));
+        int e;
+        if (next_random() % 2) m = -m;
+        for (e = -1; e <= 1; e++) {
+            if (m + e >= INT32_MIN && m + e <= INT32_MAX) dividends[n++] = (int32_t)(m + e);
+        }
+    }
+    for (i = 0; i < RANDOM_DIVIDENDS; i++) dividends[n++] = (int32_t)next_random();
+    while (n % CHUNK_INPUTS != 0) dividends[n++] = 0;
+    return n;
+}
+
+static int reported;
+
+/* һеزһµĸINT_MIN / -1 ʱԼΪ INT_MIN 0 */
+static int check_outputs(const int32_t* divisors, int count, const int32_t* x, const int* outputs)
+{
+    int failures = 0;
+    int i, k;
+
+    for (k = 0; k < count; k++) {
+        int64_t d = divisors[k];
+        for (i = 0; i < CHUNK_INPUTS; i++) {
+            const int* got = outputs + ((size_t)k * CHUNK_INPUTS + (size_t)i) * 3;
+            int64_t q = (int64_t)x[i] / d;
+            int64_t r = (int64_t)x[i] % d;
+            int32_t product = (int32_t)((uint32_t)x[i] * (uint32_t)d);
+            if (q > INT32_MAX) q = INT32_MIN;
+            if (got[0] != (int32_t)q || got[1] != (int32_t)r || got[2] != product) {
+                if (reported++ < 5) {
+                    printf("һ£%d  %d %dӦΪ %d %dӦΪ %d %dӦΪ %d\n",
+                        x[i], (int32_t)d, got[0], (int32_t)q, got[1], (int32_t)r, got[2], product);
+                }
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+int main(void)
+{
+    static int32_t divisors[8192];
+    static int32_t dividends[8192];
+    static int outputs[CHUNK_DIVISORS * CHUNK_INPUTS * 3];
+    int divisor_count = build_divisors(divisors);
+    long checked = 0;
+    int failures = 0;
+    int base;
+
+    for (base = 0; base < divisor_count; base += CHUNK_DIVISORS) {
+        int count = divisor_count - base < CHUNK_DIVISORS ? divisor_count - base : CHUNK_DIVISORS;
+        size_t length = 0;
+        char* source = build_program(divisors + base, count, &length);
+        int dividend_count = build_dividends(divisors + base, count, dividends);
+        int i;
+
+        if (source == NULL) return 1;
+        for (i = 0; i < dividend_count; i += CHUNK_INPUTS) {
+            JitIo io;
+            int status;
+            memset(&io, 0, sizeof(io));
+            io.input_values = (const int*)dividends + i;
+            io.input_count = CHUNK_INPUTS;
+            io.output_values = outputs;
+            io.output_capacity = sizeof(outputs) / sizeof(outputs[0]);
+            status = compile_and_run(source, length, NULL, &io);
+            if (status != 0 || io.output_count != (size_t)count * CHUNK_INPUTS * 3) {
+                printf("ʧܣ %d һ\n", divisors[base]);
+                failures++;
+                continue;
+            }
+            failures += check_outputs(divisors + base, count, dividends + i, outputs);
+            checked += (long)count * CHUNK_INPUTS;
+        }
+        free(source);
+    }
+
+    printf("%d %ld  (, )һ %d\n", divisor_count, checked, failures);
+    return failures == 0 ? 0 : 1;
+}
+#else
+int main(void)
+{
+    printf("ƽּ̨֧ʱ룬\n");
+    return 0;
+}
+#endif
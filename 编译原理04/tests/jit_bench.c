@@ -0,0 +1,168 @@
+/* ʱִеӳٻ׼ͬһֱ𾭹
+     1. compile_and_runڱ롢ִУ
+     2. compile_and_interpretִֽУ
+     3. compile_buffer ɻ룬cc ӣɵĳ
+     4. compile_buffer ֱĿļcc ӣɵĳ
+   Դ뵽õȫʱȡһΣ˶Ը·ͬ
+   34 Ҫ POSIX  system  C  CCĬ ccڵǰĿ¼дʱļ
+    ԭ04 Ŀ¼¹У
+       gcc -O2 -o jit_bench tests/jit_bench.c && ./jit_bench [] */
+#define COMPILER_NO_MAIN
+#include "../001.c"
+#include "bench_timer.h"
+
+#define VARIABLES 8
+#define OUTPUT_CAPACITY 64
+#define FAST_REPEAT 50
+#define SLOW_REPEAT 5
+
+static const int bench_inputs[VARIABLES] = { 3, -7, 11, 100, 65536, -1, 42, 9 };
+
+/* ɳ򣺶ȫִ statements ֵȫ */
+static char* generate_program(int statements, size_t* length)
+{
+    char* source = (char*)malloc((size_t)statements * 64 + 1024);
+    char* p = source;
+    unsigned seed = 7;
+    int i;
+
+    if (source == NULL) return NULL;
+    p += sprintf(p, "{\n");
+    for (i = 0; i < VARIABLES; i++) p += sprintf(p, "int v%d;\ninput(v%d);\n", i, i);
+    for (i = 0; i < statements; i++) {
+        seed = seed * 1103515245u + 12345u;
+        p += sprintf(p, "v%u = v%u * %u + v%u / %u - v%u;\n", (seed >> 4) % VARIABLES, (seed >> 8) % VARIABLES,
+            (seed >> 12) % 50, (seed >> 16) % VARIABLES, (seed >> 20) % 50 + 1, (seed >> 24) % VARIABLES);
+    }
+    for (i = 0; i < VARIABLES; i++) p += sprintf(p, "output(v%d);\n", i);
+    p += sprintf(p, "}\n");
+    *length = (size_t)(p - source);
+    return source;
+}
+
+/* ڵ·һεʧܷظ */
+static double time_in_process(const char* source, size_t length, int interpret, int* outputs)
+{
+    double best = 1e30;
+    int i;
+
+    for (i = 0; i < FAST_REPEAT; i++) {
+        JitIo io;
+        double start = bench_now();
+        int status;
+        memset(&io, 0, sizeof(io));
+        io.input_values = bench_inputs;
+        io.input_count = VARIABLES;
+        io.output_values = outputs;
+        io.output_capacity = OUTPUT_CAPACITY;
+        status = interpret ? compile_and_interpret(source, length, NULL, &io) : compile_and_run(source, length, NULL, &io);
+        start = bench_now() - start;
+        if (status != 0 || io.output_count != VARIABLES) return -1;
+        if (start < best) best = start;
+    }
+    return best;
+}
+
+#ifndef _WIN32
+/* ⲿ·дĿļӡУ outputs */
+static double time_toolchain(const char* source, size_t length, int object, int* outputs)
+{
+    const char* cc = getenv("CC") != NULL ? getenv("CC") : "cc";
+    const char* output_name = object ? "jit_bench_tmp.o" : "jit_bench_tmp.s";
+    char command[512];
+    double best = 1e30;
+    FILE* file;
+    int i, k;
+
+    file = fopen("jit_bench_tmp.in", "w");
+    if (file == NULL) return -1;
+    for (k = 0; k < VARIABLES; k++) fprintf(file, "%d\n", bench_inputs[k]);
+    fclose(file);
+    snprintf(command, sizeof(command), "%s -o jit_bench_tmp %s && ./jit_bench_tmp < jit_bench_tmp.in > jit_bench_tmp.out",
+        cc, output_name);
+
+    for (i = 0; i < SLOW_REPEAT; i++) {
+        CompileOptions options = { NULL, NULL, NULL, 0, 0, 0, 0 };
+        CompileResult result;
+        double start = bench_now();
+        int status;
+
+        options.object = object;
+        status = compile_buffer(source, length, &options, &result);
+        file = fopen(output_name, "wb");
+        if (file == NULL) status = -1;
+        else {
+            if (status == 0) status = compile_result_write(&result, file);
+            fclose(file);
+        }
+        compile_result_free(&result);
+        if (status != 0 || system(command) != 0) return -1;
+        start = bench_now() - start;
+        if (start < best) best = start;
+    }
+
+    file = fopen("jit_bench_tmp.out", "r");
+    if (file == NULL) return -1;
+    for (k = 0; k < VARIABLES; k++) {
+        if (fscanf(file, "%d", &outputs[k]) != 1) best = -1;
+    }
+    fclose(file);
+    remove("jit_bench_tmp.in");
+    remove("jit_bench_tmp.out");
+    remove("jit_bench_tmp");
+    remove(output_name);
+    return best;
+}
+#endif
+
+static int run_workload(const char* title, const char* source, size_t length)
+{
+    static const char* const names[] = { "compile_and_run", "compile_and_interpret", " + cc", "Ŀļ + cc" };
+    int outputs[4][OUTPUT_CAPACITY];
+    double seconds[4];
+    int path_count = 2;
+    int ok = 1;
+    int k;
+
+    seconds[0] = time_in_process(source, length, 0, outputs[0]);
+    seconds[1] = time_in_process(source, length, 1, outputs[1]);
+#ifndef _WIN32
+    seconds[2] = time_toolchain(source, length, 0, outputs[2]);
+    seconds[3] = time_toolchain(source, length, 1, outputs[3]);
+    path_count = 4;
+#endif
+
+    printf("%s\n", title);
+    for (k = 0; k < path_count; k++) {
+        if (seconds[k] < 0) {
+            printf("  %-22s \n", names[k]);
+            continue;
+        }
+        printf("  %-22s %10.3f ms  %8.1fx\n", names[k], seconds[k] * 1e3, seconds[0] > 0 ? seconds[k] / seconds[0] : 0);
+        if (k > 0 && seconds[0] > 0 && memcmp(outputs[0], outputs[k], VARIABLES * sizeof(int)) != 0) {
+            printf("  %s  compile_and_run һ\n", names[k]);
+            ok = 0;
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    int statements = argc > 1 ? atoi(argv[1]) : 1000;
+    size_t length;
+    char* small = generate_program(4, &length);
+    size_t large_length;
+    char* large = generate_program(statements, &large_length);
+    char title[64];
+    int ok;
+
+    if (small == NULL || large == NULL) return 1;
+    printf("ȡ %d Ρⲿȡ %d һΣʱ compile_and_run\n", FAST_REPEAT, SLOW_REPEAT);
+    ok = run_workload("4 ", small, length);
+    snprintf(title, sizeof(title), "%d ", statements);
+    ok = run_workload(title, large, large_length) && ok;
+    free(small);
+    free(large);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,191 @@
+/* ʷ׼ͬһɵԴֱøдǰȽϵĴʷ
+    DFA ıSSE2AVX2 ʵʷÿȡһΣÿ MB/s
+   Դ룺̱ʶĵͳԼʶĳ
+    ԭ04 Ŀ¼¹У
+       gcc -O2 -o lexer_bench tests/lexer_bench.c && ./lexer_bench []
+   Ĭ 200000 */
+#define COMPILER_NO_MAIN
+#include "../001.c"
+#include "bench_timer.h"
+
+#define REPEAT 10
+
+typedef void (*LexerFunc)(Compiler* compiler, const char* source, size_t length);
+
+/* ں˵Ĵʷx86-64  001.c ֻʵ SIMD ݣ */
+static void lexer_reference(Compiler* compiler, const char* source, size_t length)
+{
+    lexer_run(compiler, source, length, skip_space_scalar, scan_ident_scalar, scan_digits_scalar);
+}
+
+/* ж [pos, end) ǷԹؼֿͷҹؼֺĸ */
+static int match_keyword(const char* pos, const char* end, const char* keyword, size_t len)
+{
+    return (size_t)(end - pos) >= len &&
+        memcmp(pos, keyword, len) == 0 &&
+        (pos + len == end || !isalnum((unsigned char)pos[len]));
+}
+
+/* дΪ DFA ֮ǰĴʷÿλαȽϹؼֺ͸ַǡ
+   дͬһֻȽϷĿ */
+static void lexer_cascade(Compiler* compiler, const char* source, size_t length)
+{
+    static const char punct[] = "{}();=+-*/%";
+    static const TokenType punct_types[] = { TOKEN_LBRACE, TOKEN_RBRACE, TOKEN_LPAREN, TOKEN_RPAREN,
+        TOKEN_SEMICOLON, TOKEN_ASSIGN, TOKEN_PLUS, TOKEN_MINUS, TOKEN_MULTIPLY, TOKEN_DIVIDE, TOKEN_MODULO };
+    TokenStream* stream = &compiler->tokens;
+    const char* pos = source;
+    const char* end = source + length;
+    const char* start;
+    TokenType type;
+    int i;
+
+    token_stream_push_line(stream, 0);
+    while (pos < end) {
+        if (*pos == '\n') {
+            pos++;
+            token_stream_push_line(stream, (size_t)(pos - source));
+            continue;
+        }
+        if (*pos == ' ' || *pos == '\t' || *pos == '\r') {
+            pos++;
+            continue;
+        }
+
+        start = pos;
+        if (match_keyword(pos, end, "int", 3)) {
+            type = TOKEN_INT;
+            pos += 3;
+        }
+        else if (match_keyword(pos, end, "input", 5)) {
+            type = TOKEN_INPUT;
+            pos += 5;
+        }
+        else if (match_keyword(pos, end, "output", 6)) {
+            type = TOKEN_OUTPUT;
+            pos += 6;
+        }
+        else if (isalpha((unsigned char)*pos)) {
+            type = TOKEN_IDENTIFIER;
+            while (pos < end && isalnum((unsigned char)*pos)) pos++;
+        }
+        else if (isdigit((unsigned char)*pos)) {
+            type = TOKEN_NUMBER;
+            while (pos < end && isdigit((unsigned char)*pos)) pos++;
+        }
+        else {
+            for (i = 0; punct[i] != '\0' && punct[i] != *pos; i++);
+            if (punct[i] == '\0') {
+                /* δַ֪ */
+                pos++;
+                continue;
+            }
+            type = punct_types[i];
+            pos++;
+        }
+        token_stream_push(stream, type, (size_t)(start - source), (size_t)(pos - start));
+    }
+    token_stream_push(stream, TOKEN_EOF, length, 0);
+}
+
+/* Գͬ״Դ룻wide Ϊʱʶ 30 ַ 16  */
+static char* generate_source(int statements, int wide, size_t* length)
+{
+    const char* indent = wide ? "                " : "    ";
+    const char* prefix = wide ? "accumulatedRunningValueOfRecord" : "value";
+    size_t capacity = (size_t)statements * (wide ? 160 : 64) + 4096;
+    char* source = (char*)malloc(capacity);
+    size_t n = 0;
+    unsigned seed = 12345;
+    int i;
+
+    if (source == NULL) return NULL;
+    n += (size_t)sprintf(source + n, "{\n");
+    for (i = 0; i < 16; i++) n += (size_t)sprintf(source + n, "%sint %s%d;\n", indent, prefix, i);
+    for (i = 0; i < statements; i++) {
+        seed = seed * 1103515245u + 12345u;
+        switch ((seed >> 16) % 8) {
+        case 0:
+            n += (size_t)sprintf(source + n, "%sinput(%s%u);\n", indent, prefix, (seed >> 8) % 16);
+            break;
+        case 1:
+            n += (size_t)sprintf(source + n, "%soutput(%s%u);\n\n", indent, prefix, (seed >> 8) % 16);
+            break;
+        default:
+            n += (size_t)sprintf(source + n, "%s%s%u = %s%u * %u + %s%u - %u;\n", indent,
+                prefix, (seed >> 4) % 16, prefix, (seed >> 8) % 16, (seed >> 12) % 1000,
+                prefix, (seed >> 20) % 16, (seed >> 24) % 100000);
+            break;
+        }
+    }
+    n += (size_t)sprintf(source + n, "}\n");
+    *length = n;
+    return source;
+}
+
+/* ȡһΣд tokens */
+static double time_lexer(LexerFunc lexer, const char* source, size_t length, int* tokens)
+{
+    Compiler* compiler = (Compiler*)malloc(sizeof(Compiler));
+    double best = 1e30;
+    int i;
+
+    for (i = 0; i < REPEAT; i++) {
+        double start;
+        compiler_init(compiler);
+        start = bench_now();
+        lexer(compiler, source, length);
+        start = bench_now() - start;
+        if (start < best) best = start;
+        *tokens = compiler->tokens.count;
+        compiler_free(compiler);
+    }
+    free(compiler);
+    return best;
+}
+
+/* һԴϲȫʵ */
+static void run_workload(const char* title, int statements, int wide,
+    const LexerFunc* lexers, const char* const* names, int lexer_count)
+{
+    size_t length;
+    char* source = generate_source(statements, wide, &length);
+    double baseline = 0;
+    int k;
+
+    if (source == NULL) return;
+    printf("%sԴ %.2f MBȡ %d һ\n", title, (double)length / 1e6, REPEAT);
+    for (k = 0; k < lexer_count; k++) {
+        int tokens = 0;
+        double seconds = time_lexer(lexers[k], source, length, &tokens);
+        if (k == 0) baseline = seconds;
+        printf("  %-10s %8.2f ms  %7.1f M /  %7.1f MB/s  %.2fx\n", names[k], seconds * 1e3,
+            tokens / seconds / 1e6, (double)length / seconds / 1e6, baseline / seconds);
+    }
+    free(source);
+}
+
+int main(int argc, char** argv)
+{
+    LexerFunc lexers[4];
+    const char* names[4];
+    int lexer_count = 0;
+    int statements = argc > 1 ? atoi(argv[1]) : 200000;
+
+    lexers[lexer_count] = lexer_cascade;
+    names[lexer_count++] = "Ƚ";
+    lexers[lexer_count] = lexer_reference;
+    names[lexer_count++] = "DFA ";
+#ifdef LEXER_SIMD
+    lexers[lexer_count] = lexer_sse2;
+    names[lexer_count++] = "DFA SSE2";
+    if (cpu_has_avx2()) {
+        lexers[lexer_count] = lexer_avx2;
+        names[lexer_count++] = "DFA AVX2";
+    }
+#endif
+
+    run_workload("̱", statements, 0, lexers, names, lexer_count);
+    run_workload("", statements, 1, lexers, names, lexer_count);
+    return 0;
+}
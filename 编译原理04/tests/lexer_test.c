@@ -0,0 +1,179 @@
+/* ʷɨں˲ԣɵԴֱñSSE2AVX2 ںʷ
+   Ƚߵıбֹλֱӵøɨںˣں˱Ƚϡ
+    ԭ04 Ŀ¼¹У
+       gcc -O2 -o lexer_test tests/lexer_test.c && ./lexer_test []
+   ȫһʱ 0 */
+#define COMPILER_NO_MAIN
+#include "../001.c"
+#include <stdint.h>
+
+typedef void (*LexerFunc)(Compiler* compiler, const char* source, size_t length);
+
+static uint64_t random_state = 0x9E3779B97F4A7C15ull;
+
+/* xorshift64 */
+static uint32_t next_random(void)
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return (uint32_t)random_state;
+}
+
+/* ں˵Ĵʷx86-64  001.c ֻʵ SIMD ݣ */
+static void lexer_reference(Compiler* compiler, const char* source, size_t length)
+{
+    lexer_run(compiler, source, length, skip_space_scalar, scan_ident_scalar, scan_digits_scalar);
+}
+
+/* һγ̣ȿԽ 1632 ֽڵı߽磬ż ASCII ֽں͹ؼ */
+static size_t append_run(char* p)
+{
+    static const char punct[] = "{}();=+-*/%";
+    static const char space[] = " \t\r";
+    static const char* const keywords[] = { "int", "input", "output", "in", "outputs" };
+    size_t length = next_random() % 4 == 0 ? next_random() % 80 : next_random() % 8;
+    size_t i;
+
+    switch (next_random() % 8) {
+    case 0:
+    case 1:
+        for (i = 0; i < length; i++) p[i] = space[next_random() % 3];
+        return length;
+    case 2:
+    case 3:
+        p[0] = (char)('a' + next_random() % 26);
+        for (i = 1; i <= length; i++) {
+            uint32_t r = next_random() % 62;
+            p[i] = (char)(r < 26 ? 'a' + r : r < 52 ? 'A' + r - 26 : '0' + r - 52);
+        }
+        return length + 1;
+    case 4:
+        for (i = 0; i <= length; i++) p[i] = (char)('0' + next_random() % 10);
+        return length + 1;
+    case 5:
+        strcpy(p, keywords[next_random() % 5]);
+        return strlen(p);
+    case 6:
+        p[0] = next_random() % 3 == 0 ? '\n' : punct[next_random() % (sizeof(punct) - 1)];
+        return 1;
+    default:
+        /*  ASCII ֽڰзűȽΪκַ */
+        p[0] = (char)(0x80 | next_random() % 128);
+        return 1;
+    }
+}
+
+/* ȽδʷĽͬ 1 */
+static int same_tokens(const Compiler* a, const Compiler* b)
+{
+    const TokenStream* x = &a->tokens;
+    const TokenStream* y = &b->tokens;
+
+    if (x->count != y->count || x->line_count != y->line_count) return 0;
+    return memcmp(x->types, y->types, (size_t)x->count) == 0 &&
+        memcmp(x->offsets, y->offsets, (size_t)x->count * sizeof(uint32_t)) == 0 &&
+        memcmp(x->lengths, y->lengths, (size_t)x->count * sizeof(uint32_t)) == 0 &&
+        memcmp(x->line_starts, y->line_starts, (size_t)x->line_count * sizeof(uint32_t)) == 0;
+}
+
+/* Դı SIMD ʵʵֱȽϣزһµ */
+static int test_streams(const LexerFunc* lexers, const char* const* names, int lexer_count, int rounds)
+{
+    static char source[64 * 1024];
+    Compiler* reference = (Compiler*)malloc(sizeof(Compiler));
+    Compiler* candidate = (Compiler*)malloc(sizeof(Compiler));
+    int failures = 0;
+    int round, k;
+
+    for (round = 0; round < rounds; round++) {
+        size_t length = 0;
+        size_t limit = 1 + next_random() % (sizeof(source) / 8);
+
+        while (length < limit) length += append_run(source + length);
+        compiler_init(reference);
+        lexer_reference(reference, source, length);
+        for (k = 0; k < lexer_count; k++) {
+            compiler_init(candidate);
+            lexers[k](candidate, source, length);
+            if (!same_tokens(reference, candidate)) {
+                if (failures < 5) printf("һ£ %d ֣%sԴ %zu ֽ\n", round, names[k], length);
+                failures++;
+            }
+            compiler_free(candidate);
+        }
+        compiler_free(reference);
+    }
+    free(reference);
+    free(candidate);
+    return failures;
+}
+
+/* ֹλֱӵɨںˣں˽ͬĴ */
+static int test_kernels(int calls, int avx2)
+{
+    static const char alphabet[] = "  \t\r\naZ09x;+\x80\xff";
+    ScanFunc scalar[3] = { skip_space_scalar, scan_ident_scalar, scan_digits_scalar };
+#ifdef LEXER_SIMD
+    ScanFunc sse2[3] = { skip_space_sse2, scan_ident_sse2, scan_digits_sse2 };
+    ScanFunc wide[3] = { skip_space_avx2, scan_ident_avx2, scan_digits_avx2 };
+#endif
+    char buffer[256];
+    int failures = 0;
+    int call, kind;
+    size_t i;
+
+    for (call = 0; call < calls; call++) {
+        const char* p;
+        const char* end;
+        /* ÿһַΪγ̲㹻 */
+        char major = alphabet[next_random() % (sizeof(alphabet) - 1)];
+
+        for (i = 0; i < sizeof(buffer); i++) {
+            buffer[i] = next_random() % 16 == 0 ? alphabet[next_random() % (sizeof(alphabet) - 1)] : major;
+        }
+        p = buffer + next_random() % 128;
+        end = p + next_random() % (size_t)(buffer + sizeof(buffer) - p + 1);
+        for (kind = 0; kind < 3; kind++) {
+            const char* expected = scalar[kind](p, end);
+#ifdef LEXER_SIMD
+            if (sse2[kind](p, end) != expected) failures++;
+            if (avx2 && wide[kind](p, end) != expected) failures++;
+#else
+            (void)avx2;
+            (void)expected;
+#endif
+        }
+    }
+    return failures;
+}
+
+int main(int argc, char** argv)
+{
+    LexerFunc lexers[2];
+    const char* names[2];
+    int lexer_count = 0;
+    int rounds = argc > 1 ? atoi(argv[1]) : 3000;
+    int avx2 = 0;
+    int stream_failures, kernel_failures;
+
+#ifdef LEXER_SIMD
+    avx2 = cpu_has_avx2();
+    lexers[lexer_count] = lexer_sse2;
+    names[lexer_count++] = "SSE2";
+    if (avx2) {
+        lexers[lexer_count] = lexer_avx2;
+        names[lexer_count++] = "AVX2";
+    }
+#endif
+    if (lexer_count == 0) {
+        printf("ƽֻ̨бںˣ\n");
+        return 0;
+    }
+
+    stream_failures = test_streams(lexers, names, lexer_count, rounds);
+    kernel_failures = test_kernels(rounds * 200, avx2);
+    printf(": %d  x %d ںˣһ %d\n", rounds, lexer_count, stream_failures);
+    printf("ɨں: %d εãһ %d%s\n", rounds * 200, kernel_failures, avx2 ? "" : "CPU ֧ AVX2ֻ SSE2");
+    return stream_failures == 0 && kernel_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+/* ָѡ׼ͬһмֱ𰴱ʽĺˣͲʽ
+   ÿм뵥ѡָ൱֮ǰչĿָ
+   Ƚָͼʱִеʱ䣬˶ߵͬ
+   м԰۱ѡڴ leaǺϲʽ档
+   ʱֻɴ룺ڶһĻصһصȡʱ䣻
+   ȡһΡ
+    ԭ04 Ŀ¼¹У
+       gcc -O2 -o tiling_bench tests/tiling_bench.c && ./tiling_bench []
+   ƽּ̨֧ʱʱ */
+#define COMPILER_NO_MAIN
+#include "../001.c"
+#include "bench_timer.h"
+
+#ifdef JIT_SUPPORTED
+#define VARIABLES 16
+#define REPEAT 100
+
+typedef struct {
+    int used;
+    int count;
+    double start;
+    double stop;
+    int outputs[VARIABLES];
+    int output_count;
+} BenchIo;
+
+static int bench_input(void* context, int* value)
+{
+    BenchIo* io = (BenchIo*)context;
+    if (io->used >= io->count) return 0;
+    *value = 1000 + io->used * 37;
+    if (++io->used == io->count) io->start = bench_now();
+    return 1;
+}
+
+static void bench_output(void* context, int value)
+{
+    BenchIo* io = (BenchIo*)context;
+    io->stop = bench_now();
+    if (io->output_count < VARIABLES) io->outputs[io->output_count++] = value;
+}
+
+/* ɳ򣺶ȫִ statements ֵȫ
+   address Ϊʱǵַ״ base + index * scale + disp 㣬ǻ˳ȡģ */
+static char* generate_program(int statements, int address, size_t* length)
+{
+    char* source = (char*)malloc((size_t)statements * 64 + 1024);
+    char* p = source;
+    unsigned seed = 2024;
+    int i;
+
+    if (source == NULL) return NULL;
+    p += sprintf(p, "{\n");
+    for (i = 0; i < VARIABLES; i++) p += sprintf(p, "int v%d;\ninput(v%d);\n", i, i);
+    for (i = 0; i < statements; i++) {
+        unsigned a, b, c, d;
+        seed = seed * 1103515245u + 12345u;
+        a = (seed >> 4) % VARIABLES;
+        b = (seed >> 8) % VARIABLES;
+        c = (seed >> 12) % VARIABLES;
+        d = (seed >> 20) % VARIABLES;
+        switch ((seed >> 16) % 4 + (address ? 0 : 4)) {
+        case 0: p += sprintf(p, "v%u = v%u + v%u * 4 + %u;\n", a, b, c, (seed >> 24) % 64); break;
+        case 1: p += sprintf(p, "v%u = v%u * 8 + v%u;\n", a, b, c); break;
+        case 2: p += sprintf(p, "v%u = v%u + 2 * v%u - %u;\n", a, b, c, (seed >> 24) % 64); break;
+        case 3: p += sprintf(p, "v%u = v%u * 3 + %u;\n", a, b, (seed >> 24) % 64); break;
+        case 4: p += sprintf(p, "v%u = v%u * 7 + v%u / 3 - v%u %% 10;\n", a, b, c, d); break;
+        case 5: p += sprintf(p, "v%u = (v%u + v%u) * (v%u - 2);\n", a, b, c, d); break;
+        case 6: p += sprintf(p, "v%u = v%u - v%u * 5 + v%u / 16;\n", a, b, c, d); break;
+        default: p += sprintf(p, "v%u = v%u %% 1000 + v%u * 9;\n", a, b, c); break;
+        }
+    }
+    for (i = 0; i < VARIABLES; i++) p += sprintf(p, "output(v%d);\n", i);
+    p += sprintf(p, "}\n");
+    *length = (size_t)(p - source);
+    return source;
+}
+
+/* ע͡СŵĿָ */
+static int count_instructions(const Compiler* compiler)
+{
+    int count = 0;
+    int i;
+
+    for (i = 0; i < compiler->asm_count; i++) {
+        AsmOpcode op = compiler->asm_code[i].op;
+        if (op != ASM_DELETED && op != ASM_COMMENT && op != ASM_BLANK && op != ASM_LABEL) count++;
+    }
+    return count;
+}
+
+/* 벢ִУһεָд instructionsд outputs
+   tiled Ϊʱʽ׶ compile_buffer ͬ */
+static double measure(const char* source, size_t length, int tiled, int* instructions, int* outputs)
+{
+    Compiler* compiler = (Compiler*)malloc(sizeof(Compiler));
+    double best = 1e30;
+    int i;
+
+    compiler_init(compiler);
+    lexer(compiler, source, length);
+    parser(compiler);
+    generate_ir(compiler);
+    optimize_ir(compiler);
+    if (tiled) build_expression_trees(compiler);
+    allocate_registers(compiler);
+    assign_stack_slots(compiler);
+    generate_assembly(compiler);
+    peephole_optimize(compiler, 0);
+    *instructions = count_instructions(compiler);
+
+    for (i = 0; i < REPEAT && compiler->error_count == 0; i++) {
+        BenchIo bench;
+        JitIo io;
+        memset(&bench, 0, sizeof(bench));
+        memset(&io, 0, sizeof(io));
+        bench.count = VARIABLES;
+        io.input = bench_input;
+        io.output = bench_output;
+        io.context = &bench;
+        if (jit_execute(compiler, &io) != 0) {
+            best = -1;
+            break;
+        }
+        if (bench.stop - bench.start < best) best = bench.stop - bench.start;
+        memcpy(outputs, bench.outputs, sizeof(bench.outputs));
+    }
+    compiler_free(compiler);
+    free(compiler);
+    return best;
+}
+
+static int run_workload(const char* title, int statements, int address)
+{
+    size_t length;
+    char* source = generate_program(statements, address, &length);
+    int before_outputs[VARIABLES];
+    int after_outputs[VARIABLES];
+    int before_count, after_count;
+    double before, after;
+
+    if (source == NULL) return 0;
+    before = measure(source, length, 0, &before_count, before_outputs);
+    after = measure(source, length, 1, &after_count, after_outputs);
+    free(source);
+    if (before < 0 || after < 0) {
+        printf("ʱִʧ\n");
+        return 0;
+    }
+
+    printf("%s%d 䣩\n", title, statements);
+    printf("  ʽ  %6d ָ  %9.2f us\n", before_count, before * 1e6);
+    printf("  ʽ  %6d ָ  %9.2f us  ָ %.1f%%ʱ %.2fx\n", after_count, after * 1e6,
+        100.0 * after_count / before_count, before / after);
+    if (memcmp(before_outputs, after_outputs, sizeof(before_outputs)) != 0) {
+        printf("  һ\n");
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    int statements = argc > 1 ? atoi(argv[1]) : 600;
+    int ok;
+
+    printf("ȡ %d һ\n", REPEAT);
+    ok = run_workload("ַ", statements, 1);
+    ok = run_workload("", statements, 0) && ok;
+    return ok ? 0 : 1;
+}
+#else
+int main(void)
+{
+    printf("ƽּ̨֧ʱ룬\n");
+    return 0;
+}
+#endif
@@ -0,0 +1,306 @@
+/* ִֽвԣ
+     1. дINT_MIN / -1x % -1 0 ָԤڵͳɰܼ飻
+     2. 򣨱ȡ 0-1INT_MIN ֱֵ compile_and_interpret 
+        compile_and_run ִУĬŻ no_optimize һ飬ȽкǷʧܡ
+   2 ֻּ֧ʱƽ̨ϽСʧܵĳڱ׼ϴӡдԤڡ
+    ԭ04 Ŀ¼¹У
+       gcc -O2 -o vm_test tests/vm_test.c && ./vm_test []
+   ȫһʱ 0 */
+#define COMPILER_NO_MAIN
+#include "../001.c"
+
+#define MAX_VALUES 64
+#define MAX_VARIABLES 6
+#define MAX_STATEMENTS 24
+
+/* һеĽֵ */
+typedef struct {
+    int status;
+    int outputs[MAX_VALUES];
+    size_t output_count;
+} RunRecord;
+
+typedef int (*RunFunction)(const char* source, size_t length, const CompileOptions* options, JitIo* io);
+
+static void run_program(RunFunction run, const char* source, const CompileOptions* options,
+    const int* inputs, size_t input_count, RunRecord* record)
+{
+    JitIo io;
+
+    memset(&io, 0, sizeof(io));
+    io.input_values = inputs;
+    io.input_count = input_count;
+    io.output_values = record->outputs;
+    io.output_capacity = MAX_VALUES;
+    record->status = run(source, strlen(source), options, &io);
+    record->output_count = io.output_count;
+}
+
+static int same_record(const RunRecord* a, const RunRecord* b)
+{
+    return (a->status == 0) == (b->status == 0) && a->output_count == b->output_count &&
+        memcmp(a->outputs, b->outputs, a->output_count * sizeof(int)) == 0;
+}
+
+static void print_record(const char* name, const RunRecord* record)
+{
+    size_t i;
+
+    printf("  %s%s", name, record->status == 0 ? "" : "ʧ");
+    for (i = 0; i < record->output_count && i < MAX_VALUES; i++) printf(" %d", record->outputs[i]);
+    printf("\n");
+}
+
+/* д */
+typedef struct {
+    const char* name;
+    const char* source;
+    int inputs[4];
+    int input_count;
+    int fails;              /*  0 ʾӦʧ */
+    int outputs[4];         /* ʧǰ */
+    int output_count;
+} VmCase;
+
+static const VmCase cases[] = {
+    { "INT_MIN / -1", "{ int a; int b; input(a); input(b); output(b); a = a / b; output(a); }",
+        { INT32_MIN, -1 }, 2, 1, { -1 }, 1 },
+    { "INT_MIN % -1", "{ int a; int b; input(a); input(b); a = a % b; output(a); }",
+        { INT32_MIN, -1 }, 2, 1, { 0 }, 0 },
+    { "INT_MIN / -1", "{ int a; input(a); a = a / (0 - 1); output(a); }",
+        { INT32_MIN }, 1, 0, { INT32_MIN }, 1 },
+    { "INT_MIN / -1", "{ int b; input(b); b = (0 - 2147483647 - 1) / b; output(b); }",
+        { -1 }, 1, 1, { 0 }, 0 },
+    { "x % -1", "{ int a; int b; int c; input(a); input(b); c = a % (0 - 1); output(c); c = a % b; output(c); }",
+        { 123457, -1 }, 2, 0, { 0, 0 }, 2 },
+    { "INT_MIN % -1", "{ int a; input(a); a = a % (0 - 1); output(a); }",
+        { INT32_MIN }, 1, 0, { 0 }, 1 },
+    { " 0 ", "{ int a; input(a); output(a); a = a / 0; output(a); }",
+        { 7 }, 1, 1, { 7 }, 1 },
+    { " 0 ȡģ", "{ int a; input(a); a = a % 0; output(a); }",
+        { 7 }, 1, 1, { 0 }, 0 },
+    { "Գ 0", "{ int a; a = 5 / 0; output(a); }",
+        { 0 }, 0, 1, { 0 }, 0 },
+    { " 0 ", "{ int a; int b; input(a); input(b); a = 100 % b; output(a); }",
+        { 7, 0 }, 2, 1, { 0 }, 0 },
+    { "ADD3", "{ int a; int b; int c; input(a); input(b); input(c); c = a + b + c; output(c); }",
+        { INT32_MAX, 1, 5 }, 3, 0, { INT32_MIN + 5 }, 1 },
+    { "ADDI_ADD", "{ int a; int b; input(a); input(b); b = a + 2147483647 + b; output(b); }",
+        { 1, -3 }, 2, 0, { INT32_MAX - 2 }, 1 },
+    { "MULI_ADD", "{ int a; int b; input(a); input(b); b = a * 65536 + b; output(b); }",
+        { 40000, 7 }, 2, 0, { (int32_t)((uint32_t)40000 * 65536u + 7u) }, 1 },
+};
+
+/* ͳƳĸֽ */
+static int count_opcodes(const char* source, int* counts)
+{
+    CompileOptions options;
+    CompileResult result;
+    Compiler* compiler = (Compiler*)malloc(sizeof(Compiler));
+    VmProgram program;
+    int built = 0;
+    int i;
+
+    memset(counts, 0, VM_OP_COUNT * sizeof(int));
+    if (compiler == NULL) return 0;
+    memset(&options, 0, sizeof(options));
+    memset(&result, 0, sizeof(result));
+    compiler_init(compiler);
+    compile_front(compiler, source, strlen(source), &options, &result);
+    if (compiler->error_count == 0 && vm_build(compiler, &program)) {
+        for (i = 0; i < program.count; i++) counts[program.code[i].code.op]++;
+        free(program.code);
+        built = 1;
+    }
+    compiler_free(compiler);
+    free(compiler);
+    return built;
+}
+
+static int check_cases(void)
+{
+    static const struct {
+        const char* source;
+        int op;
+    } fused[] = {
+        { "{ int a; int b; int c; input(a); input(b); input(c); c = a + b + c; output(c); }", VM_ADD3 },
+        { "{ int a; int b; input(a); input(b); b = a + 2147483647 + b; output(b); }", VM_ADDI_ADD },
+        { "{ int a; int b; input(a); input(b); b = a * 65536 + b; output(b); }", VM_MULI_ADD },
+    };
+    int failures = 0;
+    int i;
+
+    for (i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); i++) {
+        const VmCase* c = &cases[i];
+        RunRecord expected;
+        RunRecord got;
+        int k;
+
+        expected.status = c->fails ? -1 : 0;
+        expected.output_count = (size_t)c->output_count;
+        for (k = 0; k < c->output_count; k++) expected.outputs[k] = c->outputs[k];
+
+        run_program(compile_and_interpret, c->source, NULL, c->inputs, (size_t)c->input_count, &got);
+        if (!same_record(&expected, &got)) {
+            printf("ִУ%s\n", c->name);
+            print_record("Ԥ", &expected);
+            print_record("ʵ", &got);
+            failures++;
+        }
+#ifdef JIT_SUPPORTED
+        run_program(compile_and_run, c->source, NULL, c->inputs, (size_t)c->input_count, &got);
+        if (!same_record(&expected, &got)) {
+            printf("ʱ룩%s\n", c->name);
+            print_record("Ԥ", &expected);
+            print_record("ʵ", &got);
+            failures++;
+        }
+#endif
+    }
+
+    /* ָȷʵϳ˶Ӧĳָ */
+    for (i = 0; i < (int)(sizeof(fused) / sizeof(fused[0])); i++) {
+        int counts[VM_OP_COUNT];
+        if (!count_opcodes(fused[i].source, counts) || counts[fused[i].op] == 0) {
+            printf("δϳɳָ %d%s\n", fused[i].op, fused[i].source);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+#ifdef JIT_SUPPORTED
+static uint64_t random_state = 0x9E3779B97F4A7C15ull;
+
+/* xorshift64 */
+static uint32_t next_random(void)
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return (uint32_t)random_state;
+}
+
+/* ֵȡ 01ֵñʱֳ 0INT_MIN / -1 */
+static int random_value(void)
+{
+    static const int special[] = { 0, 1, -1, 2, -2, 7, INT32_MIN, INT32_MAX, INT32_MIN + 1, 65536 };
+    uint32_t r = next_random();
+
+    if (r % 3 == 0) return (int)(next_random() % 2001) - 1000;
+    if (r % 3 == 1) return special[next_random() % (sizeof(special) / sizeof(special[0]))];
+    return (int)next_random();
+}
+
+/*  0 дǣд (0 - n)INT_MIN д (0 - 2147483647 - 1) */
+static char* random_operand(char* p, int variables)
+{
+    static const int constants[] = { 1, -1, 2, 3, 4, 7, 8, 10, 16, 100, 1024, 65536, INT32_MAX, INT32_MIN };
+    int32_t c;
+
+    if (next_random() % 2 == 0) return p + sprintf(p, "v%u", next_random() % (unsigned)variables);
+    c = constants[next_random() % (sizeof(constants) / sizeof(constants[0]))];
+    if (c == INT32_MIN) return p + sprintf(p, "(0 - 2147483647 - 1)");
+    if (c < 0) return p + sprintf(p, "(0 - %d)", -c);
+    return p + sprintf(p, "%d", c);
+}
+
+static char* random_expression(char* p, int variables, int depth)
+{
+    static const char operators[] = "+-*/%+*";
+
+    if (depth == 0 || next_random() % 4 == 0) return random_operand(p, variables);
+    *p++ = '(';
+    p = random_expression(p, variables, depth - 1);
+    p += sprintf(p, ") %c (", operators[next_random() % (sizeof(operators) - 1)]);
+    p = random_expression(p, variables, depth - 1);
+    *p++ = ')';
+    return p;
+}
+
+/* ִһֵinputoutputȫ */
+static void random_program(char* source, int* inputs, int* input_count)
+{
+    int variables = (int)(next_random() % MAX_VARIABLES) + 1;
+    int statements = (int)(next_random() % MAX_STATEMENTS) + 1;
+    char* p = source;
+    int i;
+
+    *input_count = 0;
+    p += sprintf(p, "{\n");
+    for (i = 0; i < variables; i++) p += sprintf(p, "int v%d;\n", i);
+    for (i = 0; i < statements; i++) {
+        uint32_t kind = next_random() % 10;
+        int v = (int)(next_random() % (unsigned)variables);
+        if (kind < 6) {
+            p += sprintf(p, "v%d = ", v);
+            p = random_expression(p, variables, (int)(next_random() % 4));
+            p += sprintf(p, ";\n");
+        }
+        else if (kind < 8) {
+            p += sprintf(p, "output(v%d);\n", v);
+        }
+        else {
+            p += sprintf(p, "input(v%d);\n", v);
+            inputs[(*input_count)++] = random_value();
+        }
+    }
+    for (i = 0; i < variables; i++) p += sprintf(p, "output(v%d);\n", i);
+    p += sprintf(p, "}\n");
+}
+
+/* ϱȽִзʽزһµĴ */
+static int check_corpus(int programs)
+{
+    static char source[MAX_STATEMENTS * 512 + 1024];
+    CompileOptions options[2];
+    int inputs[MAX_STATEMENTS];
+    int failed_runs = 0;
+    int mismatches = 0;
+    int i, k;
+
+    memset(options, 0, sizeof(options));
+    options[1].no_optimize = 1;
+    for (i = 0; i < programs; i++) {
+        int input_count;
+        random_program(source, inputs, &input_count);
+        for (k = 0; k < 2; k++) {
+            RunRecord interpreted;
+            RunRecord native;
+            run_program(compile_and_interpret, source, &options[k], inputs, (size_t)input_count, &interpreted);
+            run_program(compile_and_run, source, &options[k], inputs, (size_t)input_count, &native);
+            if (interpreted.status != 0) failed_runs++;
+            if (!same_record(&interpreted, &native)) {
+                if (mismatches++ < 5) {
+                    printf("һ£ %d %s\n%s", i, k ? "no_optimize" : "", source);
+                    print_record("compile_and_interpret", &interpreted);
+                    print_record("compile_and_run", &native);
+                }
+            }
+        }
+    }
+
+    printf("%d %d Уʧ %d Σһ %d\n", programs, programs * 2, failed_runs, mismatches);
+    /* ͬʱʧ */
+    if (failed_runs == 0 || failed_runs == programs * 2) {
+        printf("ûͬʱʧ\n");
+        mismatches++;
+    }
+    return mismatches;
+}
+#endif
+
+int main(int argc, char** argv)
+{
+    int failures = check_cases();
+
+    printf("%d д %d\n", (int)(sizeof(cases) / sizeof(cases[0])), failures);
+#ifdef JIT_SUPPORTED
+    failures += check_corpus(argc > 1 ? atoi(argv[1]) : 500);
+#else
+    (void)argc;
+    (void)argv;
+    printf("ƽּ̨֧ʱ룬 compile_and_run ıȽ\n");
+#endif
+    return failures == 0 ? 0 : 1;
+}